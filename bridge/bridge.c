@@ -68,8 +68,11 @@ static int do_cmd(const char *argv0, int argc, char **argv)
 	const struct cmd *c;
 
 	for (c = cmds; c->cmd; ++c) {
-		if (matches(argv0, c->cmd) == 0)
-			return c->func(argc-1, argv+1);
+		if (matches(argv0, c->cmd) == 0) {
+			int ret = c->func(argc-1, argv+1);
+
+			return json_obj_failed() ? -1 : ret;
+		}
 	}
 
 	fprintf(stderr,
@@ -31,6 +31,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <fcntl.h>
 #include <rt_names.h>
 
 #include "version.h"
@@ -41,6 +42,7 @@
 #include "utils.h"
 #include "namespace.h"
 #include "libnetlink.h"
+#include "ll_map.h"
 #include "../ip/ip_common.h"
 
 #define ESWITCH_MODE_LEGACY "legacy"
@@ -201,8 +203,12 @@ static int _mnlg_socket_group_add(struct mnlu_gen_socket *nlg,
 	return 0;
 }
 
+#define IFNAME_MAP_SIZE		1024
+
 struct ifname_map {
 	struct list_head list;
+	struct hlist_node name_hash;
+	struct hlist_node port_hash;
 	char *bus_name;
 	char *dev_name;
 	uint32_t port_index;
@@ -239,16 +245,19 @@ static struct ifname_map *ifname_map_alloc(const char *bus_name,
 	return ifname_map;
 }
 
-static int ifname_map_update(struct ifname_map *ifname_map, const char *ifname)
+static unsigned int ifname_map_name_hash(const char *ifname)
 {
-	char *new_ifname;
+	return namehash(ifname) & (IFNAME_MAP_SIZE - 1);
+}
 
-	new_ifname = strdup(ifname);
-	if (!new_ifname)
-		return -ENOMEM;
-	free(ifname_map->ifname);
-	ifname_map->ifname = new_ifname;
-	return 0;
+static unsigned int ifname_map_port_hash(const char *bus_name,
+					 const char *dev_name,
+					 uint32_t port_index)
+{
+	unsigned int hash;
+
+	hash = namehash(bus_name) * 31 + namehash(dev_name);
+	return (hash ^ port_index) & (IFNAME_MAP_SIZE - 1);
 }
 
 #define DL_OPT_HANDLE		BIT(0)
@@ -309,6 +318,8 @@ static int ifname_map_update(struct ifname_map *ifname_map, const char *ifname)
 #define DL_OPT_PORT_FN_RATE_TX_PRIORITY	BIT(55)
 #define DL_OPT_PORT_FN_RATE_TX_WEIGHT	BIT(56)
 #define DL_OPT_PORT_FN_CAPS	BIT(57)
+#define DL_OPT_REGION_FILE	BIT(58)
+#define DL_OPT_REGION_FORMAT	BIT(59)
 
 struct dl_opts {
 	uint64_t present; /* flags of present items */
@@ -340,6 +351,8 @@ struct dl_opts {
 	uint32_t region_snapshot_id;
 	__u64 region_address;
 	__u64 region_length;
+	const char *region_file_name;
+	bool region_binary;
 	const char *flash_file_name;
 	const char *flash_component;
 	const char *reporter_name;
@@ -380,6 +393,8 @@ struct dl_opts {
 struct dl {
 	struct mnlu_gen_socket nlg;
 	struct list_head ifname_map_list;
+	struct hlist_head ifname_map_names[IFNAME_MAP_SIZE];
+	struct hlist_head ifname_map_ports[IFNAME_MAP_SIZE];
 	int argc;
 	char **argv;
 	char *handle_argv;
@@ -392,6 +407,12 @@ struct dl {
 	bool hex;
 	bool use_iec;
 	bool map_loaded;
+	struct {
+		int fd;		/* raw output, -1 for hex/JSON */
+		bool seekable;
+		uint64_t base;	/* region address at file offset 0 */
+		uint64_t align_val;
+	} region_out;
 	struct {
 		bool present;
 		char *bus_name;
@@ -794,25 +815,100 @@ static int function_attr_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
+static struct ifname_map *ifname_map_find_name(struct dl *dl,
+						const char *ifname)
+{
+	unsigned int h = ifname_map_name_hash(ifname);
+	struct ifname_map *ifname_map;
+
+	hlist_for_each_entry(ifname_map, &dl->ifname_map_names[h], name_hash) {
+		if (strcmp(ifname, ifname_map->ifname) == 0)
+			return ifname_map;
+	}
+	return NULL;
+}
+
+static struct ifname_map *ifname_map_find_port(struct dl *dl,
+						const char *bus_name,
+						const char *dev_name,
+						uint32_t port_index)
+{
+	unsigned int h = ifname_map_port_hash(bus_name, dev_name, port_index);
+	struct ifname_map *ifname_map;
+
+	hlist_for_each_entry(ifname_map, &dl->ifname_map_ports[h], port_hash) {
+		if (port_index == ifname_map->port_index &&
+		    strcmp(bus_name, ifname_map->bus_name) == 0 &&
+		    strcmp(dev_name, ifname_map->dev_name) == 0)
+			return ifname_map;
+	}
+	return NULL;
+}
+
+static int ifname_map_update(struct dl *dl, struct ifname_map *ifname_map,
+			     const char *ifname)
+{
+	char *new_ifname;
+
+	if (strcmp(ifname, ifname_map->ifname) == 0)
+		return 0;
+
+	new_ifname = strdup(ifname);
+	if (!new_ifname)
+		return -ENOMEM;
+	free(ifname_map->ifname);
+	ifname_map->ifname = new_ifname;
+
+	hlist_del(&ifname_map->name_hash);
+	hlist_add_head(&ifname_map->name_hash,
+		       &dl->ifname_map_names[ifname_map_name_hash(ifname)]);
+	return 0;
+}
+
 static int ifname_map_add(struct dl *dl, const char *ifname,
 			  const char *bus_name, const char *dev_name,
 			  uint32_t port_index)
 {
 	struct ifname_map *ifname_map;
+	unsigned int h;
+
+	/* Ports may be learned more than once, e.g. from an rtnetlink
+	 * lookup followed by a full dump, or from monitor notifications.
+	 */
+	ifname_map = ifname_map_find_port(dl, bus_name, dev_name, port_index);
+	if (ifname_map)
+		return ifname_map_update(dl, ifname_map, ifname);
 
 	ifname_map = ifname_map_alloc(bus_name, dev_name, port_index, ifname);
 	if (!ifname_map)
 		return -ENOMEM;
 	list_add(&ifname_map->list, &dl->ifname_map_list);
+
+	h = ifname_map_name_hash(ifname);
+	hlist_add_head(&ifname_map->name_hash, &dl->ifname_map_names[h]);
+	h = ifname_map_port_hash(bus_name, dev_name, port_index);
+	hlist_add_head(&ifname_map->port_hash, &dl->ifname_map_ports[h]);
 	return 0;
 }
 
 static void ifname_map_del(struct ifname_map *ifname_map)
 {
+	hlist_del(&ifname_map->port_hash);
+	hlist_del(&ifname_map->name_hash);
 	list_del(&ifname_map->list);
 	ifname_map_free(ifname_map);
 }
 
+static void ifname_map_port_del(struct dl *dl, const char *bus_name,
+				const char *dev_name, uint32_t port_index)
+{
+	struct ifname_map *ifname_map;
+
+	ifname_map = ifname_map_find_port(dl, bus_name, dev_name, port_index);
+	if (ifname_map)
+		ifname_map_del(ifname_map);
+}
+
 static int ifname_map_rtnl_port_parse(struct dl *dl, const char *ifname,
 				      struct rtattr *nest)
 {
@@ -926,6 +1022,7 @@ static void ifname_map_fini(struct dl *dl)
 				 &dl->ifname_map_list, list) {
 		ifname_map_del(ifname_map);
 	}
+	dl->map_loaded = false;
 }
 
 static void ifname_map_init(struct dl *dl)
@@ -933,6 +1030,25 @@ static void ifname_map_init(struct dl *dl)
 	INIT_LIST_HEAD(&dl->ifname_map_list);
 }
 
+/* Keep the map current from port messages seen anyway, be it replies to
+ * "port show" or "port add", or notifications in "devlink monitor", so that
+ * batch and monitor sessions do not have to reload it.
+ */
+static void ifname_map_port_event(struct dl *dl, uint8_t cmd,
+				  struct nlattr **tb)
+{
+	const char *bus_name = mnl_attr_get_str(tb[DEVLINK_ATTR_BUS_NAME]);
+	const char *dev_name = mnl_attr_get_str(tb[DEVLINK_ATTR_DEV_NAME]);
+	uint32_t port_index = mnl_attr_get_u32(tb[DEVLINK_ATTR_PORT_INDEX]);
+
+	if (cmd != DEVLINK_CMD_PORT_DEL && tb[DEVLINK_ATTR_PORT_NETDEV_NAME])
+		ifname_map_add(dl,
+			       mnl_attr_get_str(tb[DEVLINK_ATTR_PORT_NETDEV_NAME]),
+			       bus_name, dev_name, port_index);
+	else
+		ifname_map_port_del(dl, bus_name, dev_name, port_index);
+}
+
 static int ifname_map_load(struct dl *dl, const char *ifname)
 {
 	struct mnlu_gen_socket nlg_map;
@@ -940,6 +1056,10 @@ static int ifname_map_load(struct dl *dl, const char *ifname)
 	int err;
 
 	if (ifname) {
+		/* Only the requested port is learned this way, so the map
+		 * is not marked as loaded and a reverse lookup of any other
+		 * port still triggers the full dump below.
+		 */
 		err = ifname_map_rtnl_init(dl, ifname);
 		if (!err)
 			return 0;
@@ -959,6 +1079,8 @@ static int ifname_map_load(struct dl *dl, const char *ifname)
 	err = mnlu_gen_socket_sndrcv(&nlg_map, nlh, ifname_map_cb, dl);
 	if (err)
 		ifname_map_fini(dl);
+	else
+		dl->map_loaded = true;
 
 	mnlu_gen_socket_close(&nlg_map);
 	return err;
@@ -976,7 +1098,6 @@ static int ifname_map_check_load(struct dl *dl, const char *ifname)
 		pr_err("Failed to create index map\n");
 		return err;
 	}
-	dl->map_loaded = true;
 	return 0;
 }
 
@@ -988,19 +1109,20 @@ static int ifname_map_lookup(struct dl *dl, const char *ifname,
 	struct ifname_map *ifname_map;
 	int err;
 
-	err = ifname_map_check_load(dl, ifname);
-	if (err)
-		return err;
-
-	list_for_each_entry(ifname_map, &dl->ifname_map_list, list) {
-		if (strcmp(ifname, ifname_map->ifname) == 0) {
-			*p_bus_name = ifname_map->bus_name;
-			*p_dev_name = ifname_map->dev_name;
-			*p_port_index = ifname_map->port_index;
-			return 0;
-		}
+	ifname_map = ifname_map_find_name(dl, ifname);
+	if (!ifname_map) {
+		err = ifname_map_check_load(dl, ifname);
+		if (err)
+			return err;
+		ifname_map = ifname_map_find_name(dl, ifname);
+		if (!ifname_map)
+			return -ENOENT;
 	}
-	return -ENOENT;
+
+	*p_bus_name = ifname_map->bus_name;
+	*p_dev_name = ifname_map->dev_name;
+	*p_port_index = ifname_map->port_index;
+	return 0;
 }
 
 static int ifname_map_rev_lookup(struct dl *dl, const char *bus_name,
@@ -1008,28 +1130,31 @@ static int ifname_map_rev_lookup(struct dl *dl, const char *bus_name,
 				 const char **p_ifname)
 {
 	struct ifname_map *ifname_map;
-
 	int err;
 
-	err = ifname_map_check_load(dl, NULL);
-	if (err)
-		return err;
+	ifname_map = ifname_map_find_port(dl, bus_name, dev_name, port_index);
+	if (!ifname_map) {
+		err = ifname_map_check_load(dl, NULL);
+		if (err)
+			return err;
+		ifname_map = ifname_map_find_port(dl, bus_name, dev_name,
+						  port_index);
+	}
 
-	list_for_each_entry(ifname_map, &dl->ifname_map_list, list) {
-		if (strcmp(bus_name, ifname_map->bus_name) == 0 &&
-		    strcmp(dev_name, ifname_map->dev_name) == 0 &&
-		    port_index == ifname_map->port_index) {
-			/* In case non-NULL ifname is passed, update the
-			 * looked-up entry.
-			 */
-			if (*p_ifname)
-				return ifname_map_update(ifname_map, *p_ifname);
-
-			*p_ifname = ifname_map->ifname;
-			return 0;
-		}
+	/* In case non-NULL ifname is passed, update the looked-up entry,
+	 * or learn the port if it appeared after the map was loaded.
+	 */
+	if (*p_ifname) {
+		if (!ifname_map)
+			return ifname_map_add(dl, *p_ifname, bus_name,
+					      dev_name, port_index);
+		return ifname_map_update(dl, ifname_map, *p_ifname);
 	}
-	return -ENOENT;
+
+	if (!ifname_map)
+		return -ENOENT;
+	*p_ifname = ifname_map->ifname;
+	return 0;
 }
 
 static int strtobool(const char *str, bool *p_val)
@@ -1412,6 +1537,19 @@ static int threshold_type_get(const char *typestr,
 	return 0;
 }
 
+static int region_format_get(const char *formatstr, bool *p_binary)
+{
+	if (strcmp(formatstr, "hex") == 0) {
+		*p_binary = false;
+	} else if (strcmp(formatstr, "binary") == 0) {
+		*p_binary = true;
+	} else {
+		pr_err("Unknown region format \"%s\"\n", formatstr);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static int eswitch_mode_get(const char *typestr,
 			    enum devlink_eswitch_mode *p_mode)
 {
@@ -1956,6 +2094,25 @@ static int dl_argv_parse(struct dl *dl, uint64_t o_required,
 			if (err)
 				return err;
 			o_found |= DL_OPT_REGION_LENGTH;
+		} else if (dl_argv_match(dl, "file") &&
+			   (o_all & DL_OPT_REGION_FILE)) {
+			dl_arg_inc(dl);
+			err = dl_argv_str(dl, &opts->region_file_name);
+			if (err)
+				return err;
+			o_found |= DL_OPT_REGION_FILE;
+		} else if (dl_argv_match(dl, "format") &&
+			   (o_all & DL_OPT_REGION_FORMAT)) {
+			const char *formatstr;
+
+			dl_arg_inc(dl);
+			err = dl_argv_str(dl, &formatstr);
+			if (err)
+				return err;
+			err = region_format_get(formatstr, &opts->region_binary);
+			if (err)
+				return err;
+			o_found |= DL_OPT_REGION_FORMAT;
 		} else if (dl_argv_match(dl, "file") &&
 			   (o_all & DL_OPT_FLASH_FILE_NAME)) {
 			dl_arg_inc(dl);
@@ -3044,30 +3201,56 @@ static void pr_out_region_chunk_end(struct dl *dl)
 		close_json_array(PRINT_JSON, NULL);
 }
 
-static void pr_out_region_chunk(struct dl *dl, uint8_t *data, uint32_t len,
-				uint64_t addr)
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Format whole lines of the hex dump into a local buffer instead of
+ * printing every byte on its own, which dominates the run time of dumping
+ * regions of hundreds of megabytes.
+ */
+static void pr_out_region_chunk_hex(struct dl *dl, const uint8_t *data,
+				    uint32_t len, uint64_t addr)
 {
-	static uint64_t align_val;
-	uint32_t i = 0;
+	/* Room for a few hundred lines of "\n" ADDR " " and 16 "xx " */
+	char buf[16384];
+	size_t n = 0;
+	uint32_t i;
+	int j;
 
-	pr_out_region_chunk_start(dl, addr);
-	while (i < len) {
-		if (!dl->json_output)
-			if (!(align_val % 16))
-				pr_out("%s%016"PRIx64" ",
-				       align_val ? "\n" : "",
-				       addr);
+	for (i = 0; i < len; i++, addr++) {
+		if (!(dl->region_out.align_val % 16)) {
+			if (n > sizeof(buf) - (1 + 17 + 16 * 3)) {
+				pr_out("%.*s", (int)n, buf);
+				n = 0;
+			}
+			if (dl->region_out.align_val)
+				buf[n++] = '\n';
+			for (j = 60; j >= 0; j -= 4)
+				buf[n++] = hex_digits[(addr >> j) & 0xf];
+			buf[n++] = ' ';
+		}
+		dl->region_out.align_val++;
 
-		align_val++;
+		buf[n++] = hex_digits[data[i] >> 4];
+		buf[n++] = hex_digits[data[i] & 0xf];
+		buf[n++] = ' ';
+	}
+	if (n)
+		pr_out("%.*s", (int)n, buf);
+}
 
-		if (dl->json_output)
-			print_int(PRINT_JSON, NULL, NULL, data[i]);
-		else
-			pr_out("%02x ", data[i]);
+static void pr_out_region_chunk(struct dl *dl, uint8_t *data, uint32_t len,
+				uint64_t addr)
+{
+	uint32_t i;
 
-		addr++;
-		i++;
+	if (!dl->json_output) {
+		pr_out_region_chunk_hex(dl, data, len, addr);
+		return;
 	}
+
+	pr_out_region_chunk_start(dl, addr);
+	for (i = 0; i < len; i++)
+		print_int(PRINT_JSON, NULL, NULL, data[i]);
 	pr_out_region_chunk_end(dl);
 }
 
@@ -4966,6 +5149,7 @@ static int cmd_port_show_cb(const struct nlmsghdr *nlh, void *data)
 	    !tb[DEVLINK_ATTR_PORT_INDEX])
 		return MNL_CB_ERROR;
 	pr_out_port(dl, tb);
+	ifname_map_port_event(dl, genl->cmd, tb);
 	return MNL_CB_OK;
 }
 
@@ -5022,7 +5206,13 @@ static int cmd_port_split(struct dl *dl)
 
 	dl_opts_put(nlh, dl);
 
-	return mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	/* The new ports and their netdevs are only announced through
+	 * notifications, so have the map reloaded on next use.
+	 */
+	if (!err)
+		ifname_map_fini(dl);
+	return err;
 }
 
 static int cmd_port_unsplit(struct dl *dl)
@@ -5039,7 +5229,13 @@ static int cmd_port_unsplit(struct dl *dl)
 
 	dl_opts_put(nlh, dl);
 
-	return mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	/* The new ports and their netdevs are only announced through
+	 * notifications, so have the map reloaded on next use.
+	 */
+	if (!err)
+		ifname_map_fini(dl);
+	return err;
 }
 
 static int cmd_port_param_show(struct dl *dl)
@@ -5669,7 +5865,11 @@ static int cmd_port_del(struct dl *dl)
 
 	dl_opts_put(nlh, dl);
 
-	return mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
+	if (!err)
+		ifname_map_port_del(dl, dl->opts.bus_name, dl->opts.dev_name,
+				    dl->opts.port_index);
+	return err;
 }
 
 static int cmd_port(struct dl *dl)
@@ -6846,6 +7046,7 @@ static int cmd_mon_show_cb(const struct nlmsghdr *nlh, void *data)
 		pr_out_mon_header(genl->cmd);
 		pr_out_port(dl, tb);
 		pr_out_mon_footer();
+		ifname_map_port_event(dl, genl->cmd, tb);
 		break;
 	case DEVLINK_CMD_PARAM_GET: /* fall through */
 	case DEVLINK_CMD_PARAM_SET: /* fall through */
@@ -8899,6 +9100,87 @@ static int cmd_region_snapshot_del(struct dl *dl)
 	return mnlu_gen_socket_sndrcv(&dl->nlg, nlh, NULL, NULL);
 }
 
+static int region_out_open(struct dl *dl, uint64_t base)
+{
+	struct dl_opts *opts = &dl->opts;
+	int fd, err;
+
+	dl->region_out.fd = -1;
+	dl->region_out.align_val = 0;
+
+	if (dl->json_output && (opts->present & DL_OPT_REGION_FILE ||
+				(opts->present & DL_OPT_REGION_FORMAT &&
+				 opts->region_binary))) {
+		pr_err("Binary region output cannot be combined with JSON\n");
+		return -EINVAL;
+	}
+
+	if (opts->present & DL_OPT_REGION_FILE) {
+		if (opts->present & DL_OPT_REGION_FORMAT &&
+		    !opts->region_binary) {
+			pr_err("Region data is written to a file in binary format only\n");
+			return -EINVAL;
+		}
+		fd = open(opts->region_file_name,
+			  O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			err = -errno;
+			pr_err("Failed to open \"%s\": %s\n",
+			       opts->region_file_name, strerror(-err));
+			return err;
+		}
+	} else if (opts->present & DL_OPT_REGION_FORMAT &&
+		   opts->region_binary) {
+		fd = STDOUT_FILENO;
+		fflush(stdout);
+	} else {
+		return 0;
+	}
+
+	/* Chunks are written at their offset from the first requested
+	 * address, so gaps the kernel did not send stay holes in the file.
+	 * Standard output is written sequentially.
+	 */
+	dl->region_out.seekable = fd != STDOUT_FILENO;
+	dl->region_out.base = base;
+	dl->region_out.fd = fd;
+	return 0;
+}
+
+static void region_out_close(struct dl *dl)
+{
+	if (dl->region_out.fd >= 0 && dl->region_out.fd != STDOUT_FILENO)
+		close(dl->region_out.fd);
+	dl->region_out.fd = -1;
+}
+
+static int region_out_write(struct dl *dl, const uint8_t *data, uint32_t len,
+			    uint64_t addr)
+{
+	off_t off = addr - dl->region_out.base;
+	ssize_t ret;
+	int err;
+
+	while (len) {
+		if (dl->region_out.seekable)
+			ret = pwrite(dl->region_out.fd, data, len, off);
+		else
+			ret = write(dl->region_out.fd, data, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			pr_err("Failed to write region data: %s\n",
+			       strerror(-err));
+			return err;
+		}
+		data += ret;
+		len -= ret;
+		off += ret;
+	}
+	return 0;
+}
+
 static int cmd_region_read_cb(const struct nlmsghdr *nlh, void *data)
 {
 	struct nlattr *nla_entry, *nla_chunk_data, *nla_chunk_addr;
@@ -8926,6 +9208,16 @@ static int cmd_region_read_cb(const struct nlmsghdr *nlh, void *data)
 		if (!nla_chunk_addr)
 			continue;
 
+		if (dl->region_out.fd >= 0) {
+			err = region_out_write(dl,
+					       mnl_attr_get_payload(nla_chunk_data),
+					       mnl_attr_get_payload_len(nla_chunk_data),
+					       mnl_attr_get_u64(nla_chunk_addr));
+			if (err)
+				return MNL_CB_ERROR;
+			continue;
+		}
+
 		pr_out_region_chunk(dl, mnl_attr_get_payload(nla_chunk_data),
 				    mnl_attr_get_payload_len(nla_chunk_data),
 				    mnl_attr_get_u64(nla_chunk_addr));
@@ -8933,6 +9225,30 @@ static int cmd_region_read_cb(const struct nlmsghdr *nlh, void *data)
 	return MNL_CB_OK;
 }
 
+static int cmd_region_read_run(struct dl *dl, struct nlmsghdr *nlh,
+			       const char *name, uint64_t base)
+{
+	int err;
+
+	err = region_out_open(dl, base);
+	if (err)
+		return err;
+
+	if (dl->region_out.fd >= 0) {
+		err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, cmd_region_read_cb,
+					     dl);
+		region_out_close(dl);
+		return err;
+	}
+
+	pr_out_section_start(dl, name);
+	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, cmd_region_read_cb, dl);
+	pr_out_section_end(dl);
+	if (!dl->json_output)
+		pr_out("\n");
+	return err;
+}
+
 static int cmd_region_dump(struct dl *dl)
 {
 	struct nlmsghdr *nlh;
@@ -8940,7 +9256,7 @@ static int cmd_region_dump(struct dl *dl)
 
 	err = dl_argv_parse(dl,
 			    DL_OPT_HANDLE_REGION | DL_OPT_REGION_SNAPSHOT_ID,
-			    0);
+			    DL_OPT_REGION_FILE | DL_OPT_REGION_FORMAT);
 	if (err)
 		return err;
 
@@ -8949,12 +9265,7 @@ static int cmd_region_dump(struct dl *dl)
 
 	dl_opts_put(nlh, dl);
 
-	pr_out_section_start(dl, "dump");
-	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, cmd_region_read_cb, dl);
-	pr_out_section_end(dl);
-	if (!dl->json_output)
-		pr_out("\n");
-	return err;
+	return cmd_region_read_run(dl, nlh, "dump", 0);
 }
 
 static int cmd_region_read(struct dl *dl)
@@ -8964,7 +9275,8 @@ static int cmd_region_read(struct dl *dl)
 
 	err = dl_argv_parse(dl, DL_OPT_HANDLE_REGION | DL_OPT_REGION_ADDRESS |
 			    DL_OPT_REGION_LENGTH,
-			    DL_OPT_REGION_SNAPSHOT_ID);
+			    DL_OPT_REGION_SNAPSHOT_ID | DL_OPT_REGION_FILE |
+			    DL_OPT_REGION_FORMAT);
 	if (err)
 		return err;
 
@@ -8977,12 +9289,7 @@ static int cmd_region_read(struct dl *dl)
 	if (!(dl->opts.present & DL_OPT_REGION_SNAPSHOT_ID))
 		mnl_attr_put(nlh, DEVLINK_ATTR_REGION_DIRECT, 0, NULL);
 
-	pr_out_section_start(dl, "read");
-	err = mnlu_gen_socket_sndrcv(&dl->nlg, nlh, cmd_region_read_cb, dl);
-	pr_out_section_end(dl);
-	if (!dl->json_output)
-		pr_out("\n");
-	return err;
+	return cmd_region_read_run(dl, nlh, "read", dl->opts.region_address);
 }
 
 static int cmd_region_snapshot_new_cb(const struct nlmsghdr *nlh, void *data)
@@ -9029,7 +9336,9 @@ static void cmd_region_help(void)
 	pr_err("       devlink region del DEV/REGION snapshot SNAPSHOT_ID\n");
 	pr_err("       devlink region new DEV/REGION [ snapshot SNAPSHOT_ID ]\n");
 	pr_err("       devlink region dump DEV/REGION [ snapshot SNAPSHOT_ID ]\n");
+	pr_err("                           [ format { hex | binary } ] [ file PATH ]\n");
 	pr_err("       devlink region read DEV/REGION [ snapshot SNAPSHOT_ID ] address ADDRESS length LENGTH\n");
+	pr_err("                           [ format { hex | binary } ] [ file PATH ]\n");
 }
 
 static int cmd_region(struct dl *dl)
@@ -10058,6 +10367,7 @@ static int dl_init(struct dl *dl)
 	}
 
 	ifname_map_init(dl);
+	dl->region_out.fd = -1;
 
 	new_json_obj_plain(dl->json_output);
 	return 0;
@@ -29,9 +29,11 @@ enum output_type {
 };
 
 void new_json_obj(int json);
-void delete_json_obj(void);
+int delete_json_obj(void);
 void new_json_obj_plain(int json);
-void delete_json_obj_plain(void);
+int delete_json_obj_plain(void);
+void forget_json_obj(void);
+bool json_obj_failed(void);
 
 bool is_json_context(void);
 
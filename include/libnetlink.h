@@ -3,7 +3,9 @@
 #define __LIBNETLINK_H__ 1
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <asm/types.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
@@ -24,7 +26,13 @@ struct rtnl_handle {
 #define RTNL_HANDLE_F_LISTEN_ALL_NSID		0x01
 #define RTNL_HANDLE_F_SUPPRESS_NLERR		0x02
 #define RTNL_HANDLE_F_STRICT_CHK		0x04
+#define RTNL_HANDLE_F_RECVMMSG			0x08
 	int			flags;
+	/* receive buffer reused across dump, talk and listen */
+	char		       *rbuf;
+	size_t			rbuf_len;
+	size_t			rbuf_want;
+	bool			rbuf_busy;
 };
 
 struct nlmsg_list {
@@ -55,6 +63,7 @@ int rtnl_add_nl_group(struct rtnl_handle *rth, unsigned int group)
 	__attribute__((warn_unused_result));
 void rtnl_close(struct rtnl_handle *rth);
 void rtnl_set_strict_dump(struct rtnl_handle *rth);
+void rtnl_set_recvmmsg(struct rtnl_handle *rth);
 
 typedef int (*req_filter_fn_t)(struct nlmsghdr *nlh, int reqlen);
 
@@ -162,6 +171,8 @@ int rtnl_dump_filter_nc(struct rtnl_handle *rth,
 			void *arg, __u16 nc_flags);
 #define rtnl_dump_filter(rth, filter, arg) \
 	rtnl_dump_filter_nc(rth, filter, arg, 0)
+int rtnl_dump_filter_buf(struct rtnl_handle *rth, char *buf, int len,
+			 rtnl_filter_t filter, void *arg1, int *dump_intr);
 int rtnl_dump_filter_errhndlr_nc(struct rtnl_handle *rth,
 				 rtnl_filter_t filter,
 				 void *arg1,
@@ -180,6 +191,9 @@ int rtnl_talk(struct rtnl_handle *rtnl, struct nlmsghdr *n,
 int rtnl_talk_suppress_rtnl_errmsg(struct rtnl_handle *rtnl, struct nlmsghdr *n,
 				   struct nlmsghdr **answer)
 	__attribute__((warn_unused_result));
+int rtnl_talk_iov(struct rtnl_handle *rtnl, struct iovec *iov, size_t iovlen,
+		  rtnl_err_hndlr_t errhndlr, void *arg)
+	__attribute__((warn_unused_result));
 int rtnl_send(struct rtnl_handle *rth, const void *buf, int)
 	__attribute__((warn_unused_result));
 int rtnl_send_check(struct rtnl_handle *rth, const void *buf, int)
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __STATS_SHM_H__
+#define __STATS_SHM_H__
+
+#include <stddef.h>
+#include <linux/types.h>
+
+/*
+ * Snapshot of the ifstat/nstat daemon database in shared memory.
+ *
+ * The daemon passes a read-only descriptor of it with SCM_RIGHTS to
+ * whoever connects to the abstract unix socket "<tool><uid>.shm". The
+ * mapping starts with struct stats_shm_hdr, followed by @nrec records
+ * of @rec_size bytes. @seq is odd while the daemon updates the table:
+ * readers copy what they need and retry when @seq was odd or changed
+ * meanwhile. The file only grows, remap it when it is bigger than the
+ * current mapping.
+ */
+#define STATS_SHM_MAGIC		0x31544d53	/* "SMT1" */
+#define STATS_SHM_SOURCE_LEN	128
+
+struct stats_shm_hdr {
+	__u32	magic;
+	__u32	seq;
+	__u32	rec_size;
+	__u32	nrec;
+	__u64	stamp_ms;	/* wall clock time of the scan */
+	char	source[STATS_SHM_SOURCE_LEN];
+};
+
+#define STATS_SHM_IFSTAT_MAX	32
+
+struct stats_shm_ifstat {
+	__s32	ifindex;
+	__u32	nval;
+	char	name[16];
+	__u64	val[STATS_SHM_IFSTAT_MAX];
+	double	rate[STATS_SHM_IFSTAT_MAX];
+};
+
+struct stats_shm_nstat {
+	char	id[64];
+	__u64	val;
+	double	rate;
+};
+
+struct stats_shm {
+	int			fd;
+	int			ro_fd;
+	struct stats_shm_hdr	*hdr;
+	size_t			size;
+};
+
+/* daemon side */
+int stats_shm_create(struct stats_shm *shm);
+int stats_shm_listen(const char *tool);
+void stats_shm_serve(struct stats_shm *shm, int listen_fd);
+void *stats_shm_write_begin(struct stats_shm *shm, __u32 rec_size,
+			    __u32 nrec, const char *source);
+void stats_shm_write_end(struct stats_shm *shm);
+
+/* client side */
+int stats_shm_open(struct stats_shm *shm, const char *tool);
+void *stats_shm_read(struct stats_shm *shm, __u32 rec_size, __u32 *nrec,
+		     char *source, size_t len);
+
+void stats_shm_close(struct stats_shm *shm);
+
+#endif /* __STATS_SHM_H__ */
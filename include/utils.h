@@ -339,6 +339,11 @@ int get_time64(__s64 *time, const char *str);
 char *sprint_time(__u32 time, char *buf);
 char *sprint_time64(__s64 time, char *buf);
 
+/* Returned by a do_batch() command to end the batch without reporting
+ * the current line.
+ */
+#define BATCH_STOP	(-0x7fff)
+
 int do_batch(const char *name, bool force,
 	     int (*cmd)(int argc, char *argv[], void *user), void *user);
 
@@ -20,6 +20,7 @@
 #include "namespace.h"
 #include "color.h"
 #include "rt_names.h"
+#include "ll_map.h"
 #include "bpf_util.h"
 
 #ifndef LIBDIR
@@ -38,6 +39,7 @@ int timestamp;
 int echo_request;
 int force;
 int max_flush_loops = 10;
+int max_jobs = 1;
 int batch_mode;
 bool do_all;
 
@@ -73,6 +75,7 @@ static void usage(void)
 		"                    -l[oops] { maximum-addr-flush-attempts } | -echo | -br[ief] |\n"
 		"                    -o[neline] | -t[imestamp] | -ts[hort] | -b[atch] [filename] |\n"
 		"                    -rc[vbuf] [size] | -n[etns] name | -N[umeric] | -a[ll] |\n"
+		"                    -jo[bs] N |\n"
 		"                    -c[olor]}\n");
 	exit(-1);
 }
@@ -129,8 +132,11 @@ static int do_cmd(const char *argv0, int argc, char **argv, bool final)
 	const struct cmd *c;
 
 	for (c = cmds; c->cmd; ++c) {
-		if (matches(argv0, c->cmd) == 0)
-			return -(c->func(argc-1, argv+1));
+		if (matches(argv0, c->cmd) == 0) {
+			int ret = -(c->func(argc-1, argv+1));
+
+			return json_obj_failed() ? EXIT_FAILURE : ret;
+		}
 	}
 
 	if (final)
@@ -138,6 +144,77 @@ static int do_cmd(const char *argv0, int argc, char **argv, bool final)
 	return EXIT_FAILURE;
 }
 
+static bool is_netns_cmd(const char *argv0)
+{
+	const struct cmd *c;
+
+	for (c = cmds; c->cmd; ++c) {
+		if (matches(argv0, c->cmd) == 0)
+			return c->func == do_netns;
+	}
+	return false;
+}
+
+/* Verbs that only read state, and so can be run in all network namespaces.
+ * Exact verbs only: the object parsers read abbreviations such as "s",
+ * "d" or "l" as set, delete or link.
+ */
+static bool is_show_verb(const char *verb)
+{
+	return strcmp(verb, "show") == 0 || strcmp(verb, "list") == 0 ||
+	       strcmp(verb, "lst") == 0;
+}
+
+struct ip_netns_cmd {
+	int argc;
+	char **argv;
+};
+
+/* Called in a child process, from within the network namespace */
+static int ip_netns_cmd(char *nsname, void *arg)
+{
+	struct ip_netns_cmd *cmd = arg;
+
+	rtnl_close(&rth);
+	ll_flush_map();
+	netns_map_fini();
+
+	if (rtnl_open(&rth, 0) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink in netns %s\n", nsname);
+		return EXIT_FAILURE;
+	}
+	rtnl_set_strict_dump(&rth);
+
+	return do_cmd(cmd->argv[0], cmd->argc, cmd->argv, true);
+}
+
+/* Run a show command in all named network namespaces. Unlike "ip -all
+ * netns exec ip ...", ip is not exec'ed and initialized again for each
+ * of them, only forked.
+ */
+static int do_cmd_all_netns(int argc, char **argv)
+{
+	struct ip_netns_cmd cmd = {
+		.argc = argc,
+		.argv = argv,
+	};
+	int ret;
+
+	if (argc < 2 || !is_show_verb(argv[1])) {
+		fprintf(stderr,
+			"-all is only supported with show, list or lst, try \"ip -all netns exec\".\n");
+		return EXIT_FAILURE;
+	}
+
+	new_json_obj(json);
+	ret = netns_foreach_run(ip_netns_cmd, &cmd);
+	if (delete_json_obj())
+		ret = -1;
+
+	rtnl_close(&rth);
+	return ret ? EXIT_FAILURE : 0;
+}
+
 static int ip_batch_cmd(int argc, char *argv[], void *data)
 {
 	const int *orig_family = data;
@@ -264,6 +341,14 @@ int main(int argc, char **argv)
 			++brief;
 		} else if (matches(opt, "-json") == 0) {
 			++json;
+		} else if (matches(opt, "-jobs") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				usage();
+			if (get_integer(&max_jobs, argv[1], 0) ||
+			    max_jobs < 1 || max_jobs > 4096)
+				invarg("invalid number of jobs", argv[1]);
 		} else if (matches(opt, "-pretty") == 0) {
 			++pretty;
 		} else if (matches(opt, "-rcvbuf") == 0) {
@@ -319,6 +404,10 @@ int main(int argc, char **argv)
 			return ret;
 	}
 
+	/* "netns" handles -all itself */
+	if (do_all && argc > 1 && !is_netns_cmd(argv[1]))
+		return do_cmd_all_netns(argc-1, argv+1);
+
 	if (argc > 1)
 		return do_cmd(argv[1], argc-1, argv+1, true);
 
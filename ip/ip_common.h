@@ -8,6 +8,7 @@
 #include "json_print.h"
 
 extern int use_iec;
+extern int max_jobs;
 
 struct link_filter {
 	int ifindex;
@@ -20,9 +21,7 @@ struct link_filter {
 	int up;
 	char *label;
 	int flushed;
-	char *flushb;
-	int flushp;
-	int flushe;
+	int flush;
 	int group;
 	int master;
 	char *kind;
@@ -51,6 +50,7 @@ void ipneigh_reset_filter(int ifindex);
 void ipnetconf_reset_filter(int ifindex);
 
 int print_route(struct nlmsghdr *n, void *arg);
+int do_iproute_mirror(int argc, char **argv);
 int print_mroute(struct nlmsghdr *n, void *arg);
 int print_prefix(struct nlmsghdr *n, void *arg);
 int print_rule(struct nlmsghdr *n, void *arg);
@@ -59,6 +59,7 @@ int print_netconf(struct rtnl_ctrl_data *ctrl,
 int print_nexthop_bucket(struct nlmsghdr *n, void *arg);
 void netns_map_init(void);
 void netns_nsid_socket_init(void);
+void netns_map_fini(void);
 int print_nsid(struct nlmsghdr *n, void *arg);
 int ipstats_print(struct nlmsghdr *n, void *arg);
 char *get_name_from_nsid(int nsid);
@@ -99,6 +100,12 @@ int do_ipstats(int argc, char **argv);
 int iplink_get(char *name, __u32 filt_mask);
 int iplink_ifla_xstats(int argc, char **argv);
 
+int ipflush_open(int ignore);
+int ipflush_add(const struct nlmsghdr *n, __u16 type);
+int ipflush_update(void);
+void ipflush_print_rate(void);
+void ipflush_close(void);
+
 int ip_link_list(req_filter_fn_t filter_fn, struct nlmsg_chain *linfo);
 void free_nlmsg_chain(struct nlmsg_chain *info);
 
@@ -1374,26 +1374,6 @@ int print_linkinfo(struct nlmsghdr *n, void *arg)
 	return 1;
 }
 
-static int flush_update(void)
-{
-
-	/*
-	 * Note that the kernel may delete multiple addresses for one
-	 * delete request (e.g. if ipv4 address promotion is disabled).
-	 * Since a flush operation is really a series of delete requests
-	 * its possible that we may request an address delete that has
-	 * already been done by the kernel. Therefore, ignore EADDRNOTAVAIL
-	 * errors returned from a flush request
-	 */
-	if ((rtnl_send_check(&rth, filter.flushb, filter.flushp) < 0) &&
-	    (errno != EADDRNOTAVAIL)) {
-		perror("Failed to send flush request");
-		return -1;
-	}
-	filter.flushp = 0;
-	return 0;
-}
-
 static int set_lifetime(unsigned int *lifetime, char *argv)
 {
 	if (strcmp(argv, "forever") == 0)
@@ -1548,7 +1528,7 @@ int print_addrinfo(struct nlmsghdr *n, void *arg)
 		return -1;
 	}
 
-	if (filter.flushb && n->nlmsg_type != RTM_NEWADDR)
+	if (filter.flush && n->nlmsg_type != RTM_NEWADDR)
 		return 0;
 
 	parse_rtattr(rta_tb, IFA_MAX, IFA_RTA(ifa),
@@ -1580,19 +1560,9 @@ int print_addrinfo(struct nlmsghdr *n, void *arg)
 	if (inet_addr_match_rta(&filter.pfx, rta_tb[IFA_LOCAL]))
 		return 0;
 
-	if (filter.flushb) {
-		struct nlmsghdr *fn;
-
-		if (NLMSG_ALIGN(filter.flushp) + n->nlmsg_len > filter.flushe) {
-			if (flush_update())
-				return -1;
-		}
-		fn = (struct nlmsghdr *)(filter.flushb + NLMSG_ALIGN(filter.flushp));
-		memcpy(fn, n, n->nlmsg_len);
-		fn->nlmsg_type = RTM_DELADDR;
-		fn->nlmsg_flags = NLM_F_REQUEST;
-		fn->nlmsg_seq = ++rth.seq;
-		filter.flushp = (((char *)fn) + n->nlmsg_len) - filter.flushb;
+	if (filter.flush) {
+		if (ipflush_add(n, RTM_DELADDR) < 0)
+			return -1;
 		filter.flushed++;
 		if (show_stats < 2)
 			return 0;
@@ -1604,7 +1574,7 @@ int print_addrinfo(struct nlmsghdr *n, void *arg)
 	if (!brief) {
 		const char *name;
 
-		if (filter.oneline || filter.flushb || echo_request) {
+		if (filter.oneline || filter.flush || echo_request) {
 			const char *dev = ll_index_to_name(ifa->ifa_index);
 
 			if (is_json_context()) {
@@ -1976,11 +1946,19 @@ static int ipaddr_dump_filter(struct nlmsghdr *nlh, int reqlen)
 static int ipaddr_flush(void)
 {
 	int round = 0;
-	char flushb[4096-512];
+	int ret = 1;
 
-	filter.flushb = flushb;
-	filter.flushp = 0;
-	filter.flushe = sizeof(flushb);
+	/*
+	 * Note that the kernel may delete multiple addresses for one
+	 * delete request (e.g. if ipv4 address promotion is disabled).
+	 * Since a flush operation is really a series of delete requests
+	 * its possible that we may request an address delete that has
+	 * already been done by the kernel. Therefore, ignore EADDRNOTAVAIL
+	 * errors returned from a flush request
+	 */
+	if (ipflush_open(EADDRNOTAVAIL) < 0)
+		return 1;
+	filter.flush = 1;
 
 	while ((max_flush_loops == 0) || (round < max_flush_loops)) {
 		if (rtnl_addrdump_req(&rth, filter.family,
@@ -1997,17 +1975,20 @@ static int ipaddr_flush(void)
 		if (filter.flushed == 0) {
  flush_done:
 			if (show_stats) {
-				if (round == 0)
+				if (round == 0) {
 					printf("Nothing to flush.\n");
-				else
+				} else {
 					printf("*** Flush is complete after %d round%s ***\n", round, round > 1?"s":"");
+					ipflush_print_rate();
+				}
 			}
 			fflush(stdout);
-			return 0;
+			ret = 0;
+			goto out;
 		}
 		round++;
-		if (flush_update() < 0)
-			return 1;
+		if (ipflush_update() < 0)
+			goto out;
 
 		if (show_stats) {
 			printf("\n*** Round %d, deleting %d addresses ***\n", round, filter.flushed);
@@ -2024,7 +2005,9 @@ static int ipaddr_flush(void)
 	}
 	fprintf(stderr, "*** Flush remains incomplete after %d rounds. ***\n", max_flush_loops);
 	fflush(stderr);
-	return 1;
+out:
+	ipflush_close();
+	return ret;
 }
 
 static int iplink_filter_req(struct nlmsghdr *nlh, int reqlen)
@@ -0,0 +1,208 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * ipflush.c		Bulk deletion for "ip route/neigh/address flush".
+ *
+ * Delete requests built from a dump are packed into one large buffer
+ * and sent on a dedicated socket, so they keep going out while the dump
+ * is still being received on the main one. rtnetlink handles requests
+ * synchronously in sendmsg() and answers only those that failed, so the
+ * errors are collected without blocking after every send.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "utils.h"
+#include "ip_common.h"
+
+/* The kernel doubles these, rmem_max/wmem_max may cap them */
+#define IPFLUSH_SNDBUF		(1024 * 1024)
+#define IPFLUSH_RCVBUF		(4 * 1024 * 1024)
+/* Receive queue charge of one error reply, rounded up */
+#define IPFLUSH_ERR_TRUESIZE	1024
+
+static struct {
+	struct rtnl_handle rth;
+	char *buf;
+	int size;
+	int len;
+	int count;
+	int max_count;
+	int ignore;
+	unsigned int total;
+	struct timeval start;
+} ipflush;
+
+static int ipflush_sockbuf(int opt, int force_opt, int size)
+{
+	socklen_t len = sizeof(size);
+
+	/* flushing needs CAP_NET_ADMIN anyway, so try to go past the limit */
+	if (setsockopt(ipflush.rth.fd, SOL_SOCKET, force_opt,
+		       &size, sizeof(size)) < 0 &&
+	    setsockopt(ipflush.rth.fd, SOL_SOCKET, opt,
+		       &size, sizeof(size)) < 0)
+		return -1;
+
+	if (getsockopt(ipflush.rth.fd, SOL_SOCKET, opt, &size, &len) < 0)
+		return -1;
+
+	return size;
+}
+
+/* Open the delete socket, errors equal to @ignore are not reported */
+int ipflush_open(int ignore)
+{
+	int sndbuf, rcvbuf;
+	int one = 1;
+
+	if (rtnl_open(&ipflush.rth, 0) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink\n");
+		return -1;
+	}
+
+	/* errors only need the header of the failed request */
+	setsockopt(ipflush.rth.fd, SOL_NETLINK, NETLINK_CAP_ACK,
+		   &one, sizeof(one));
+
+	sndbuf = ipflush_sockbuf(SO_SNDBUF, SO_SNDBUFFORCE, IPFLUSH_SNDBUF);
+	rcvbuf = ipflush_sockbuf(SO_RCVBUF, SO_RCVBUFFORCE, IPFLUSH_RCVBUF);
+	if (sndbuf < 0 || rcvbuf < 0) {
+		perror("Cannot set flush socket buffers");
+		goto err;
+	}
+
+	/*
+	 * A send must fit in the socket send buffer, and the errors it may
+	 * cause must fit in the receive queue or they would be lost.
+	 */
+	ipflush.size = sndbuf / 2;
+	ipflush.max_count = rcvbuf / IPFLUSH_ERR_TRUESIZE;
+	if (ipflush.max_count < 1)
+		ipflush.max_count = 1;
+
+	ipflush.buf = malloc(ipflush.size);
+	if (!ipflush.buf) {
+		perror("malloc");
+		goto err;
+	}
+
+	ipflush.len = 0;
+	ipflush.count = 0;
+	ipflush.total = 0;
+	ipflush.ignore = ignore;
+	gettimeofday(&ipflush.start, NULL);
+
+	return 0;
+err:
+	rtnl_close(&ipflush.rth);
+	return -1;
+}
+
+static int ipflush_errors(void)
+{
+	char resp[4096];
+	struct nlmsghdr *h;
+	int status;
+
+	for (;;) {
+		status = recv(ipflush.rth.fd, resp, sizeof(resp), MSG_DONTWAIT);
+		if (status < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return 0;
+			perror("Cannot receive flush errors");
+			return -1;
+		}
+
+		for (h = (struct nlmsghdr *)resp; NLMSG_OK(h, status);
+		     h = NLMSG_NEXT(h, status)) {
+			struct nlmsgerr *err = NLMSG_DATA(h);
+
+			if (h->nlmsg_type != NLMSG_ERROR)
+				continue;
+			if (h->nlmsg_len < NLMSG_LENGTH(sizeof(*err))) {
+				fprintf(stderr, "ERROR truncated\n");
+				return -1;
+			}
+			if (!err->error || -err->error == ipflush.ignore)
+				continue;
+
+			errno = -err->error;
+			perror("Failed to send flush request");
+			return -1;
+		}
+	}
+}
+
+/* Send what is queued and collect the errors reported so far */
+int ipflush_update(void)
+{
+	if (ipflush.len) {
+		if (send(ipflush.rth.fd, ipflush.buf, ipflush.len, 0) < 0) {
+			perror("Failed to send flush request");
+			return -1;
+		}
+		ipflush.total += ipflush.count;
+		ipflush.len = 0;
+		ipflush.count = 0;
+	}
+
+	return ipflush_errors();
+}
+
+/* Queue a delete of type @type for the object described by @n */
+int ipflush_add(const struct nlmsghdr *n, __u16 type)
+{
+	struct nlmsghdr *fn;
+
+	if (n->nlmsg_len > ipflush.size) {
+		fprintf(stderr, "Flush request too large\n");
+		return -1;
+	}
+
+	if (ipflush.len &&
+	    (NLMSG_ALIGN(ipflush.len) + n->nlmsg_len > ipflush.size ||
+	     ipflush.count >= ipflush.max_count)) {
+		if (ipflush_update() < 0)
+			return -1;
+	}
+
+	fn = (struct nlmsghdr *)(ipflush.buf + NLMSG_ALIGN(ipflush.len));
+	memcpy(fn, n, n->nlmsg_len);
+	fn->nlmsg_type = type;
+	fn->nlmsg_flags = NLM_F_REQUEST;
+	fn->nlmsg_seq = ++ipflush.rth.seq;
+	ipflush.len = NLMSG_ALIGN(ipflush.len) + n->nlmsg_len;
+	ipflush.count++;
+
+	return 0;
+}
+
+void ipflush_print_rate(void)
+{
+	struct timeval now;
+	double secs;
+
+	if (!ipflush.total)
+		return;
+
+	gettimeofday(&now, NULL);
+	secs = (now.tv_sec - ipflush.start.tv_sec) +
+	       (now.tv_usec - ipflush.start.tv_usec) / 1000000.;
+
+	printf("*** %u deleted in %.3f seconds, %.0f/s ***\n",
+	       ipflush.total, secs, secs > 0 ? ipflush.total / secs : 0.);
+}
+
+void ipflush_close(void)
+{
+	rtnl_close(&ipflush.rth);
+	free(ipflush.buf);
+	ipflush.buf = NULL;
+}
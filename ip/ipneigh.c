@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -31,9 +32,7 @@ static struct
 	int unused_only;
 	inet_prefix pfx;
 	int flushed;
-	char *flushb;
-	int flushp;
-	int flushe;
+	int flush;
 	int master;
 	int protocol;
 	__u8 ndm_flags;
@@ -87,16 +86,6 @@ static int nud_state_a2n(unsigned int *state, const char *arg)
 	return 0;
 }
 
-static int flush_update(void)
-{
-	if (rtnl_send_check(&rth, filter.flushb, filter.flushp) < 0) {
-		perror("Failed to send flush request");
-		return -1;
-	}
-	filter.flushp = 0;
-	return 0;
-}
-
 
 static int ipneigh_modify(int cmd, int flags, int argc, char **argv)
 {
@@ -324,7 +313,7 @@ int print_neigh(struct nlmsghdr *n, void *arg)
 		return -1;
 	}
 
-	if (filter.flushb && n->nlmsg_type != RTM_NEWNEIGH)
+	if (filter.flush && n->nlmsg_type != RTM_NEWNEIGH)
 		return 0;
 
 	if (filter.family && filter.family != r->ndm_family)
@@ -365,19 +354,9 @@ int print_neigh(struct nlmsghdr *n, void *arg)
 			return 0;
 	}
 
-	if (filter.flushb) {
-		struct nlmsghdr *fn;
-
-		if (NLMSG_ALIGN(filter.flushp) + n->nlmsg_len > filter.flushe) {
-			if (flush_update())
-				return -1;
-		}
-		fn = (struct nlmsghdr *)(filter.flushb + NLMSG_ALIGN(filter.flushp));
-		memcpy(fn, n, n->nlmsg_len);
-		fn->nlmsg_type = RTM_DELNEIGH;
-		fn->nlmsg_flags = NLM_F_REQUEST;
-		fn->nlmsg_seq = ++rth.seq;
-		filter.flushp = (((char *)fn) + n->nlmsg_len) - filter.flushb;
+	if (filter.flush) {
+		if (ipflush_add(n, RTM_DELNEIGH) < 0)
+			return -1;
 		filter.flushed++;
 		if (show_stats < 2)
 			return 0;
@@ -600,11 +579,11 @@ static int do_show_or_flush(int argc, char **argv, int flush)
 
 	if (flush) {
 		int round = 0;
-		char flushb[4096-512];
 
-		filter.flushb = flushb;
-		filter.flushp = 0;
-		filter.flushe = sizeof(flushb);
+		/* entries may expire on their own while being flushed */
+		if (ipflush_open(ENOENT) < 0)
+			exit(1);
+		filter.flush = 1;
 
 		while (round < MAX_ROUNDS) {
 			if (rtnl_neighdump_req(&rth, filter.family,
@@ -619,16 +598,19 @@ static int do_show_or_flush(int argc, char **argv, int flush)
 			}
 			if (filter.flushed == 0) {
 				if (show_stats) {
-					if (round == 0)
+					if (round == 0) {
 						printf("Nothing to flush.\n");
-					else
+					} else {
 						printf("*** Flush is complete after %d round%s ***\n", round, round > 1?"s":"");
+						ipflush_print_rate();
+					}
 				}
 				fflush(stdout);
+				ipflush_close();
 				return 0;
 			}
 			round++;
-			if (flush_update() < 0)
+			if (ipflush_update() < 0)
 				exit(1);
 			if (show_stats) {
 				printf("\n*** Round %d, deleting %d entries ***\n", round, filter.flushed);
@@ -638,9 +620,11 @@ static int do_show_or_flush(int argc, char **argv, int flush)
 		}
 		printf("*** Flush not complete bailing out after %d rounds\n",
 			MAX_ROUNDS);
+		ipflush_close();
 		return 1;
 	}
 
+	rtnl_set_recvmmsg(&rth);
 	if (rtnl_neighdump_req(&rth, filter.family, ipneigh_dump_filter) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
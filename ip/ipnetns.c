@@ -7,6 +7,8 @@
 #include <sys/inotify.h>
 #include <sys/mount.h>
 #include <sys/syscall.h>
+#include <poll.h>
+#include <time.h>
 #include <stdio.h>
 #include <string.h>
 #include <sched.h>
@@ -35,7 +37,7 @@ static int usage(void)
 		"	ip [-all] netns delete [NAME]\n"
 		"	ip netns identify [PID]\n"
 		"	ip netns pids NAME\n"
-		"	ip [-all] netns exec [NAME] cmd ...\n"
+		"	ip [-all [-jobs N]] netns exec [NAME] cmd ...\n"
 		"	ip netns monitor\n"
 		"	ip netns list-id [target-nsid POSITIVE-INT] [nsid POSITIVE-INT]\n"
 		"NETNSID := auto | POSITIVE-INT\n");
@@ -124,6 +126,7 @@ struct nsid_cache {
 
 static struct hlist_head	nsid_head[NSIDMAP_SIZE];
 static struct hlist_head	name_head[NSIDMAP_SIZE];
+static int			netns_map_initialized;
 
 static struct nsid_cache *netns_map_get_by_nsid(int nsid)
 {
@@ -207,12 +210,11 @@ void netns_nsid_socket_init(void)
 
 void netns_map_init(void)
 {
-	static int initialized;
 	struct dirent *entry;
 	DIR *dir;
 	int nsid;
 
-	if (initialized || !ipnetns_have_nsid())
+	if (netns_map_initialized || !ipnetns_have_nsid())
 		return;
 
 	dir = opendir(NETNS_RUN_DIR);
@@ -230,7 +232,27 @@ void netns_map_init(void)
 			netns_map_add(nsid, entry->d_name);
 	}
 	closedir(dir);
-	initialized = 1;
+	netns_map_initialized = 1;
+}
+
+/* nsids are local to the namespace they were queried from, so drop the
+ * cache and the socket when moving to another one.
+ */
+void netns_map_fini(void)
+{
+	struct hlist_node *n, *tmp;
+	int i;
+
+	for (i = 0; i < NSIDMAP_SIZE; i++) {
+		hlist_for_each_safe(n, tmp, &nsid_head[i])
+			netns_map_del(container_of(n, struct nsid_cache,
+						   nsid_hash));
+	}
+	netns_map_initialized = 0;
+
+	if (rtnsh.fd > -1)
+		rtnl_close(&rtnsh);
+	rtnsh.fd = -1;
 }
 
 static int netns_get_name(int nsid, char *name)
@@ -498,6 +520,281 @@ static int on_netns_exec(char *nsname, void *arg)
 	return 0;
 }
 
+struct netns_job {
+	char *name;
+	pid_t pid;
+	int fd[2];		/* stdout and stderr of the command */
+	char *out[2];
+	size_t len[2];
+	size_t size[2];
+	int status;
+	struct timespec start;
+	struct timespec end;
+	bool done;
+};
+
+struct netns_jobs {
+	struct netns_job *job;
+	int count;
+	int size;
+};
+
+static int netns_jobs_add(char *nsname, void *arg)
+{
+	struct netns_jobs *jobs = arg;
+	struct netns_job *job;
+
+	if (jobs->count == jobs->size) {
+		int size = jobs->size ? jobs->size * 2 : 64;
+
+		job = realloc(jobs->job, size * sizeof(*job));
+		if (!job)
+			return -1;
+		jobs->job = job;
+		jobs->size = size;
+	}
+
+	job = &jobs->job[jobs->count];
+	memset(job, 0, sizeof(*job));
+	job->name = strdup(nsname);
+	if (!job->name)
+		return -1;
+	job->pid = -1;
+	job->fd[0] = job->fd[1] = -1;
+	jobs->count++;
+	return 0;
+}
+
+static int netns_job_start(struct netns_job *job, char **argv)
+{
+	int out[2], err[2];
+
+	if (pipe2(out, O_CLOEXEC) < 0)
+		return -1;
+	if (pipe2(err, O_CLOEXEC) < 0) {
+		close(out[0]);
+		close(out[1]);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &job->start);
+	fflush(stdout);
+	fflush(stderr);
+	job->pid = fork();
+	if (job->pid < 0) {
+		close(out[0]);
+		close(out[1]);
+		close(err[0]);
+		close(err[1]);
+		return -1;
+	}
+
+	if (job->pid == 0) {
+		dup2(out[1], STDOUT_FILENO);
+		dup2(err[1], STDERR_FILENO);
+		if (do_switch(job->name))
+			_exit(1);
+		execvp(argv[0], argv);
+		fprintf(stderr, "exec of \"%s\" failed: %s\n",
+			argv[0], strerror(errno));
+		_exit(1);
+	}
+
+	close(out[1]);
+	close(err[1]);
+	job->fd[0] = out[0];
+	job->fd[1] = err[0];
+	return 0;
+}
+
+/* Returns 1 on EOF, 0 when more data may follow, -1 on error */
+static int netns_job_read(struct netns_job *job, int i)
+{
+	ssize_t n;
+
+	if (job->size[i] - job->len[i] < 4096) {
+		size_t size = job->size[i] ? job->size[i] * 2 : 16384;
+		char *out;
+
+		out = realloc(job->out[i], size);
+		if (!out)
+			return -1;
+		job->out[i] = out;
+		job->out[i][job->len[i]] = '\0';
+		job->size[i] = size;
+	}
+
+	n = read(job->fd[i], job->out[i] + job->len[i],
+		 job->size[i] - job->len[i] - 1);
+	if (n < 0)
+		return errno == EINTR || errno == EAGAIN ? 0 : -1;
+	if (n == 0) {
+		close(job->fd[i]);
+		job->fd[i] = -1;
+		return 1;
+	}
+	job->len[i] += n;
+	job->out[i][job->len[i]] = '\0';
+	return 0;
+}
+
+static void netns_job_finish(struct netns_job *job)
+{
+	int status;
+
+	while (waitpid(job->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			status = W_EXITCODE(1, 0);
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &job->end);
+
+	if (WIFEXITED(status))
+		job->status = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		job->status = 128 + WTERMSIG(status);
+	else
+		job->status = 1;
+	job->done = true;
+}
+
+static void netns_job_print(struct netns_job *job)
+{
+	double elapsed;
+
+	elapsed = (job->end.tv_sec - job->start.tv_sec) +
+		  (job->end.tv_nsec - job->start.tv_nsec) / 1e9;
+
+	if (is_json_context()) {
+		open_json_object(NULL);
+		print_string(PRINT_JSON, "name", NULL, job->name);
+		print_int(PRINT_JSON, "status", NULL, job->status);
+		print_float(PRINT_JSON, "time", NULL, elapsed);
+		print_string(PRINT_JSON, "stdout", NULL,
+			     job->out[0] ? : "");
+		print_string(PRINT_JSON, "stderr", NULL,
+			     job->out[1] ? : "");
+		close_json_object();
+	} else {
+		printf("\nnetns: %s\n", job->name);
+		if (show_stats)
+			printf("status %d time %.3fs\n", job->status, elapsed);
+		if (job->len[0])
+			fwrite(job->out[0], 1, job->len[0], stdout);
+		fflush(stdout);
+		if (job->len[1])
+			fwrite(job->out[1], 1, job->len[1], stderr);
+	}
+
+	free(job->out[0]);
+	free(job->out[1]);
+	job->out[0] = job->out[1] = NULL;
+}
+
+/* Run the command in all named network namespaces, up to max_jobs of them
+ * at a time. The output of each one is captured and printed in namespace
+ * order once it and all the preceding ones have finished.
+ */
+static int netns_exec_all(char **argv)
+{
+	struct netns_jobs jobs = {};
+	struct pollfd *pfd;
+	struct netns_job **pjob;
+	int started = 0, printed = 0, running = 0;
+	int ret = 0;
+	int i, j, n;
+
+	if (netns_foreach(netns_jobs_add, &jobs)) {
+		ret = -1;
+		goto out;
+	}
+
+	pfd = calloc(2 * max_jobs, sizeof(*pfd));
+	pjob = calloc(2 * max_jobs, sizeof(*pjob));
+	if (!pfd || !pjob) {
+		ret = -1;
+		goto out_free;
+	}
+
+	new_json_obj(json);
+
+	while (printed < jobs.count) {
+		while (running < max_jobs && started < jobs.count) {
+			struct netns_job *job = &jobs.job[started++];
+
+			if (netns_job_start(job, argv)) {
+				fprintf(stderr, "netns %s: %s\n", job->name,
+					strerror(errno));
+				clock_gettime(CLOCK_MONOTONIC, &job->start);
+				job->end = job->start;
+				job->status = 1;
+				job->done = true;
+				continue;
+			}
+			running++;
+		}
+
+		while (printed < started && jobs.job[printed].done)
+			netns_job_print(&jobs.job[printed++]);
+		if (!running)
+			continue;
+
+		n = 0;
+		for (i = 0; i < started; i++) {
+			struct netns_job *job = &jobs.job[i];
+
+			if (job->done || job->pid < 0)
+				continue;
+			for (j = 0; j < 2; j++) {
+				if (job->fd[j] < 0)
+					continue;
+				pfd[n].fd = job->fd[j];
+				pfd[n].events = POLLIN;
+				pjob[n] = job;
+				n++;
+			}
+		}
+
+		if (poll(pfd, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			ret = -1;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct netns_job *job = pjob[i];
+
+			if (!pfd[i].revents)
+				continue;
+			j = pfd[i].fd == job->fd[0] ? 0 : 1;
+			if (netns_job_read(job, j) < 0) {
+				close(job->fd[j]);
+				job->fd[j] = -1;
+			}
+			if (job->fd[0] < 0 && job->fd[1] < 0) {
+				netns_job_finish(job);
+				running--;
+			}
+		}
+	}
+
+	delete_json_obj();
+out_free:
+	free(pjob);
+	free(pfd);
+out:
+	for (i = 0; i < jobs.count; i++) {
+		free(jobs.job[i].out[0]);
+		free(jobs.job[i].out[1]);
+		free(jobs.job[i].name);
+	}
+	free(jobs.job);
+	return ret;
+}
+
 static int netns_exec(int argc, char **argv)
 {
 	/* Setup the proper environment for apps that are not netns
@@ -512,6 +809,8 @@ static int netns_exec(int argc, char **argv)
 		return -1;
 	}
 
+	if (do_all && (max_jobs > 1 || json))
+		return netns_exec_all(argv);
 	if (do_all)
 		return netns_foreach(on_netns_exec, argv);
 
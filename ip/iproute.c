@@ -61,6 +61,7 @@ static void usage(void)
 		"       ip route save SELECTOR\n"
 		"       ip route restore\n"
 		"       ip route showdump\n"
+		"       ip route mirror [ socket PATH ] [ file FILE ]\n"
 		"       ip route get [ ROUTE_GET_FLAGS ] ADDRESS\n"
 		"                            [ from ADDRESS iif STRING ]\n"
 		"                            [ oif STRING ] [ tos TOS ]\n"
@@ -122,9 +123,7 @@ static struct
 	unsigned int tb;
 	int cloned;
 	int flushed;
-	char *flushb;
-	int flushp;
-	int flushe;
+	int flush;
 	int protocol, protocolmask;
 	int scope, scopemask;
 	__u64 typemask;
@@ -142,53 +141,24 @@ static struct
 	inet_prefix msrc;
 } filter;
 
-static int flush_update(void)
-{
-	if (rtnl_send_check(&rth, filter.flushb, filter.flushp) < 0) {
-		perror("Failed to send flush request");
-		return -2;
-	}
-	filter.flushp = 0;
-	return 0;
-}
+static int ip6_multiple_tables;
 
-static int filter_nlmsg(struct nlmsghdr *n, struct rtattr **tb, int host_len)
+/*
+ * The part of filter_nlmsg() that only needs the route header, so that
+ * routes can be dropped before their attributes are parsed.
+ */
+static int filter_rtmsg(const struct rtmsg *r)
 {
-	struct rtmsg *r = NLMSG_DATA(n);
-	inet_prefix dst = { .family = r->rtm_family };
-	inet_prefix src = { .family = r->rtm_family };
-	inet_prefix via = { .family = r->rtm_family };
-	inet_prefix prefsrc = { .family = r->rtm_family };
-	__u32 table;
-	static int ip6_multiple_tables;
-
-	table = rtm_get_table(r, tb);
-
 	if (preferred_family != AF_UNSPEC && r->rtm_family != preferred_family)
 		return 0;
 
-	if (r->rtm_family == AF_INET6 && table != RT_TABLE_MAIN)
+	/* rtm_table is RT_TABLE_COMPAT for ids that do not fit */
+	if (r->rtm_family == AF_INET6 && r->rtm_table != RT_TABLE_MAIN)
 		ip6_multiple_tables = 1;
 
 	if (filter.cloned == !(r->rtm_flags & RTM_F_CLONED))
 		return 0;
 
-	if (r->rtm_family == AF_INET6 && !ip6_multiple_tables) {
-		if (filter.tb) {
-			if (filter.tb == RT_TABLE_LOCAL) {
-				if (r->rtm_type != RTN_LOCAL)
-					return 0;
-			} else if (filter.tb == RT_TABLE_MAIN) {
-				if (r->rtm_type == RTN_LOCAL)
-					return 0;
-			} else {
-				return 0;
-			}
-		}
-	} else {
-		if (filter.tb > 0 && filter.tb != table)
-			return 0;
-	}
 	if ((filter.protocol^r->rtm_protocol)&filter.protocolmask)
 		return 0;
 	if ((filter.scope^r->rtm_scope)&filter.scopemask)
@@ -234,6 +204,41 @@ static int filter_nlmsg(struct nlmsghdr *n, struct rtattr **tb, int host_len)
 		    filter.msrc.bitlen < r->rtm_src_len)
 			return 0;
 	}
+	if (filter.rprefsrc.family && r->rtm_family != filter.rprefsrc.family)
+		return 0;
+
+	return 1;
+}
+
+/* Attribute checks, for routes that passed filter_rtmsg() */
+static int filter_nlmsg(struct nlmsghdr *n, struct rtattr **tb, int host_len)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	inet_prefix dst = { .family = r->rtm_family };
+	inet_prefix src = { .family = r->rtm_family };
+	inet_prefix via = { .family = r->rtm_family };
+	inet_prefix prefsrc = { .family = r->rtm_family };
+	__u32 table;
+
+	table = rtm_get_table(r, tb);
+
+	if (r->rtm_family == AF_INET6 && !ip6_multiple_tables) {
+		if (filter.tb) {
+			if (filter.tb == RT_TABLE_LOCAL) {
+				if (r->rtm_type != RTN_LOCAL)
+					return 0;
+			} else if (filter.tb == RT_TABLE_MAIN) {
+				if (r->rtm_type == RTN_LOCAL)
+					return 0;
+			} else {
+				return 0;
+			}
+		}
+	} else {
+		if (filter.tb > 0 && filter.tb != table)
+			return 0;
+	}
+
 	if (filter.rvia.family) {
 		int family = r->rtm_family;
 
@@ -245,8 +250,6 @@ static int filter_nlmsg(struct nlmsghdr *n, struct rtattr **tb, int host_len)
 		if (family != filter.rvia.family)
 			return 0;
 	}
-	if (filter.rprefsrc.family && r->rtm_family != filter.rprefsrc.family)
-		return 0;
 
 	if (tb[RTA_DST])
 		memcpy(&dst.data, RTA_DATA(tb[RTA_DST]), (r->rtm_dst_len+7)/8);
@@ -331,7 +334,7 @@ static int filter_nlmsg(struct nlmsghdr *n, struct rtattr **tb, int host_len)
 		if ((metric ^ filter.metric) & filter.metricmask)
 			return 0;
 	}
-	if (filter.flushb &&
+	if (filter.flush &&
 	    r->rtm_family == AF_INET6 &&
 	    r->rtm_dst_len == 0 &&
 	    r->rtm_type == RTN_UNREACHABLE &&
@@ -750,7 +753,6 @@ int print_route(struct nlmsghdr *n, void *arg)
 	struct rtattr *tb[RTA_MAX+1];
 	int family, color, host_len;
 	__u32 table;
-	int ret;
 
 	SPRINT_BUF(b1);
 	SPRINT_BUF(b2);
@@ -760,7 +762,7 @@ int print_route(struct nlmsghdr *n, void *arg)
 			n->nlmsg_len, n->nlmsg_type, n->nlmsg_flags);
 		return -1;
 	}
-	if (filter.flushb && n->nlmsg_type != RTM_NEWROUTE)
+	if (filter.flush && n->nlmsg_type != RTM_NEWROUTE)
 		return 0;
 	len -= NLMSG_LENGTH(sizeof(*r));
 	if (len < 0) {
@@ -768,6 +770,9 @@ int print_route(struct nlmsghdr *n, void *arg)
 		return -1;
 	}
 
+	if (!filter_rtmsg(r))
+		return 0;
+
 	host_len = af_bit_len(r->rtm_family);
 
 	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), len);
@@ -776,20 +781,9 @@ int print_route(struct nlmsghdr *n, void *arg)
 	if (!filter_nlmsg(n, tb, host_len))
 		return 0;
 
-	if (filter.flushb) {
-		struct nlmsghdr *fn;
-
-		if (NLMSG_ALIGN(filter.flushp) + n->nlmsg_len > filter.flushe) {
-			ret = flush_update();
-			if (ret < 0)
-				return ret;
-		}
-		fn = (struct nlmsghdr *)(filter.flushb + NLMSG_ALIGN(filter.flushp));
-		memcpy(fn, n, n->nlmsg_len);
-		fn->nlmsg_type = RTM_DELROUTE;
-		fn->nlmsg_flags = NLM_F_REQUEST;
-		fn->nlmsg_seq = ++rth.seq;
-		filter.flushp = (((char *)fn) + n->nlmsg_len) - filter.flushb;
+	if (filter.flush) {
+		if (ipflush_add(n, RTM_DELROUTE) < 0)
+			return -2;
 		filter.flushed++;
 		if (show_stats < 2)
 			return 0;
@@ -1637,6 +1631,9 @@ static int save_route(struct nlmsghdr *n, void *arg)
 	struct rtattr *tb[RTA_MAX+1];
 	int host_len;
 
+	if (!filter_rtmsg(r))
+		return 0;
+
 	host_len = af_bit_len(r->rtm_family);
 	len -= NLMSG_LENGTH(sizeof(*r));
 	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), len);
@@ -1676,10 +1673,23 @@ static int iproute_dump_filter(struct nlmsghdr *nlh, int reqlen)
 	struct rtmsg *rtm = NLMSG_DATA(nlh);
 	int err;
 
+	/*
+	 * Hand the kernel every selector it filters on, so that it skips
+	 * non matching routes instead of sending them to be dropped here.
+	 * Scope and prefixes are rejected by strict dump checking.
+	 */
 	rtm->rtm_protocol = filter.protocol;
 	if (filter.cloned)
 		rtm->rtm_flags |= RTM_F_CLONED;
 
+	/*
+	 * IPv4 and IPv6 match a single type, MPLS refuses any, which would
+	 * fail an AF_UNSPEC dump if it is loaded.
+	 */
+	if (filter.typemask && !(filter.typemask & (filter.typemask - 1)) &&
+	    (rtm->rtm_family == AF_INET || rtm->rtm_family == AF_INET6))
+		rtm->rtm_type = ffsll(filter.typemask) - 1;
+
 	if (filter.tb) {
 		err = addattr32(nlh, reqlen, RTA_TABLE, filter.tb);
 		if (err)
@@ -1698,9 +1708,8 @@ static int iproute_dump_filter(struct nlmsghdr *nlh, int reqlen)
 static int iproute_flush(int family, rtnl_filter_t filter_fn)
 {
 	time_t start = time(0);
-	char flushb[4096-512];
 	int round = 0;
-	int ret;
+	int ret = -2;
 
 	if (filter.cloned) {
 		if (family != AF_INET6) {
@@ -1712,41 +1721,45 @@ static int iproute_flush(int family, rtnl_filter_t filter_fn)
 			return 0;
 	}
 
-	filter.flushb = flushb;
-	filter.flushp = 0;
-	filter.flushe = sizeof(flushb);
+	/* a route may already be gone with its nexthop or device */
+	if (ipflush_open(ESRCH) < 0)
+		return -2;
+	filter.flush = 1;
 
 	for (;;) {
 		if (rtnl_routedump_req(&rth, family, iproute_dump_filter) < 0) {
 			perror("Cannot send dump request");
-			return -2;
+			break;
 		}
 		filter.flushed = 0;
 		if (rtnl_dump_filter(&rth, filter_fn, stdout) < 0) {
 			fprintf(stderr, "Flush terminated\n");
-			return -2;
+			break;
 		}
 		if (filter.flushed == 0) {
 			if (show_stats) {
 				if (round == 0 &&
-				    (!filter.cloned || family == AF_INET6))
+				    (!filter.cloned || family == AF_INET6)) {
 					printf("Nothing to flush.\n");
-				else
+				} else {
 					printf("*** Flush is complete after %d round%s ***\n",
 					       round, round > 1 ? "s" : "");
+					ipflush_print_rate();
+				}
 			}
 			fflush(stdout);
-			return 0;
+			ret = 0;
+			break;
 		}
 		round++;
-		ret = flush_update();
-		if (ret < 0)
-			return ret;
+		if (ipflush_update() < 0)
+			break;
 
 		if (time(0) - start > 30) {
 			printf("\n*** Flush not completed after %ld seconds, %d entries remain ***\n",
 			       (long)(time(0) - start), filter.flushed);
-			return -1;
+			ret = -1;
+			break;
 		}
 
 		if (show_stats) {
@@ -1755,6 +1768,9 @@ static int iproute_flush(int family, rtnl_filter_t filter_fn)
 			fflush(stdout);
 		}
 	}
+
+	ipflush_close();
+	return ret;
 }
 
 static int save_route_errhndlr(struct nlmsghdr *n, void *arg)
@@ -1974,6 +1990,7 @@ static int iproute_list_flush_or_save(int argc, char **argv, int action)
 	if (action == IPROUTE_FLUSH)
 		return iproute_flush(dump_family, filter_fn);
 
+	rtnl_set_recvmmsg(&rth);
 	if (rtnl_routedump_req(&rth, dump_family, iproute_dump_filter) < 0) {
 		perror("Cannot send dump request");
 		return -2;
@@ -2398,6 +2415,8 @@ int do_iproute(int argc, char **argv)
 		return iproute_list_flush_or_save(argc-1, argv+1, IPROUTE_SAVE);
 	if (matches(*argv, "restore") == 0)
 		return iproute_restore();
+	if (strcmp(*argv, "mirror") == 0)
+		return do_iproute_mirror(argc-1, argv+1);
 	if (matches(*argv, "showdump") == 0)
 		return iproute_showdump();
 	if (matches(*argv, "help") == 0)
@@ -0,0 +1,814 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * iproute_mirror.c	"ip route mirror": keep a copy of the routing tables
+ *			and answer route lookups from it over a unix socket.
+ *
+ * The tables are dumped once and then kept current from route
+ * notifications, the way "ip monitor route" receives them. When the
+ * notification socket overruns, the copy is dropped and dumped again.
+ * Routes live in one path compressed trie per family, so a lookup is a
+ * walk down the address bits and does not involve the kernel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "rt_names.h"
+#include "utils.h"
+#include "ip_common.h"
+
+#define MIRROR_SOCKET		"ip-route-mirror"
+#define MIRROR_MAX_CLIENTS	64
+#define MIRROR_LINE_MAX		512
+
+struct mirror_route {
+	struct mirror_route	*next;
+	__u32			table;
+	__u32			priority;
+	__u8			tos;
+	__u8			src_len;
+	__u8			src[16];
+	struct nlmsghdr		*n;
+};
+
+struct mirror_node {
+	struct mirror_node	*child[2];
+	struct mirror_route	*routes;
+	int			len;
+	__u8			key[16];
+};
+
+struct mirror_client {
+	int	fd;
+	int	len;
+	char	buf[MIRROR_LINE_MAX];
+};
+
+static struct mirror_node *mirror_root[2];
+static struct rtnl_handle mirror_ev = { .fd = -1 };
+static struct mirror_client mirror_clients[MIRROR_MAX_CLIENTS];
+static int mirror_nclients;
+static int mirror_stdout = -1;
+
+static struct {
+	__u64	routes;
+	__u64	lookups;
+	__u64	lookup_ns;
+	__u64	lookup_ns_max;
+	__u64	events;
+	__u64	apply_us;
+	__u64	apply_us_max;
+	__u64	resyncs;
+	__u64	overruns;
+} mirror_stats;
+
+static void usage(void) __attribute__((noreturn));
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: ip route mirror [ socket PATH ] [ file FILE ]\n"
+		"Requests, one per line:\n"
+		"       get ADDRESS [ table TABLE_ID ]\n"
+		"       stats\n");
+	exit(-1);
+}
+
+static __u64 mirror_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int mirror_family_idx(int family)
+{
+	switch (family) {
+	case AF_INET:
+		return 0;
+	case AF_INET6:
+		return 1;
+	}
+	return -1;
+}
+
+static int key_bit(const __u8 *key, int i)
+{
+	return (key[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+/* Index of the first bit where @a and @b differ, at most @max */
+static int key_diff(const __u8 *a, const __u8 *b, int max)
+{
+	int i;
+
+	for (i = 0; i < max; i += 8) {
+		__u8 x = a[i >> 3] ^ b[i >> 3];
+
+		if (x) {
+			i += __builtin_clz(x) - 24;
+			return i < max ? i : max;
+		}
+	}
+	return max;
+}
+
+static struct mirror_node *node_new(const __u8 *key, int len)
+{
+	struct mirror_node *node = calloc(1, sizeof(*node));
+
+	if (!node)
+		return NULL;
+
+	node->len = len;
+	memcpy(node->key, key, (len + 7) / 8);
+	if (len & 7)
+		node->key[len >> 3] &= 0xff << (8 - (len & 7));
+	return node;
+}
+
+/* Find or create the node for @key/@len below *@np */
+static struct mirror_node *node_get(struct mirror_node **np,
+				    const __u8 *key, int len)
+{
+	struct mirror_node *node, *glue, *leaf;
+	int diff;
+
+	while ((node = *np) != NULL) {
+		diff = key_diff(node->key, key, min(node->len, len));
+		if (diff == node->len && diff == len)
+			return node;
+		if (diff == node->len) {
+			np = &node->child[key_bit(key, node->len)];
+			continue;
+		}
+
+		/* @key is a prefix of node, or they fork at @diff */
+		if (diff == len) {
+			leaf = node_new(key, len);
+			if (!leaf)
+				return NULL;
+			leaf->child[key_bit(node->key, len)] = node;
+			*np = leaf;
+			return leaf;
+		}
+
+		glue = node_new(key, diff);
+		leaf = node_new(key, len);
+		if (!glue || !leaf) {
+			free(glue);
+			free(leaf);
+			return NULL;
+		}
+		glue->child[key_bit(node->key, diff)] = node;
+		glue->child[key_bit(key, diff)] = leaf;
+		*np = glue;
+		return leaf;
+	}
+
+	*np = node_new(key, len);
+	return *np;
+}
+
+/* Slot pointing to the node for exactly @key/@len, NULL if none */
+static struct mirror_node **node_find(struct mirror_node **np,
+				      const __u8 *key, int len,
+				      struct mirror_node ***parent)
+{
+	struct mirror_node *node;
+
+	*parent = NULL;
+	while ((node = *np) != NULL && node->len <= len) {
+		if (key_diff(node->key, key, node->len) != node->len)
+			return NULL;
+		if (node->len == len)
+			return np;
+		*parent = np;
+		np = &node->child[key_bit(key, node->len)];
+	}
+	return NULL;
+}
+
+/* Unlink a node that has no routes left, and a parent left as glue */
+static void node_prune(struct mirror_node **np, struct mirror_node **pp)
+{
+	struct mirror_node *node = *np;
+
+	if (node->routes || (node->child[0] && node->child[1]))
+		return;
+
+	*np = node->child[0] ? : node->child[1];
+	free(node);
+
+	if (pp) {
+		node = *pp;
+		if (!node->routes && !(node->child[0] && node->child[1])) {
+			*pp = node->child[0] ? : node->child[1];
+			free(node);
+		}
+	}
+}
+
+static void node_free(struct mirror_node *node)
+{
+	struct mirror_route *rt, *next;
+
+	if (!node)
+		return;
+
+	node_free(node->child[0]);
+	node_free(node->child[1]);
+	for (rt = node->routes; rt; rt = next) {
+		next = rt->next;
+		free(rt);
+	}
+	free(node);
+}
+
+static void mirror_flush(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mirror_root); i++) {
+		node_free(mirror_root[i]);
+		mirror_root[i] = NULL;
+	}
+	mirror_stats.routes = 0;
+}
+
+static int rt_payload_eq(const struct nlmsghdr *a, const struct nlmsghdr *b)
+{
+	return a->nlmsg_len == b->nlmsg_len &&
+	       !memcmp(NLMSG_DATA(a), NLMSG_DATA(b),
+		       a->nlmsg_len - NLMSG_HDRLEN);
+}
+
+static int rt_key_eq(const struct mirror_route *a, const struct mirror_route *b)
+{
+	return a->table == b->table && a->priority == b->priority &&
+	       a->tos == b->tos && a->src_len == b->src_len &&
+	       !memcmp(a->src, b->src, sizeof(a->src));
+}
+
+static struct mirror_route *rt_new(struct nlmsghdr *n)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct rtattr *tb[RTA_MAX + 1];
+	struct mirror_route *rt;
+
+	rt = calloc(1, sizeof(*rt) + n->nlmsg_len);
+	if (!rt)
+		return NULL;
+
+	rt->n = (struct nlmsghdr *)(rt + 1);
+	memcpy(rt->n, n, n->nlmsg_len);
+
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), RTM_PAYLOAD(n));
+	rt->table = rtm_get_table(r, tb);
+	rt->tos = r->rtm_tos;
+	rt->src_len = r->rtm_src_len;
+	if (tb[RTA_PRIORITY])
+		rt->priority = rta_getattr_u32(tb[RTA_PRIORITY]);
+	if (tb[RTA_SRC])
+		memcpy(rt->src, RTA_DATA(tb[RTA_SRC]),
+		       min((size_t)RTA_PAYLOAD(tb[RTA_SRC]), sizeof(rt->src)));
+	return rt;
+}
+
+/*
+ * Apply one route message. A route that is already there, as happens
+ * with notifications queued while dumping, is not added twice. IPv6
+ * has a single route per key, IPv4 may append several.
+ */
+static int mirror_update(struct nlmsghdr *n)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct mirror_node **np, **pp, *node;
+	struct mirror_route *rt, **rp;
+	__u8 dst[16] = {};
+	struct rtattr *a;
+	int idx;
+
+	if (n->nlmsg_type != RTM_NEWROUTE && n->nlmsg_type != RTM_DELROUTE)
+		return 0;
+	if (n->nlmsg_len < NLMSG_LENGTH(sizeof(*r)))
+		return -1;
+	if (r->rtm_flags & RTM_F_CLONED)
+		return 0;
+
+	idx = mirror_family_idx(r->rtm_family);
+	if (idx < 0 || r->rtm_dst_len > 8 * sizeof(dst))
+		return 0;
+
+	a = RTM_RTA(r);
+	a = parse_rtattr_one(RTA_DST, a, RTM_PAYLOAD(n));
+	if (a)
+		memcpy(dst, RTA_DATA(a),
+		       min((size_t)RTA_PAYLOAD(a), sizeof(dst)));
+
+	rt = rt_new(n);
+	if (!rt)
+		return -1;
+
+	if (n->nlmsg_type == RTM_DELROUTE) {
+		struct mirror_route **match = NULL;
+
+		np = node_find(&mirror_root[idx], dst, r->rtm_dst_len, &pp);
+		if (!np) {
+			free(rt);
+			return 0;
+		}
+		for (rp = &(*np)->routes; *rp; rp = &(*rp)->next) {
+			if (rt_payload_eq((*rp)->n, n)) {
+				match = rp;
+				break;
+			}
+			if (!match && rt_key_eq(*rp, rt))
+				match = rp;
+		}
+		free(rt);
+		if (match) {
+			struct mirror_route *old = *match;
+
+			*match = old->next;
+			free(old);
+			mirror_stats.routes--;
+			node_prune(np, pp);
+		}
+		return 0;
+	}
+
+	node = node_get(&mirror_root[idx], dst, r->rtm_dst_len);
+	if (!node) {
+		free(rt);
+		return -1;
+	}
+
+	for (rp = &node->routes; *rp; rp = &(*rp)->next) {
+		if (rt_payload_eq((*rp)->n, n)) {
+			free(rt);
+			return 0;
+		}
+		if (rt_key_eq(*rp, rt) &&
+		    (r->rtm_family == AF_INET6 ||
+		     n->nlmsg_flags & NLM_F_REPLACE)) {
+			rt->next = (*rp)->next;
+			free(*rp);
+			*rp = rt;
+			return 0;
+		}
+	}
+	*rp = rt;
+	mirror_stats.routes++;
+	return 0;
+}
+
+static int mirror_dump_msg(struct nlmsghdr *n, void *arg)
+{
+	return mirror_update(n);
+}
+
+static int mirror_listen_msg(struct rtnl_ctrl_data *ctrl,
+			     struct nlmsghdr *n, void *arg)
+{
+	return mirror_update(n);
+}
+
+/* Forget everything and dump the tables again */
+static int mirror_resync(void)
+{
+	static const int families[] = { AF_INET, AF_INET6 };
+	int i;
+
+	mirror_flush();
+
+	for (i = 0; i < ARRAY_SIZE(families); i++) {
+		if (preferred_family != AF_UNSPEC &&
+		    preferred_family != families[i])
+			continue;
+
+		if (rtnl_routedump_req(&rth, families[i], NULL) < 0) {
+			perror("Cannot send dump request");
+			return -1;
+		}
+		if (rtnl_dump_filter(&rth, mirror_dump_msg, NULL) < 0) {
+			fprintf(stderr, "Dump terminated\n");
+			return -1;
+		}
+	}
+
+	mirror_stats.resyncs++;
+	return 0;
+}
+
+/* Drain the notification socket, resync if the kernel dropped some */
+static int mirror_events(__u64 wake)
+{
+	struct nlmsghdr *h;
+	char buf[32768];
+	int status;
+
+	for (;;) {
+		status = recv(mirror_ev.fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (status < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return 0;
+			if (errno == ENOBUFS) {
+				mirror_stats.overruns++;
+				return mirror_resync();
+			}
+			perror("netlink receive error");
+			return -1;
+		}
+		if (status == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -1;
+		}
+
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, status);
+		     h = NLMSG_NEXT(h, status)) {
+			__u64 apply;
+
+			if (mirror_update(h) < 0) {
+				fprintf(stderr, "Cannot mirror route\n");
+				return -1;
+			}
+
+			/* since poll() woke up, including the events
+			 * applied before this one; netlink has no
+			 * receive timestamps to tell the time queued.
+			 */
+			apply = (mirror_now_ns() - wake) / 1000;
+			mirror_stats.events++;
+			mirror_stats.apply_us += apply;
+			if (apply > mirror_stats.apply_us_max)
+				mirror_stats.apply_us_max = apply;
+		}
+	}
+}
+
+static const struct mirror_route *mirror_match(const struct mirror_node *node,
+					       __u32 table)
+{
+	const struct mirror_route *rt, *best = NULL;
+
+	for (rt = node->routes; rt; rt = rt->next) {
+		if (rt->table != table || rt->tos || rt->src_len)
+			continue;
+		if (!best || rt->priority < best->priority)
+			best = rt;
+	}
+	return best;
+}
+
+static const struct mirror_route *mirror_lookup_table(int idx, const __u8 *addr,
+						      int bits, __u32 table)
+{
+	const struct mirror_node *node = mirror_root[idx];
+	const struct mirror_route *rt, *best = NULL;
+
+	while (node && node->len <= bits &&
+	       key_diff(node->key, addr, node->len) == node->len) {
+		rt = mirror_match(node, table);
+		if (rt)
+			best = rt;
+		if (node->len == bits)
+			break;
+		node = node->child[key_bit(addr, node->len)];
+	}
+	return best;
+}
+
+/* Without a table, follow the default rules: local, main, default */
+static const struct mirror_route *mirror_lookup(const inet_prefix *addr,
+						__u32 table)
+{
+	static const __u32 tables[] = {
+		RT_TABLE_LOCAL, RT_TABLE_MAIN, RT_TABLE_DEFAULT
+	};
+	const struct mirror_route *rt = NULL;
+	int idx = mirror_family_idx(addr->family);
+	int i;
+
+	if (idx < 0)
+		return NULL;
+
+	if (table)
+		return mirror_lookup_table(idx, (__u8 *)addr->data,
+					   addr->bytelen * 8, table);
+
+	for (i = 0; i < ARRAY_SIZE(tables) && !rt; i++)
+		rt = mirror_lookup_table(idx, (__u8 *)addr->data,
+					 addr->bytelen * 8, tables[i]);
+	return rt;
+}
+
+static void mirror_get(char *args)
+{
+	const struct mirror_route *rt;
+	char *tok, *save = NULL;
+	inet_prefix addr;
+	__u32 table = 0;
+	__u64 start, ns;
+
+	tok = strtok_r(args, " \t", &save);
+	if (!tok || get_addr_1(&addr, tok, preferred_family) ||
+	    mirror_family_idx(addr.family) < 0) {
+		printf("error: invalid address\n");
+		return;
+	}
+
+	while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
+		if (strcmp(tok, "table") == 0) {
+			tok = strtok_r(NULL, " \t", &save);
+			if (!tok || rtnl_rttable_a2n(&table, tok)) {
+				printf("error: invalid table\n");
+				return;
+			}
+		} else {
+			printf("error: unknown argument \"%s\"\n", tok);
+			return;
+		}
+	}
+
+	start = mirror_now_ns();
+	rt = mirror_lookup(&addr, table);
+	ns = mirror_now_ns() - start;
+
+	mirror_stats.lookups++;
+	mirror_stats.lookup_ns += ns;
+	if (ns > mirror_stats.lookup_ns_max)
+		mirror_stats.lookup_ns_max = ns;
+
+	if (!rt) {
+		printf("error: %s\n", strerror(ENETUNREACH));
+		return;
+	}
+	print_route(rt->n, stdout);
+}
+
+static void mirror_print_stats(void)
+{
+	printf("routes %llu lookups %llu lookup_ns_avg %llu lookup_ns_max %llu "
+	       "events %llu apply_us_avg %llu apply_us_max %llu "
+	       "resyncs %llu overruns %llu\n",
+	       mirror_stats.routes, mirror_stats.lookups,
+	       mirror_stats.lookups ?
+	       mirror_stats.lookup_ns / mirror_stats.lookups : 0,
+	       mirror_stats.lookup_ns_max, mirror_stats.events,
+	       mirror_stats.events ?
+	       mirror_stats.apply_us / mirror_stats.events : 0,
+	       mirror_stats.apply_us_max, mirror_stats.resyncs,
+	       mirror_stats.overruns);
+}
+
+static void mirror_request(char *line)
+{
+	char *cmd = line + strspn(line, " \t");
+	size_t len = strcspn(cmd, " \t");
+
+	if (len == 0)
+		return;
+
+	if (len == 3 && strncmp(cmd, "get", 3) == 0)
+		mirror_get(cmd + len);
+	else if (len == 5 && strncmp(cmd, "stats", 5) == 0)
+		mirror_print_stats();
+	else
+		printf("error: unknown request\n");
+}
+
+static void mirror_client_close(int i)
+{
+	close(mirror_clients[i].fd);
+	mirror_clients[i] = mirror_clients[--mirror_nclients];
+}
+
+/*
+ * Answer the complete lines a client sent. print_route() writes to
+ * stdout, so point stdout at the client while answering.
+ */
+static int mirror_client_read(struct mirror_client *c)
+{
+	char *line, *nl;
+	int n;
+
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1);
+	if (n <= 0)
+		return -1;
+	c->len += n;
+	c->buf[c->len] = 0;
+
+	fflush(stdout);
+	if (dup2(c->fd, STDOUT_FILENO) < 0)
+		return -1;
+
+	line = c->buf;
+	while ((nl = strchr(line, '\n')) != NULL) {
+		*nl = 0;
+		if (nl > line && nl[-1] == '\r')
+			nl[-1] = 0;
+		mirror_request(line);
+		line = nl + 1;
+	}
+
+	fflush(stdout);
+	n = ferror(stdout) ? -1 : 0;
+	clearerr(stdout);
+	dup2(mirror_stdout, STDOUT_FILENO);
+
+	c->len -= line - c->buf;
+	memmove(c->buf, line, c->len);
+
+	/* a line that does not fit will never be answered */
+	if (c->len == sizeof(c->buf) - 1)
+		return -1;
+	return n;
+}
+
+static int mirror_accept(int fd)
+{
+	struct timeval tv = { .tv_usec = 100000 };
+	int c;
+
+	c = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+	if (c < 0)
+		return -1;
+
+	if (mirror_nclients == MIRROR_MAX_CLIENTS) {
+		close(c);
+		return -1;
+	}
+
+	/* a client that does not read its answers must not stall us */
+	setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	mirror_clients[mirror_nclients].fd = c;
+	mirror_clients[mirror_nclients].len = 0;
+	mirror_nclients++;
+	return 0;
+}
+
+static int mirror_listen(const char *path)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	socklen_t len;
+	int fd;
+
+	/* a name without a slash is taken in the abstract namespace */
+	if (strchr(path, '/')) {
+		if (strlen(path) >= sizeof(sun.sun_path)) {
+			fprintf(stderr, "Socket path \"%s\" is too long\n", path);
+			return -1;
+		}
+		strcpy(sun.sun_path, path);
+		len = sizeof(sun);
+		unlink(path);
+	} else {
+		if (strlen(path) >= sizeof(sun.sun_path) - 1) {
+			fprintf(stderr, "Socket name \"%s\" is too long\n", path);
+			return -1;
+		}
+		strcpy(sun.sun_path + 1, path);
+		len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(path);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&sun, len) < 0 || listen(fd, 16) < 0) {
+		perror("Cannot bind mirror socket");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int mirror_loop(int lfd)
+{
+	struct pollfd p[2 + MIRROR_MAX_CLIENTS];
+	int i, nfds;
+
+	for (;;) {
+		__u64 wake;
+
+		nfds = 0;
+		p[nfds].fd = mirror_ev.fd;
+		p[nfds++].events = POLLIN;
+		p[nfds].fd = lfd;
+		p[nfds++].events = POLLIN;
+		for (i = 0; i < mirror_nclients; i++) {
+			p[nfds].fd = mirror_clients[i].fd;
+			p[nfds++].events = POLLIN;
+		}
+
+		/* without live updates p[0] is -1 and ignored */
+		if (poll(p, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			return -1;
+		}
+		wake = mirror_now_ns();
+
+		/* keep the copy current before answering anything */
+		if (p[0].revents && mirror_events(wake) < 0)
+			return -1;
+
+		/* from the end, closing a client moves the last one down */
+		for (i = mirror_nclients - 1; i >= 0; i--)
+			if (p[2 + i].revents &&
+			    mirror_client_read(&mirror_clients[i]) < 0)
+				mirror_client_close(i);
+
+		if (p[1].revents & POLLIN)
+			mirror_accept(lfd);
+	}
+}
+
+int do_iproute_mirror(int argc, char **argv)
+{
+	const char *path = MIRROR_SOCKET;
+	const char *file = NULL;
+	unsigned int groups = 0;
+	int lfd, ret;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "socket") == 0) {
+			NEXT_ARG();
+			path = *argv;
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+		} else if (matches(*argv, "help") == 0) {
+			usage();
+		} else {
+			invarg("unknown argument", *argv);
+		}
+		argc--; argv++;
+	}
+
+	if (preferred_family == AF_UNSPEC || preferred_family == AF_INET)
+		groups |= nl_mgrp(RTNLGRP_IPV4_ROUTE);
+	if (preferred_family == AF_UNSPEC || preferred_family == AF_INET6)
+		groups |= nl_mgrp(RTNLGRP_IPV6_ROUTE);
+	if (!groups) {
+		fprintf(stderr, "Only inet and inet6 routes can be mirrored\n");
+		return -1;
+	}
+
+	iproute_reset_filter(0);
+	_SL_ = "\\";
+	signal(SIGPIPE, SIG_IGN);
+
+	mirror_stdout = dup(STDOUT_FILENO);
+	if (mirror_stdout < 0) {
+		perror("dup");
+		return -1;
+	}
+
+	if (file) {
+		/* serve a capture of "ip monitor", without live updates */
+		FILE *fp = fopen(file, "r");
+
+		if (!fp) {
+			perror("Cannot fopen");
+			return -1;
+		}
+		ret = rtnl_from_file(fp, mirror_listen_msg, NULL);
+		fclose(fp);
+		if (ret < 0)
+			return -1;
+	} else {
+		/* subscribe first, so nothing is missed while dumping */
+		if (rtnl_open(&mirror_ev, groups) < 0)
+			return -1;
+		if (mirror_resync() < 0)
+			return -1;
+	}
+
+	lfd = mirror_listen(path);
+	if (lfd < 0)
+		return -1;
+
+	ret = mirror_loop(lfd);
+
+	close(lfd);
+	mirror_flush();
+	if (mirror_ev.fd >= 0)
+		rtnl_close(&mirror_ev);
+	return ret;
+}
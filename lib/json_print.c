@@ -12,6 +12,19 @@
 #include "json_print.h"
 
 static json_writer_t *_jw;
+static bool _jw_failed;
+
+/* A JSON document that could not be written out must not pass for one */
+static int json_obj_flush(void)
+{
+	if (fflush(stdout) == 0 && !ferror(stdout))
+		return 0;
+
+	if (!_jw_failed)
+		fprintf(stderr, "Error writing JSON output\n");
+	_jw_failed = true;
+	return -1;
+}
 
 static void __new_json_obj(int json, bool have_array)
 {
@@ -28,13 +41,15 @@ static void __new_json_obj(int json, bool have_array)
 	}
 }
 
-static void __delete_json_obj(bool have_array)
+static int __delete_json_obj(bool have_array)
 {
-	if (_jw) {
-		if (have_array)
-			jsonw_end_array(_jw);
-		jsonw_destroy(&_jw);
-	}
+	if (!_jw)
+		return 0;
+
+	if (have_array)
+		jsonw_end_array(_jw);
+	jsonw_destroy(&_jw);
+	return json_obj_flush();
 }
 
 void new_json_obj(int json)
@@ -42,9 +57,9 @@ void new_json_obj(int json)
 	__new_json_obj(json, true);
 }
 
-void delete_json_obj(void)
+int delete_json_obj(void)
 {
-	__delete_json_obj(true);
+	return __delete_json_obj(true);
 }
 
 void new_json_obj_plain(int json)
@@ -52,9 +67,25 @@ void new_json_obj_plain(int json)
 	__new_json_obj(json, false);
 }
 
-void delete_json_obj_plain(void)
+int delete_json_obj_plain(void)
+{
+	return __delete_json_obj(false);
+}
+
+/* Whether a JSON document failed to be written, for the exit status */
+bool json_obj_failed(void)
+{
+	return _jw_failed;
+}
+
+/* Drop the JSON writer inherited across fork(), whose open arrays and
+ * objects belong to the parent, so that the child can start a document
+ * of its own.
+ */
+void forget_json_obj(void)
 {
-	__delete_json_obj(false);
+	free(_jw);
+	_jw = NULL;
 }
 
 bool is_json_context(void)
@@ -5,12 +5,17 @@
  * This takes care of the annoying bits of JSON syntax like the commas
  * after elements
  *
+ * Output goes through the FILE's own buffer, with the unlocked stdio
+ * calls, so that it stays in order with anything printed to the FILE
+ * directly and write errors show in ferror().
+ *
  * Authors:	Stephen Hemminger <stephen@networkplumber.org>
  */
 
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 #include <malloc.h>
 #include <inttypes.h>
@@ -25,12 +30,27 @@ struct json_writer {
 	char		sep;	/* either nul or comma */
 };
 
+static void jsonw_putc(json_writer_t *self, char c)
+{
+	putc_unlocked(c, self->out);
+}
+
+static void jsonw_write(json_writer_t *self, const char *p, size_t n)
+{
+	fwrite_unlocked(p, 1, n, self->out);
+}
+
+static void jsonw_fputs(json_writer_t *self, const char *str)
+{
+	jsonw_write(self, str, strlen(str));
+}
+
 /* indentation for pretty print */
 static void jsonw_indent(json_writer_t *self)
 {
 	unsigned i;
 	for (i = 0; i < self->depth; ++i)
-		fputs("    ", self->out);
+		jsonw_write(self, "    ", 4);
 }
 
 /* end current line and indent if pretty printing */
@@ -39,7 +59,7 @@ static void jsonw_eol(json_writer_t *self)
 	if (!self->pretty)
 		return;
 
-	putc('\n', self->out);
+	jsonw_putc(self, '\n');
 	jsonw_indent(self);
 }
 
@@ -47,43 +67,86 @@ static void jsonw_eol(json_writer_t *self)
 static void jsonw_eor(json_writer_t *self)
 {
 	if (self->sep != '\0')
-		putc(self->sep, self->out);
+		jsonw_putc(self, self->sep);
 	self->sep = ',';
 }
 
+static const char *jsonw_escape(char c)
+{
+	switch (c) {
+	case '\t':
+		return "\\t";
+	case '\n':
+		return "\\n";
+	case '\r':
+		return "\\r";
+	case '\f':
+		return "\\f";
+	case '\b':
+		return "\\b";
+	case '\\':
+		return "\\\\";
+	case '"':
+		return "\\\"";
+	default:
+		return NULL;
+	}
+}
 
 /* Output JSON encoded string */
 /* Handles C escapes, does not do Unicode */
 static void jsonw_puts(json_writer_t *self, const char *str)
 {
-	putc('"', self->out);
-	for (; *str; ++str)
-		switch (*str) {
-		case '\t':
-			fputs("\\t", self->out);
-			break;
-		case '\n':
-			fputs("\\n", self->out);
-			break;
-		case '\r':
-			fputs("\\r", self->out);
-			break;
-		case '\f':
-			fputs("\\f", self->out);
-			break;
-		case '\b':
-			fputs("\\b", self->out);
-			break;
-		case '\\':
-			fputs("\\\\", self->out);
-			break;
-		case '"':
-			fputs("\\\"", self->out);
-			break;
-		default:
-			putc(*str, self->out);
-		}
-	putc('"', self->out);
+	const char *run = str;
+	const char *esc;
+
+	jsonw_putc(self, '"');
+	for (; *str; ++str) {
+		esc = jsonw_escape(*str);
+		if (!esc)
+			continue;
+		jsonw_write(self, run, str - run);
+		jsonw_write(self, esc, 2);
+		run = str + 1;
+	}
+	jsonw_write(self, run, str - run);
+	jsonw_putc(self, '"');
+}
+
+/* Integers are formatted right to left into the tail of @end */
+static char *jsonw_fmt_u64(char *end, uint64_t num)
+{
+	do {
+		*--end = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	return end;
+}
+
+static void jsonw_put_u64(json_writer_t *self, uint64_t num)
+{
+	char tmp[24];
+	char *p = jsonw_fmt_u64(tmp + sizeof(tmp), num);
+
+	jsonw_eor(self);
+	jsonw_write(self, p, tmp + sizeof(tmp) - p);
+}
+
+static void jsonw_put_s64(json_writer_t *self, int64_t num)
+{
+	char tmp[24];
+	char *p;
+
+	if (num < 0) {
+		p = jsonw_fmt_u64(tmp + sizeof(tmp), -(uint64_t)num);
+		*--p = '-';
+	} else {
+		p = jsonw_fmt_u64(tmp + sizeof(tmp), num);
+	}
+
+	jsonw_eor(self);
+	jsonw_write(self, p, tmp + sizeof(tmp) - p);
 }
 
 /* Create a new JSON stream */
@@ -105,7 +168,7 @@ void jsonw_destroy(json_writer_t **self_p)
 	json_writer_t *self = *self_p;
 
 	assert(self->depth == 0);
-	fputs("\n", self->out);
+	jsonw_putc(self, '\n');
 	fflush(self->out);
 	free(self);
 	*self_p = NULL;
@@ -120,7 +183,7 @@ void jsonw_pretty(json_writer_t *self, bool on)
 static void jsonw_begin(json_writer_t *self, int c)
 {
 	jsonw_eor(self);
-	putc(c, self->out);
+	jsonw_putc(self, c);
 	++self->depth;
 	self->sep = '\0';
 }
@@ -132,7 +195,7 @@ static void jsonw_end(json_writer_t *self, int c)
 	--self->depth;
 	if (self->sep != '\0')
 		jsonw_eol(self);
-	putc(c, self->out);
+	jsonw_putc(self, c);
 	self->sep = ',';
 }
 
@@ -144,9 +207,9 @@ void jsonw_name(json_writer_t *self, const char *name)
 	jsonw_eol(self);
 	self->sep = '\0';
 	jsonw_puts(self, name);
-	putc(':', self->out);
+	jsonw_putc(self, ':');
 	if (self->pretty)
-		putc(' ', self->out);
+		jsonw_putc(self, ' ');
 }
 
 __attribute__((format(printf, 2, 3)))
@@ -175,13 +238,13 @@ void jsonw_start_array(json_writer_t *self)
 {
 	jsonw_begin(self, '[');
 	if (self->pretty)
-		putc(' ', self->out);
+		jsonw_putc(self, ' ');
 }
 
 void jsonw_end_array(json_writer_t *self)
 {
 	if (self->pretty && self->sep)
-		putc(' ', self->out);
+		jsonw_putc(self, ' ');
 	self->sep = '\0';
 	jsonw_end(self, ']');
 }
@@ -195,12 +258,14 @@ void jsonw_string(json_writer_t *self, const char *value)
 
 void jsonw_bool(json_writer_t *self, bool val)
 {
-	jsonw_printf(self, "%s", val ? "true" : "false");
+	jsonw_eor(self);
+	jsonw_fputs(self, val ? "true" : "false");
 }
 
 void jsonw_null(json_writer_t *self)
 {
-	jsonw_printf(self, "null");
+	jsonw_eor(self);
+	jsonw_write(self, "null", 4);
 }
 
 void jsonw_float(json_writer_t *self, double num)
@@ -210,47 +275,56 @@ void jsonw_float(json_writer_t *self, double num)
 
 void jsonw_hhu(json_writer_t *self, unsigned char num)
 {
-	jsonw_printf(self, "%hhu", num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_hu(json_writer_t *self, unsigned short num)
 {
-	jsonw_printf(self, "%hu", num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_uint(json_writer_t *self, unsigned int num)
 {
-	jsonw_printf(self, "%u", num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_u64(json_writer_t *self, uint64_t num)
 {
-	jsonw_printf(self, "%"PRIu64, num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_xint(json_writer_t *self, uint64_t num)
 {
-	jsonw_printf(self, "%"PRIx64, num);
+	char tmp[24];
+	char *p = tmp + sizeof(tmp);
+
+	do {
+		*--p = "0123456789abcdef"[num & 0xf];
+		num >>= 4;
+	} while (num);
+
+	jsonw_eor(self);
+	jsonw_write(self, p, tmp + sizeof(tmp) - p);
 }
 
 void jsonw_luint(json_writer_t *self, unsigned long num)
 {
-	jsonw_printf(self, "%lu", num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_lluint(json_writer_t *self, unsigned long long num)
 {
-	jsonw_printf(self, "%llu", num);
+	jsonw_put_u64(self, num);
 }
 
 void jsonw_int(json_writer_t *self, int num)
 {
-	jsonw_printf(self, "%d", num);
+	jsonw_put_s64(self, num);
 }
 
 void jsonw_s64(json_writer_t *self, int64_t num)
 {
-	jsonw_printf(self, "%"PRId64, num);
+	jsonw_put_s64(self, num);
 }
 
 /* Basic name/value objects */
@@ -175,6 +175,12 @@ void rtnl_set_strict_dump(struct rtnl_handle *rth)
 	rth->flags |= RTNL_HANDLE_F_STRICT_CHK;
 }
 
+/* Pull several dump chunks per syscall */
+void rtnl_set_recvmmsg(struct rtnl_handle *rth)
+{
+	rth->flags |= RTNL_HANDLE_F_RECVMMSG;
+}
+
 int rtnl_add_nl_group(struct rtnl_handle *rth, unsigned int group)
 {
 	return setsockopt(rth->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
@@ -187,6 +193,11 @@ void rtnl_close(struct rtnl_handle *rth)
 		close(rth->fd);
 		rth->fd = -1;
 	}
+	free(rth->rbuf);
+	rth->rbuf = NULL;
+	rth->rbuf_len = 0;
+	rth->rbuf_want = 0;
+	rth->rbuf_busy = false;
 }
 
 int rtnl_open_byproto(struct rtnl_handle *rth, unsigned int subscriptions,
@@ -818,7 +829,72 @@ static int __rtnl_recvmsg(int fd, struct msghdr *msg, int flags)
 	return len;
 }
 
-static int rtnl_recvmsg(int fd, struct msghdr *msg, char **answer)
+#define RTNL_RECV_MIN		32768
+#define RTNL_RECV_BATCH		8
+
+/*
+ * Each handle owns one receive buffer, sized from SO_RCVBUF and grown
+ * when a datagram does not fit, so that nothing is allocated per
+ * datagram. A callback that talks on the same handle while a dump holds
+ * the buffer falls back to a private allocation.
+ */
+static char *rtnl_rbuf_get(struct rtnl_handle *rth, size_t min)
+{
+	size_t len = rth->rbuf_len;
+
+	if (rth->rbuf_busy)
+		return NULL;
+
+	if (!len) {
+		socklen_t optlen = sizeof(int);
+		int sz = 0;
+
+		getsockopt(rth->fd, SOL_SOCKET, SO_RCVBUF, &sz, &optlen);
+		len = sz > RTNL_RECV_MIN ? sz : RTNL_RECV_MIN;
+	}
+	if (len < rth->rbuf_want)
+		len = rth->rbuf_want;
+	if (len < min)
+		len = min;
+
+	if (len != rth->rbuf_len) {
+		char *buf = realloc(rth->rbuf, len);
+
+		if (!buf)
+			return NULL;
+		rth->rbuf = buf;
+		rth->rbuf_len = len;
+	}
+
+	rth->rbuf_busy = true;
+	return rth->rbuf;
+}
+
+static void rtnl_rbuf_put(struct rtnl_handle *rth, char *buf)
+{
+	if (buf && buf == rth->rbuf)
+		rth->rbuf_busy = false;
+	else
+		free(buf);
+}
+
+/* Hand a received datagram over to a caller that will free() it */
+static char *rtnl_rbuf_steal(struct rtnl_handle *rth, char *buf, int len)
+{
+	char *copy;
+
+	if (buf != rth->rbuf)
+		return buf;
+
+	copy = malloc(len > RTNL_RECV_MIN ? len : RTNL_RECV_MIN);
+	if (copy)
+		memcpy(copy, buf, len);
+	rtnl_rbuf_put(rth, buf);
+
+	return copy;
+}
+
+static int rtnl_recvmsg_peek(int fd, struct msghdr *msg, char **answer)
 {
 	struct iovec *iov = msg->msg_iov;
 	char *buf;
@@ -848,110 +924,246 @@ static int rtnl_recvmsg(int fd, struct msghdr *msg, char **answer)
 		return len;
 	}
 
-	if (answer)
-		*answer = buf;
-	else
-		free(buf);
+	*answer = buf;
 
 	return len;
 }
 
-static int rtnl_dump_filter_l(struct rtnl_handle *rth,
-			      const struct rtnl_dump_filter_arg *arg)
+/*
+ * Receive one datagram. *answer must be released with rtnl_rbuf_put().
+ * The buffer is at least SO_RCVBUF long, so a datagram only outgrows it
+ * when it was queued alone on an otherwise empty socket. Its tail is
+ * lost then and MSG_TRUNC is set; the buffer is grown for the next one.
+ */
+static int rtnl_recvmsg(struct rtnl_handle *rth, struct msghdr *msg,
+			char **answer)
 {
-	struct sockaddr_nl nladdr;
-	struct iovec iov;
-	struct msghdr msg = {
-		.msg_name = &nladdr,
-		.msg_namelen = sizeof(nladdr),
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
+	struct iovec *iov = msg->msg_iov;
 	char *buf;
-	int dump_intr = 0;
+	int len;
 
-	while (1) {
-		int status;
-		const struct rtnl_dump_filter_arg *a;
-		int found_done = 0;
-		int msglen = 0;
+	buf = rtnl_rbuf_get(rth, 0);
+	if (!buf)
+		return rtnl_recvmsg_peek(rth->fd, msg, answer);
 
-		status = rtnl_recvmsg(rth->fd, &msg, &buf);
-		if (status < 0)
-			return status;
+	iov->iov_base = buf;
+	iov->iov_len = rth->rbuf_len;
 
-		if (rth->dump_fp)
-			fwrite(buf, 1, NLMSG_ALIGN(status), rth->dump_fp);
+	len = __rtnl_recvmsg(rth->fd, msg, MSG_TRUNC);
+	if (len < 0) {
+		rtnl_rbuf_put(rth, buf);
+		return len;
+	}
 
-		for (a = arg; a->filter; a++) {
-			struct nlmsghdr *h = (struct nlmsghdr *)buf;
+	if (len > rth->rbuf_len) {
+		rth->rbuf_want = len;
+		len = rth->rbuf_len;
+	}
 
-			msglen = status;
+	*answer = buf;
 
-			while (NLMSG_OK(h, msglen)) {
-				int err = 0;
+	return len;
+}
 
-				h->nlmsg_flags &= ~a->nc_flags;
+/*
+ * Receive up to RTNL_RECV_BATCH datagrams with one recvmmsg(), each in
+ * its own slice of the handle buffer. Falls back to rtnl_recvmsg() when
+ * batching is off or the buffer is in use.
+ *
+ * The kernel builds dump datagrams of at most 32K, unless the family
+ * needs more for a single message, and each slice is at least that large.
+ * A datagram that still does not fit is flagged MSG_TRUNC like in
+ * rtnl_recvmsg(), and the buffer grown for the next batch.
+ */
+static int rtnl_recv_batch(struct rtnl_handle *rth, struct mmsghdr *mmsg,
+			   struct iovec *iov, struct sockaddr_nl *nladdr,
+			   char **bufp)
+{
+	char *buf = NULL;
+	size_t slice;
+	int i, n;
+
+	memset(mmsg, 0, RTNL_RECV_BATCH * sizeof(*mmsg));
+	for (i = 0; i < RTNL_RECV_BATCH; i++) {
+		mmsg[i].msg_hdr.msg_name = &nladdr[i];
+		mmsg[i].msg_hdr.msg_namelen = sizeof(nladdr[i]);
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
 
-				if (nladdr.nl_pid != 0 ||
-				    h->nlmsg_pid != rth->local.nl_pid ||
-				    h->nlmsg_seq != rth->dump)
-					goto skip_it;
+	if (rth->flags & RTNL_HANDLE_F_RECVMMSG)
+		buf = rtnl_rbuf_get(rth, RTNL_RECV_BATCH * RTNL_RECV_MIN);
 
-				if (h->nlmsg_flags & NLM_F_DUMP_INTR)
-					dump_intr = 1;
+	if (!buf) {
+		n = rtnl_recvmsg(rth, &mmsg[0].msg_hdr, bufp);
+		if (n < 0)
+			return n;
+		mmsg[0].msg_len = n;
+		return 1;
+	}
 
-				if (h->nlmsg_type == NLMSG_DONE) {
-					err = rtnl_dump_done(h, a);
-					if (err < 0) {
-						free(buf);
-						return -1;
-					}
+	slice = rth->rbuf_len / RTNL_RECV_BATCH;
+	for (i = 0; i < RTNL_RECV_BATCH; i++) {
+		iov[i].iov_base = buf + i * slice;
+		iov[i].iov_len = slice;
+	}
 
-					found_done = 1;
-					break; /* process next filter */
-				}
+	do {
+		n = recvmmsg(rth->fd, mmsg, RTNL_RECV_BATCH,
+			     MSG_WAITFORONE | MSG_TRUNC, NULL);
+	} while (n < 0 && (errno == EINTR || errno == EAGAIN));
 
-				if (h->nlmsg_type == NLMSG_ERROR) {
-					err = rtnl_dump_error(rth, h, a);
-					if (err < 0) {
-						free(buf);
-						return -1;
-					}
+	if (n < 0) {
+		fprintf(stderr, "netlink receive error %s (%d)\n",
+			strerror(errno), errno);
+		rtnl_rbuf_put(rth, buf);
+		return -errno;
+	}
+	if (n == 0) {
+		fprintf(stderr, "EOF on netlink\n");
+		rtnl_rbuf_put(rth, buf);
+		return -ENODATA;
+	}
 
-					goto skip_it;
-				}
+	for (i = 0; i < n; i++) {
+		if (mmsg[i].msg_len > slice) {
+			mmsg[i].msg_hdr.msg_flags |= MSG_TRUNC;
+			rth->rbuf_want = mmsg[i].msg_len * RTNL_RECV_BATCH;
+			mmsg[i].msg_len = slice;
+		}
+	}
 
-				if (!rth->dump_fp) {
-					err = a->filter(h, a->arg1);
-					if (err < 0) {
-						free(buf);
-						return err;
-					}
-				}
+	*bufp = buf;
 
-skip_it:
-				h = NLMSG_NEXT(h, msglen);
+	return n;
+}
+
+/* Returns 1 once the dump is done, 0 to keep reading, < 0 on error */
+static int rtnl_dump_chunk(struct rtnl_handle *rth,
+			   const struct rtnl_dump_filter_arg *arg,
+			   struct msghdr *msg, char *buf, int status,
+			   int *dump_intr)
+{
+	const struct sockaddr_nl *nladdr = msg->msg_name;
+	const struct rtnl_dump_filter_arg *a;
+	int found_done = 0;
+	int msglen = 0;
+
+	if (rth->dump_fp)
+		fwrite(buf, 1, NLMSG_ALIGN(status), rth->dump_fp);
+
+	for (a = arg; a->filter; a++) {
+		struct nlmsghdr *h = (struct nlmsghdr *)buf;
+
+		msglen = status;
+
+		while (NLMSG_OK(h, msglen)) {
+			int err = 0;
+
+			h->nlmsg_flags &= ~a->nc_flags;
+
+			if (nladdr->nl_pid != 0 ||
+			    h->nlmsg_pid != rth->local.nl_pid ||
+			    h->nlmsg_seq != rth->dump)
+				goto skip_it;
+
+			if (h->nlmsg_flags & NLM_F_DUMP_INTR)
+				*dump_intr = 1;
+
+			if (h->nlmsg_type == NLMSG_DONE) {
+				err = rtnl_dump_done(h, a);
+				if (err < 0)
+					return -1;
+
+				found_done = 1;
+				break; /* process next filter */
 			}
-		}
-		free(buf);
 
-		if (found_done) {
-			if (dump_intr)
-				fprintf(stderr,
-					"Dump was interrupted and may be inconsistent.\n");
-			return 0;
-		}
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				err = rtnl_dump_error(rth, h, a);
+				if (err < 0)
+					return -1;
 
-		if (msg.msg_flags & MSG_TRUNC) {
-			fprintf(stderr, "Message truncated\n");
-			continue;
-		}
-		if (msglen) {
-			fprintf(stderr, "!!!Remnant of size %d\n", msglen);
-			exit(1);
+				goto skip_it;
+			}
+
+			if (!rth->dump_fp) {
+				err = a->filter(h, a->arg1);
+				if (err < 0)
+					return err;
+			}
+
+skip_it:
+			h = NLMSG_NEXT(h, msglen);
 		}
 	}
+
+	if (found_done) {
+		if (*dump_intr)
+			fprintf(stderr,
+				"Dump was interrupted and may be inconsistent.\n");
+		return 1;
+	}
+
+	if (msg->msg_flags & MSG_TRUNC) {
+		fprintf(stderr, "Message truncated\n");
+		return 0;
+	}
+	if (msglen) {
+		fprintf(stderr, "!!!Remnant of size %d\n", msglen);
+		exit(1);
+	}
+
+	return 0;
+}
+
+static int rtnl_dump_filter_l(struct rtnl_handle *rth,
+			      const struct rtnl_dump_filter_arg *arg)
+{
+	struct sockaddr_nl nladdr[RTNL_RECV_BATCH];
+	struct iovec iov[RTNL_RECV_BATCH];
+	struct mmsghdr mmsg[RTNL_RECV_BATCH];
+	int dump_intr = 0;
+
+	while (1) {
+		char *buf = NULL;
+		int i, n, ret = 0;
+
+		n = rtnl_recv_batch(rth, mmsg, iov, nladdr, &buf);
+		if (n < 0)
+			return n;
+
+		for (i = 0; i < n && !ret; i++)
+			ret = rtnl_dump_chunk(rth, arg, &mmsg[i].msg_hdr,
+					      iov[i].iov_base, mmsg[i].msg_len,
+					      &dump_intr);
+		rtnl_rbuf_put(rth, buf);
+
+		if (ret < 0)
+			return ret;
+		if (ret > 0)
+			return 0;
+	}
+}
+
+/* Process one datagram of a dump that was received by the caller, e.g.
+ * by another thread. Returns 1 once the dump is done, 0 if more data is
+ * expected and a negative value on error.
+ */
+int rtnl_dump_filter_buf(struct rtnl_handle *rth, char *buf, int len,
+			 rtnl_filter_t filter, void *arg1, int *dump_intr)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	struct msghdr msg = {
+		.msg_name = &nladdr,
+		.msg_namelen = sizeof(nladdr),
+	};
+	const struct rtnl_dump_filter_arg a[] = {
+		{ .filter = filter, .arg1 = arg1 },
+		{ },
+	};
+
+	return rtnl_dump_chunk(rth, a, &msg, buf, len, dump_intr);
 }
 
 int rtnl_dump_filter_nc(struct rtnl_handle *rth,
@@ -1001,7 +1213,8 @@ static void rtnl_talk_error(struct nlmsghdr *h, struct nlmsgerr *err,
 
 static int __rtnl_talk_iov(struct rtnl_handle *rtnl, struct iovec *iov,
 			   size_t iovlen, struct nlmsghdr **answer,
-			   bool show_rtnl_err, nl_ext_ack_fn_t errfn)
+			   bool show_rtnl_err, nl_ext_ack_fn_t errfn,
+			   rtnl_err_hndlr_t errhndlr, void *arg)
 {
 	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
 	struct iovec riov;
@@ -1014,6 +1227,8 @@ static int __rtnl_talk_iov(struct rtnl_handle *rtnl, struct iovec *iov,
 	unsigned int seq = 0;
 	struct nlmsghdr *h;
 	int i, status;
+	int failed = 0;
+	int buflen;
 	char *buf;
 
 	for (i = 0; i < iovlen; i++) {
@@ -1035,11 +1250,11 @@ static int __rtnl_talk_iov(struct rtnl_handle *rtnl, struct iovec *iov,
 	i = 0;
 	while (1) {
 next:
-		status = rtnl_recvmsg(rtnl->fd, &msg, &buf);
-		++i;
+		status = rtnl_recvmsg(rtnl, &msg, &buf);
 
 		if (status < 0)
 			return status;
+		buflen = status;
 
 		if (msg.msg_namelen != sizeof(nladdr)) {
 			fprintf(stderr,
@@ -1054,7 +1269,7 @@ next:
 			if (l < 0 || len > status) {
 				if (msg.msg_flags & MSG_TRUNC) {
 					fprintf(stderr, "Truncated message\n");
-					free(buf);
+					rtnl_rbuf_put(rtnl, buf);
 					return -1;
 				}
 				fprintf(stderr,
@@ -1078,41 +1293,54 @@ next:
 
 				if (l < sizeof(struct nlmsgerr)) {
 					fprintf(stderr, "ERROR truncated\n");
-					free(buf);
+					rtnl_rbuf_put(rtnl, buf);
 					return -1;
 				}
 
+				/* one ACK per request, in request order */
+				++i;
+
 				if (!error) {
 					/* check messages from kernel */
 					nl_dump_ext_ack(h, errfn);
 				} else {
 					errno = -error;
 
-					if (rtnl->proto != NETLINK_SOCK_DIAG &&
-					    show_rtnl_err)
+					if (!failed)
+						failed = i;
+
+					if (errhndlr &&
+					    (errhndlr(h, arg) &
+					     RTNL_SUPPRESS_NLMSG_ERROR_NLERR))
+						;
+					else if (rtnl->proto != NETLINK_SOCK_DIAG &&
+						 show_rtnl_err)
 						rtnl_talk_error(h, err, errfn);
 				}
 
 				if (i < iovlen) {
-					free(buf);
+					rtnl_rbuf_put(rtnl, buf);
 					goto next;
 				}
 
-				if (error) {
-					free(buf);
-					return -i;
+				if (failed) {
+					rtnl_rbuf_put(rtnl, buf);
+					return -failed;
 				}
 
-				if (answer)
+				if (answer) {
+					buf = rtnl_rbuf_steal(rtnl, buf, buflen);
 					*answer = (struct nlmsghdr *)buf;
-				else
-					free(buf);
+					return buf ? 0 : -ENOMEM;
+				}
+				rtnl_rbuf_put(rtnl, buf);
 				return 0;
 			}
 
 			if (answer) {
+				buf = rtnl_rbuf_steal(rtnl, buf, buflen);
 				*answer = (struct nlmsghdr *)buf;
-				return 0;
+				return buf ? 0 : -ENOMEM;
 			}
 
 			fprintf(stderr, "Unexpected reply!!!\n");
@@ -1120,7 +1348,7 @@ next:
 			status -= NLMSG_ALIGN(len);
 			h = (struct nlmsghdr *)((char *)h + NLMSG_ALIGN(len));
 		}
-		free(buf);
+		rtnl_rbuf_put(rtnl, buf);
 
 		if (msg.msg_flags & MSG_TRUNC) {
 			fprintf(stderr, "Message truncated\n");
@@ -1143,7 +1371,22 @@ static int __rtnl_talk(struct rtnl_handle *rtnl, struct nlmsghdr *n,
 		.iov_len = n->nlmsg_len
 	};
 
-	return __rtnl_talk_iov(rtnl, &iov, 1, answer, show_rtnl_err, errfn);
+	return __rtnl_talk_iov(rtnl, &iov, 1, answer, show_rtnl_err, errfn,
+			       NULL, NULL);
+}
+
+/*
+ * Send several requests with a single sendmsg() and wait for the ACK of
+ * each of them. @errhndlr is called for every rejected request and may
+ * return RTNL_SUPPRESS_NLMSG_ERROR_NLERR to silence the default report.
+ * Returns 0 when all requests succeeded, otherwise minus the (1-based)
+ * position in @iov of the first rejected one, or -1 on transport errors.
+ */
+int rtnl_talk_iov(struct rtnl_handle *rtnl, struct iovec *iov, size_t iovlen,
+		  rtnl_err_hndlr_t errhndlr, void *arg)
+{
+	return __rtnl_talk_iov(rtnl, iov, iovlen, NULL, true, NULL,
+			       errhndlr, arg);
 }
 
 int rtnl_echo_talk(struct rtnl_handle *rtnl, struct nlmsghdr *n, int json,
@@ -1193,9 +1436,9 @@ int rtnl_listen_all_nsid(struct rtnl_handle *rth)
 	return 0;
 }
 
-int rtnl_listen(struct rtnl_handle *rtnl,
-		rtnl_listen_filter_t handler,
-		void *jarg)
+static int __rtnl_listen(struct rtnl_handle *rtnl,
+			 rtnl_listen_filter_t handler,
+			 void *jarg, char *buf, size_t buflen)
 {
 	int status;
 	struct nlmsghdr *h;
@@ -1207,7 +1450,6 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 		.msg_iov = &iov,
 		.msg_iovlen = 1,
 	};
-	char   buf[16384];
 	char   cmsgbuf[BUFSIZ];
 
 	iov.iov_base = buf;
@@ -1220,7 +1462,7 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 			msg.msg_controllen = sizeof(cmsgbuf);
 		}
 
-		iov.iov_len = sizeof(buf);
+		iov.iov_len = buflen;
 		status = recvmsg(rtnl->fd, &msg, 0);
 
 		if (status < 0) {
@@ -1291,6 +1533,23 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 	}
 }
 
+int rtnl_listen(struct rtnl_handle *rtnl,
+		rtnl_listen_filter_t handler,
+		void *jarg)
+{
+	char *buf = rtnl_rbuf_get(rtnl, 0);
+	char sbuf[16384];
+	int ret;
+
+	if (!buf)
+		return __rtnl_listen(rtnl, handler, jarg, sbuf, sizeof(sbuf));
+
+	ret = __rtnl_listen(rtnl, handler, jarg, buf, rtnl->rbuf_len);
+	rtnl_rbuf_put(rtnl, buf);
+
+	return ret;
+}
+
 int rtnl_from_file(FILE *rtnl, rtnl_listen_filter_t handler,
 		   void *jarg)
 {
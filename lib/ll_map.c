@@ -32,6 +32,7 @@ struct ll_cache {
 #define IDXMAP_SIZE	1024
 static struct hlist_head idx_head[IDXMAP_SIZE];
 static struct hlist_head name_head[IDXMAP_SIZE];
+static int ll_map_initialized;
 
 static struct ll_cache *ll_get_by_index(unsigned index)
 {
@@ -386,9 +387,7 @@ void ll_drop_by_index(unsigned index)
 
 void ll_init_map(struct rtnl_handle *rth)
 {
-	static int initialized;
-
-	if (initialized)
+	if (ll_map_initialized)
 		return;
 
 	if (rtnl_linkdump_req(rth, AF_UNSPEC) < 0) {
@@ -401,5 +400,22 @@ void ll_init_map(struct rtnl_handle *rth)
 		exit(1);
 	}
 
-	initialized = 1;
+	ll_map_initialized = 1;
+}
+
+/* Forget all cached links, e.g. after switching to another namespace */
+void ll_flush_map(void)
+{
+	struct hlist_node *n, *tmp;
+	int i;
+
+	for (i = 0; i < IDXMAP_SIZE; i++) {
+		hlist_for_each_safe(n, tmp, &idx_head[i]) {
+			struct ll_cache *im
+				= container_of(n, struct ll_cache, idx_hash);
+
+			ll_entries_destroy(im);
+		}
+	}
+	ll_map_initialized = 0;
 }
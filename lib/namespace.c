@@ -4,6 +4,7 @@
  */
 
 #include <sys/statvfs.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <limits.h>
@@ -12,6 +13,7 @@
 #include "utils.h"
 #include "namespace.h"
 #include "libnetlink.h"
+#include "json_print.h"
 
 static void bind_etc(const char *name)
 {
@@ -142,6 +144,194 @@ int netns_foreach(int (*func)(char *nsname, void *arg), void *arg)
 	return 0;
 }
 
+struct netns_enter_ctx {
+	int (*func)(char *nsname, void *arg);
+	void *arg;
+	int orig;
+	int err;
+};
+
+static int netns_enter_one(char *nsname, void *arg)
+{
+	struct netns_enter_ctx *ctx = arg;
+	int netns, ret;
+
+	netns = netns_get_fd(nsname);
+	if (netns < 0) {
+		fprintf(stderr, "Cannot open network namespace \"%s\": %s\n",
+			nsname, strerror(errno));
+		return 0;
+	}
+	if (setns(netns, CLONE_NEWNET) < 0) {
+		fprintf(stderr, "setting the network namespace \"%s\" failed: %s\n",
+			nsname, strerror(errno));
+		close(netns);
+		return 0;
+	}
+	close(netns);
+
+	ret = ctx->func(nsname, ctx->arg);
+
+	if (setns(ctx->orig, CLONE_NEWNET) < 0) {
+		perror("setns");
+		ctx->err = -1;
+		return -1;
+	}
+	return ret;
+}
+
+/* Like netns_foreach(), but call func from within each network namespace.
+ * Only the network namespace is switched, so that a single process can
+ * collect state from all of them; /sys and /etc are those of the caller.
+ */
+int netns_foreach_enter(int (*func)(char *nsname, void *arg), void *arg)
+{
+	struct netns_enter_ctx ctx = {
+		.func = func,
+		.arg = arg,
+	};
+	int ret;
+
+	ctx.orig = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+	if (ctx.orig < 0) {
+		perror("Cannot open current network namespace");
+		return -1;
+	}
+
+	ret = netns_foreach(netns_enter_one, &ctx);
+	close(ctx.orig);
+	return ret ? : ctx.err;
+}
+
+/* Read all of fd into a NUL terminated buffer, without trailing newlines */
+static char *netns_run_read(int fd)
+{
+	size_t len = 0, size = 4096;
+	char *buf = malloc(size);
+
+	while (buf) {
+		ssize_t n;
+
+		if (size - len < 2) {
+			char *tmp = realloc(buf, size * 2);
+
+			if (!tmp) {
+				free(buf);
+				return NULL;
+			}
+			buf = tmp;
+			size *= 2;
+		}
+
+		n = read(fd, buf + len, size - len - 1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+	}
+	if (buf) {
+		while (len && buf[len - 1] == '\n')
+			len--;
+		buf[len] = '\0';
+	}
+	return buf;
+}
+
+static int netns_run_one(char *nsname, void *arg)
+{
+	struct netns_enter_ctx *ctx = arg;
+	int fds[2] = { -1, -1 };
+	char *out = NULL;
+	int status;
+	pid_t pid;
+
+	if (is_json_context()) {
+		open_json_object(NULL);
+		print_string(PRINT_JSON, "name", NULL, nsname);
+		if (pipe2(fds, O_CLOEXEC) < 0) {
+			perror("pipe");
+			return -1;
+		}
+	} else {
+		printf("\nnetns: %s\n", nsname);
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+
+	if (pid == 0) {
+		/* The parent's unfinished document stays with the parent,
+		 * and so do its write errors.
+		 */
+		forget_json_obj();
+		clearerr(stdout);
+		if (fds[1] >= 0) {
+			close(fds[0]);
+			if (dup2(fds[1], STDOUT_FILENO) < 0)
+				_exit(1);
+		}
+		exit(ctx->func(nsname, ctx->arg) || json_obj_failed() ? 1 : 0);
+	}
+
+	if (fds[1] >= 0) {
+		close(fds[1]);
+		out = netns_run_read(fds[0]);
+		close(fds[0]);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		status = 1;
+	} else if (WIFEXITED(status)) {
+		status = WEXITSTATUS(status);
+	} else {
+		status = 128 + WTERMSIG(status);
+	}
+	if (status)
+		ctx->err = status;
+
+	if (is_json_context()) {
+		json_writer_t *jw = get_json_writer();
+
+		print_int(PRINT_JSON, "status", NULL, status);
+		/* output of a failed command may be cut short */
+		if (!status && out && *out) {
+			jsonw_name(jw, "output");
+			jsonw_printf(jw, "%s", out);
+		} else {
+			print_null(PRINT_JSON, "output", NULL, NULL);
+		}
+		close_json_object();
+	}
+	free(out);
+	return 0;
+}
+
+/* Run func in a child process in each named network namespace, so that a
+ * command failing or calling exit() in one of them does not end the walk.
+ * Text output follows a "netns: NAME" line. In JSON context, each one adds
+ * an object holding "name", the exit "status" and the command's "output",
+ * which is null unless it succeeded.
+ *
+ * Returns the last non zero exit status, if any.
+ */
+int netns_foreach_run(int (*func)(char *nsname, void *arg), void *arg)
+{
+	struct netns_enter_ctx ctx = {
+		.func = func,
+		.arg = arg,
+	};
+	int ret;
+
+	ret = netns_foreach_enter(netns_run_one, &ctx);
+	return ret ? : ctx.err;
+}
+
 int netns_id_from_name(struct rtnl_handle *rtnl, const char *name)
 {
 	struct {
@@ -0,0 +1,319 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * stats_shm.c	Shared memory snapshots of the ifstat/nstat daemons
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "stats_shm.h"
+#include "utils.h"
+
+static socklen_t stats_shm_addr(struct sockaddr_un *sun, const char *tool,
+				unsigned int uid)
+{
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1, "%s%u.shm",
+		 tool, uid);
+	return offsetof(struct sockaddr_un, sun_path) + 1 +
+	       strlen(sun->sun_path + 1);
+}
+
+static int stats_shm_map(struct stats_shm *shm, int fd, int prot, size_t size)
+{
+	void *map;
+
+	map = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+
+	if (shm->hdr)
+		munmap(shm->hdr, shm->size);
+	shm->hdr = map;
+	shm->size = size;
+	return 0;
+}
+
+int stats_shm_create(struct stats_shm *shm)
+{
+	size_t size = getpagesize();
+	char path[64];
+
+	memset(shm, 0, sizeof(*shm));
+	shm->ro_fd = -1;
+
+	shm->fd = memfd_create("stats_shm", MFD_CLOEXEC);
+	if (shm->fd < 0)
+		return -1;
+
+	/* clients get a descriptor that can neither write nor truncate */
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", shm->fd);
+	shm->ro_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (shm->ro_fd < 0)
+		goto err;
+
+	if (ftruncate(shm->fd, size) < 0 ||
+	    stats_shm_map(shm, shm->fd, PROT_READ | PROT_WRITE, size) < 0)
+		goto err;
+
+	shm->hdr->magic = STATS_SHM_MAGIC;
+	return 0;
+err:
+	stats_shm_close(shm);
+	return -1;
+}
+
+int stats_shm_listen(const char *tool)
+{
+	struct sockaddr_un sun;
+	socklen_t len;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	len = stats_shm_addr(&sun, tool, getuid());
+	if (bind(fd, (struct sockaddr *)&sun, len) < 0 || listen(fd, 5) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Hand the snapshot to one client, no reply is expected */
+void stats_shm_serve(struct stats_shm *shm, int listen_fd)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))] = {};
+	char byte = 0;
+	struct iovec iov = {
+		.iov_base = &byte,
+		.iov_len = 1,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+	int clnt;
+
+	clnt = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (clnt < 0)
+		return;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &shm->ro_fd, sizeof(int));
+
+	sendmsg(clnt, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	close(clnt);
+}
+
+void *stats_shm_write_begin(struct stats_shm *shm, __u32 rec_size,
+			    __u32 nrec, const char *source)
+{
+	size_t need = sizeof(*shm->hdr) + (size_t)rec_size * nrec;
+	struct stats_shm_hdr *hdr;
+
+	if (need > shm->size) {
+		size_t size = shm->size;
+
+		while (size < need)
+			size *= 2;
+		/* never shrink, readers may still map the old size */
+		if (ftruncate(shm->fd, size) < 0 ||
+		    stats_shm_map(shm, shm->fd, PROT_READ | PROT_WRITE,
+				  size) < 0)
+			return NULL;
+	}
+
+	hdr = shm->hdr;
+	__atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	hdr->rec_size = rec_size;
+	hdr->nrec = nrec;
+	strlcpy(hdr->source, source, sizeof(hdr->source));
+
+	return hdr + 1;
+}
+
+void stats_shm_write_end(struct stats_shm *shm)
+{
+	struct stats_shm_hdr *hdr = shm->hdr;
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	hdr->stamp_ms = (__u64)now.tv_sec * 1000 + now.tv_usec / 1000;
+
+	__atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+static int stats_shm_connect(const char *tool, unsigned int uid)
+{
+	struct sockaddr_un sun;
+	struct ucred cred;
+	socklen_t len;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	len = stats_shm_addr(&sun, tool, uid);
+	if (connect(fd, (struct sockaddr *)&sun, len) < 0)
+		goto err;
+
+	/* same rule as for the text socket: only trust ourselves or root */
+	len = sizeof(cred);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) ||
+	    len < sizeof(cred) || (cred.uid != getuid() && cred.uid != 0))
+		goto err;
+
+	return fd;
+err:
+	close(fd);
+	return -1;
+}
+
+int stats_shm_open(struct stats_shm *shm, const char *tool)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	char byte;
+	struct iovec iov = {
+		.iov_base = &byte,
+		.iov_len = 1,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+	struct stat st;
+	int sock, fd = -1;
+
+	memset(shm, 0, sizeof(*shm));
+	shm->fd = shm->ro_fd = -1;
+
+	sock = stats_shm_connect(tool, getuid());
+	if (sock < 0 && getuid())
+		sock = stats_shm_connect(tool, 0);
+	if (sock < 0)
+		return -1;
+
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == 1 &&
+	    !(msg.msg_flags & MSG_CTRUNC)) {
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	close(sock);
+	if (fd < 0)
+		return -1;
+
+	shm->fd = fd;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*shm->hdr) ||
+	    stats_shm_map(shm, fd, PROT_READ, st.st_size) < 0 ||
+	    shm->hdr->magic != STATS_SHM_MAGIC) {
+		stats_shm_close(shm);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Copy a consistent snapshot out of the mapping. Returns a malloc()ed
+ * array of *nrec records, or NULL if the table has another layout.
+ */
+void *stats_shm_read(struct stats_shm *shm, __u32 rec_size, __u32 *nrec,
+		     char *source, size_t len)
+{
+	char src[STATS_SHM_SOURCE_LEN];
+	void *buf = NULL;
+	size_t bufsize = 0;
+	int tries;
+
+	/* a daemon killed in the middle of an update leaves seq odd */
+	for (tries = 0; tries < 100000; tries++) {
+		const struct stats_shm_hdr *hdr = shm->hdr;
+		__u32 seq, n;
+		size_t need;
+
+		seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		/* the record size is set once, by the first scan */
+		if (__atomic_load_n(&hdr->rec_size, __ATOMIC_RELAXED) != rec_size)
+			break;
+		n = __atomic_load_n(&hdr->nrec, __ATOMIC_RELAXED);
+
+		need = sizeof(*hdr) + (size_t)rec_size * n;
+		if (need > shm->size) {
+			struct stat st;
+
+			if (fstat(shm->fd, &st) < 0 || st.st_size < need ||
+			    stats_shm_map(shm, shm->fd, PROT_READ,
+					  st.st_size) < 0)
+				break;
+			continue;
+		}
+
+		if ((size_t)rec_size * n > bufsize) {
+			void *nbuf = realloc(buf, (size_t)rec_size * n);
+
+			if (!nbuf)
+				break;
+			buf = nbuf;
+			bufsize = (size_t)rec_size * n;
+		}
+		memcpy(buf, hdr + 1, (size_t)rec_size * n);
+		memcpy(src, hdr->source, sizeof(src));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (seq == __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED)) {
+			src[sizeof(src) - 1] = 0;
+			if (source)
+				strlcpy(source, src, len);
+			*nrec = n;
+			/* an empty table is still a valid snapshot */
+			return buf ? buf : malloc(1);
+		}
+	}
+
+	free(buf);
+	return NULL;
+}
+
+void stats_shm_close(struct stats_shm *shm)
+{
+	if (shm->hdr)
+		munmap(shm->hdr, shm->size);
+	if (shm->ro_fd >= 0)
+		close(shm->ro_fd);
+	if (shm->fd >= 0)
+		close(shm->fd);
+	shm->hdr = NULL;
+	shm->fd = shm->ro_fd = -1;
+}
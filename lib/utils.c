@@ -1037,11 +1037,36 @@ int __get_user_hz(void)
 	return sysconf(_SC_CLK_TCK);
 }
 
+/* inet_ntop() goes through sprintf() for every IPv4 address */
+static const char *inet4_ntop(const void *addr, char *buf, int buflen)
+{
+	const unsigned char *a = addr;
+	char *p = buf;
+	int i;
+
+	if (buflen < INET_ADDRSTRLEN)
+		return inet_ntop(AF_INET, addr, buf, buflen);
+
+	for (i = 0; i < 4; i++) {
+		unsigned int v = a[i];
+
+		if (v >= 100)
+			*p++ = '0' + v / 100;
+		if (v >= 10)
+			*p++ = '0' + v / 10 % 10;
+		*p++ = '0' + v % 10;
+		*p++ = i < 3 ? '.' : '\0';
+	}
+
+	return buf;
+}
+
 const char *rt_addr_n2a_r(int af, int len,
 			  const void *addr, char *buf, int buflen)
 {
 	switch (af) {
 	case AF_INET:
+		return inet4_ntop(addr, buf, buflen);
 	case AF_INET6:
 		return inet_ntop(af, addr, buf, buflen);
 	case AF_MPLS:
@@ -1058,8 +1083,7 @@ const char *rt_addr_n2a_r(int af, int len,
 
 		switch (sa->sa.sa_family) {
 		case AF_INET:
-			return inet_ntop(AF_INET, &sa->sin.sin_addr,
-					 buf, buflen);
+			return inet4_ntop(&sa->sin.sin_addr, buf, buflen);
 		case AF_INET6:
 			return inet_ntop(AF_INET6, &sa->sin6.sin6_addr,
 					 buf, buflen);
@@ -1776,13 +1800,18 @@ int do_batch(const char *name, bool force,
 	cmdlineno = 0;
 	while (getcmdline(&line, &len, stdin) != -1) {
 		char *largv[MAX_ARGS];
-		int largc;
+		int largc, err;
 
 		largc = makeargs(line, largv, MAX_ARGS);
 		if (!largc)
 			continue;	/* blank line */
 
-		if (cmd(largc, largv, data)) {
+		err = cmd(largc, largv, data);
+		if (err == BATCH_STOP) {
+			ret = EXIT_FAILURE;
+			break;
+		}
+		if (err) {
 			fprintf(stderr, "Command failed %s:%d\n",
 				name, cmdlineno);
 			ret = EXIT_FAILURE;
@@ -29,6 +29,7 @@
 
 #include "libnetlink.h"
 #include "json_writer.h"
+#include "stats_shm.h"
 #include "version.h"
 #include "utils.h"
 
@@ -56,8 +57,10 @@ int source_mismatch;
 
 struct ifstat_ent {
 	struct ifstat_ent	*next;
+	struct ifstat_ent	*hnext;
 	char			*name;
 	int			ifindex;
+	unsigned int		seen;
 	unsigned long long	val[MAXS];
 	double			rate[MAXS];
 	__u64			ival[MAXS];
@@ -98,6 +101,51 @@ static const char *stats[MAXS] = {
 struct ifstat_ent *kern_db;
 struct ifstat_ent *hist_db;
 
+/* ifindex lookup for the two lists above */
+#define IFSTAT_HASH_SIZE	4096
+
+static struct ifstat_ent *kern_hash[IFSTAT_HASH_SIZE];
+static struct ifstat_ent *hist_hash[IFSTAT_HASH_SIZE];
+
+static struct ifstat_ent **db_slot(struct ifstat_ent **hash, int ifindex)
+{
+	return &hash[(unsigned int)ifindex & (IFSTAT_HASH_SIZE - 1)];
+}
+
+static void db_hash_add(struct ifstat_ent **hash, struct ifstat_ent *n)
+{
+	struct ifstat_ent **slot = db_slot(hash, n->ifindex);
+
+	n->hnext = *slot;
+	*slot = n;
+}
+
+static void db_hash_del(struct ifstat_ent **hash, struct ifstat_ent *n)
+{
+	struct ifstat_ent **pp = db_slot(hash, n->ifindex);
+
+	while (*pp != n)
+		pp = &(*pp)->hnext;
+	*pp = n->hnext;
+}
+
+static void db_hash(struct ifstat_ent **hash, struct ifstat_ent *db)
+{
+	memset(hash, 0, IFSTAT_HASH_SIZE * sizeof(*hash));
+	for (; db; db = db->next)
+		db_hash_add(hash, db);
+}
+
+static struct ifstat_ent *db_lookup(struct ifstat_ent **hash, int ifindex)
+{
+	struct ifstat_ent *n;
+
+	for (n = *db_slot(hash, ifindex); n; n = n->hnext)
+		if (n->ifindex == ifindex)
+			return n;
+	return NULL;
+}
+
 static int match(const char *id)
 {
 	int i;
@@ -112,12 +160,17 @@ static int match(const char *id)
 	return 0;
 }
 
-static int get_nlmsg_extended(struct nlmsghdr *m, void *arg)
+/*
+ * Parse the counters of one link into @n. Returns 1 if the link has
+ * counters, 0 if not (n->ifindex is still set when the message names a
+ * link) and -1 on error.
+ */
+static int parse_nlmsg_extended(struct nlmsghdr *m, struct ifstat_ent *n,
+				const char **name)
 {
 	struct if_stats_msg *ifsm = NLMSG_DATA(m);
 	struct rtattr *tb[IFLA_STATS_MAX+1];
 	int len = m->nlmsg_len;
-	struct ifstat_ent *n;
 
 	if (m->nlmsg_type != RTM_NEWSTATS)
 		return 0;
@@ -128,43 +181,32 @@ static int get_nlmsg_extended(struct nlmsghdr *m, void *arg)
 		return -1;
 	}
 
+	n->ifindex = ifsm->ifindex;
+
 	parse_rtattr(tb, IFLA_STATS_MAX, IFLA_STATS_RTA(ifsm), len);
 	if (tb[filter_type] == NULL)
 		return 0;
 
-	n = malloc(sizeof(*n));
-	if (!n) {
-		errno = ENOMEM;
-		return -1;
-	}
-
-	n->ifindex = ifsm->ifindex;
-	n->name = strdup(ll_index_to_name(ifsm->ifindex));
-
 	if (sub_type == NO_SUB_TYPE) {
 		memcpy(&n->val, RTA_DATA(tb[filter_type]), sizeof(n->val));
 	} else {
 		struct rtattr *attr;
 
 		attr = parse_rtattr_one_nested(sub_type, tb[filter_type]);
-		if (attr == NULL) {
-			free(n);
+		if (attr == NULL)
 			return 0;
-		}
 		memcpy(&n->val, RTA_DATA(attr), sizeof(n->val));
 	}
-	memset(&n->rate, 0, sizeof(n->rate));
-	n->next = kern_db;
-	kern_db = n;
-	return 0;
+	*name = ll_index_to_name(ifsm->ifindex);
+	return 1;
 }
 
-static int get_nlmsg(struct nlmsghdr *m, void *arg)
+static int parse_nlmsg(struct nlmsghdr *m, struct ifstat_ent *n,
+		       const char **name)
 {
 	struct ifinfomsg *ifi = NLMSG_DATA(m);
 	struct rtattr *tb[IFLA_MAX+1];
 	int len = m->nlmsg_len;
-	struct ifstat_ent *n;
 	int i;
 
 	if (m->nlmsg_type != RTM_NEWLINK)
@@ -176,6 +218,8 @@ static int get_nlmsg(struct nlmsghdr *m, void *arg)
 		return -1;
 	}
 
+	n->ifindex = ifi->ifi_index;
+
 	if (!(ifi->ifi_flags&IFF_UP))
 		return 0;
 
@@ -183,22 +227,6 @@ static int get_nlmsg(struct nlmsghdr *m, void *arg)
 	if (tb[IFLA_IFNAME] == NULL)
 		return 0;
 
-	n = malloc(sizeof(*n));
-	if (!n) {
-		errno = ENOMEM;
-		return -1;
-	}
-
-	n->ifindex = ifi->ifi_index;
-	n->name = strdup(RTA_DATA(tb[IFLA_IFNAME]));
-	if (!n->name) {
-		free(n);
-		errno = ENOMEM;
-		return -1;
-	}
-
-	memset(&n->rate, 0, sizeof(n->rate));
-
 	if (tb[IFLA_STATS64]) {
 		memcpy(&n->ival, RTA_DATA(tb[IFLA_STATS64]), sizeof(n->ival));
 	} else if (tb[IFLA_STATS]) {
@@ -209,12 +237,53 @@ static int get_nlmsg(struct nlmsghdr *m, void *arg)
 			n->ival[i] = stats[i];
 	} else {
 		/* missing stats? */
-		free(n);
 		return 0;
 	}
 
 	for (i = 0; i < MAXS; i++)
 		n->val[i] = n->ival[i];
+	*name = RTA_DATA(tb[IFLA_IFNAME]);
+	return 1;
+}
+
+static struct ifstat_ent *new_ent(const struct ifstat_ent *sample,
+				  const char *name)
+{
+	struct ifstat_ent *n;
+
+	n = malloc(sizeof(*n));
+	if (!n)
+		return NULL;
+
+	*n = *sample;
+	n->name = strdup(name);
+	if (!n->name) {
+		free(n);
+		return NULL;
+	}
+	memset(&n->rate, 0, sizeof(n->rate));
+	return n;
+}
+
+static int get_nlmsg(struct nlmsghdr *m, void *arg)
+{
+	struct ifstat_ent sample = {};
+	struct ifstat_ent *n;
+	const char *name;
+	int ret;
+
+	if (is_extended)
+		ret = parse_nlmsg_extended(m, &sample, &name);
+	else
+		ret = parse_nlmsg(m, &sample, &name);
+	if (ret <= 0)
+		return ret;
+
+	n = new_ent(&sample, name);
+	if (!n) {
+		errno = ENOMEM;
+		return -1;
+	}
 	n->next = kern_db;
 	kern_db = n;
 	return 0;
@@ -238,7 +307,7 @@ static void load_info(void)
 			exit(1);
 		}
 
-		if (rtnl_dump_filter(&rth, get_nlmsg_extended, NULL) < 0) {
+		if (rtnl_dump_filter(&rth, get_nlmsg, NULL) < 0) {
 			perror("Dump terminated\n");
 			exit(1);
 		}
@@ -331,12 +400,60 @@ static void load_raw_table(FILE *fp)
 	}
 }
 
+/* Same as load_raw_table(), from the daemon's shared memory snapshot */
+static int load_shm_table(void)
+{
+	struct stats_shm_ifstat *recs;
+	struct ifstat_ent **tail = &kern_db;
+	char source[sizeof(info_source)];
+	struct stats_shm shm;
+	__u32 i, nrec;
+	int k;
+
+	if (stats_shm_open(&shm, "ifstat") < 0)
+		return -1;
+	recs = stats_shm_read(&shm, sizeof(*recs), &nrec,
+			      source, sizeof(source));
+	stats_shm_close(&shm);
+	if (!recs)
+		return -1;
+
+	if (info_source[0] && strcmp(info_source, source))
+		source_mismatch = 1;
+	strlcpy(info_source, source, sizeof(info_source));
+
+	for (i = 0; i < nrec; i++) {
+		struct ifstat_ent *n;
+
+		if ((n = malloc(sizeof(*n))) == NULL)
+			abort();
+
+		n->ifindex = recs[i].ifindex;
+		recs[i].name[sizeof(recs[i].name) - 1] = 0;
+		n->name = strdup(recs[i].name);
+		for (k = 0; k < MAXS; k++) {
+			n->val[k] = k < recs[i].nval ? recs[i].val[k] : 0;
+			n->ival[k] = (__u32)n->val[k];
+			/* the text table has whole rates, keep output the same */
+			n->rate[k] = k < recs[i].nval ?
+				     (unsigned int)recs[i].rate[k] : 0;
+		}
+		n->next = NULL;
+		*tail = n;
+		tail = &n->next;
+	}
+
+	free(recs);
+	return 0;
+}
+
 static void dump_raw_db(FILE *fp, int to_hist)
 {
 	json_writer_t *jw = json_output ? jsonw_new(fp) : NULL;
-	struct ifstat_ent *n, *h;
+	struct ifstat_ent *n;
 
-	h = hist_db;
+	if (to_hist)
+		db_hash(hist_hash, hist_db);
 	if (jw) {
 		jsonw_start_object(jw);
 		jsonw_pretty(jw, pretty);
@@ -355,13 +472,10 @@ static void dump_raw_db(FILE *fp, int to_hist)
 
 			if (!to_hist)
 				continue;
-			for (h1 = h; h1; h1 = h1->next) {
-				if (h1->ifindex == n->ifindex) {
-					vals = h1->val;
-					rates = h1->rate;
-					h = h1->next;
-					break;
-				}
+			h1 = db_lookup(hist_hash, n->ifindex);
+			if (h1) {
+				vals = h1->val;
+				rates = h1->rate;
 			}
 		}
 
@@ -573,10 +687,10 @@ static void dump_kern_db(FILE *fp)
 
 static void dump_incr_db(FILE *fp)
 {
-	struct ifstat_ent *n, *h;
+	struct ifstat_ent *n;
 	json_writer_t *jw = json_output ? jsonw_new(fp) : NULL;
 
-	h = hist_db;
+	db_hash(hist_hash, hist_db);
 	if (jw) {
 		jsonw_start_object(jw);
 		jsonw_pretty(jw, pretty);
@@ -592,13 +706,10 @@ static void dump_incr_db(FILE *fp)
 
 		memcpy(vals, n->val, sizeof(vals));
 
-		for (h1 = h; h1; h1 = h1->next) {
-			if (h1->ifindex == n->ifindex) {
-				for (i = 0; i < MAXS; i++)
-					vals[i] -= h1->val[i];
-				h = h1->next;
-				break;
-			}
+		h1 = db_lookup(hist_hash, n->ifindex);
+		if (h1) {
+			for (i = 0; i < MAXS; i++)
+				vals[i] -= h1->val[i];
 		}
 		if (!match(n->name))
 			continue;
@@ -618,97 +729,215 @@ static void dump_incr_db(FILE *fp)
 }
 
 static int children;
+static struct stats_shm shm;
+static int shm_fd = -1;
 
 static void sigchild(int signo)
 {
 }
 
-static void update_db(int interval)
+/* Publish kern_db for clients that map it instead of reading text */
+static void shm_export(void)
 {
-	struct ifstat_ent *n, *h;
+	struct stats_shm_ifstat *rec;
+	struct ifstat_ent *n;
+	__u32 nrec = 0;
+	int i;
 
-	n = kern_db;
-	kern_db = NULL;
+	BUILD_BUG_ON(MAXS > STATS_SHM_IFSTAT_MAX);
 
-	load_info();
+	if (shm_fd < 0)
+		return;
 
-	h = kern_db;
-	kern_db = n;
+	for (n = kern_db; n; n = n->next)
+		nrec++;
 
-	for (n = kern_db; n; n = n->next) {
-		struct ifstat_ent *h1;
+	rec = stats_shm_write_begin(&shm, sizeof(*rec), nrec, info_source);
+	if (!rec)
+		return;
+
+	for (n = kern_db; n; n = n->next, rec++) {
+		memset(rec, 0, sizeof(*rec));
+		rec->ifindex = n->ifindex;
+		rec->nval = MAXS;
+		strlcpy(rec->name, n->name, sizeof(rec->name));
+		for (i = 0; i < MAXS; i++) {
+			rec->val[i] = n->val[i];
+			rec->rate[i] = n->rate[i];
+		}
+	}
 
-		for (h1 = h; h1; h1 = h1->next) {
-			if (h1->ifindex == n->ifindex) {
-				int i;
+	stats_shm_write_end(&shm);
+}
 
-				for (i = 0; i < MAXS; i++) {
-					if (h1->ival[i] < n->ival[i]) {
-						memset(n->ival, 0, sizeof(n->ival));
-						break;
-					}
-				}
-				for (i = 0; i < MAXS; i++) {
-					double sample;
-					__u64 incr;
-
-					if (is_extended) {
-						incr = h1->val[i] - n->val[i];
-						n->val[i] = h1->val[i];
-					} else {
-						incr = (__u32) (h1->ival[i] - n->ival[i]);
-						n->val[i] += incr;
-						n->ival[i] = h1->ival[i];
-					}
-
-					sample = (double)(incr*1000)/interval;
-					if (interval >= scan_interval) {
-						n->rate[i] += W*(sample-n->rate[i]);
-					} else if (interval >= 1000) {
-						if (interval >= time_constant) {
-							n->rate[i] = sample;
-						} else {
-							double w = W*(double)interval/scan_interval;
-
-							n->rate[i] += w*(sample-n->rate[i]);
-						}
-					}
-				}
+static void update_ent(struct ifstat_ent *n, const struct ifstat_ent *h1,
+		       int interval)
+{
+	int i;
+
+	for (i = 0; i < MAXS; i++) {
+		if (h1->ival[i] < n->ival[i]) {
+			memset(n->ival, 0, sizeof(n->ival));
+			break;
+		}
+	}
+	for (i = 0; i < MAXS; i++) {
+		double sample;
+		__u64 incr;
+
+		if (is_extended) {
+			incr = h1->val[i] - n->val[i];
+			n->val[i] = h1->val[i];
+		} else {
+			incr = (__u32) (h1->ival[i] - n->ival[i]);
+			n->val[i] += incr;
+			n->ival[i] = h1->ival[i];
+		}
+
+		sample = (double)(incr*1000)/interval;
+		if (interval >= scan_interval) {
+			n->rate[i] += W*(sample-n->rate[i]);
+		} else if (interval >= 1000) {
+			if (interval >= time_constant) {
+				n->rate[i] = sample;
+			} else {
+				double w = W*(double)interval/scan_interval;
+
+				n->rate[i] += w*(sample-n->rate[i]);
+			}
+		}
+	}
+}
+
+/*
+ * The daemon keeps kern_db across scans and updates it in place. Links
+ * that are new to it are inserted behind the previous link of the dump,
+ * so the list stays in dump order.
+ */
+static unsigned int scan_gen;
+static struct ifstat_ent **scan_pos;
+
+static void update_begin(void)
+{
+	scan_gen++;
+	scan_pos = &kern_db;
+}
+
+static int update_nlmsg(struct nlmsghdr *m, void *arg)
+{
+	struct ifstat_ent sample = {};
+	struct ifstat_ent *n;
+	const char *name;
+	int ret;
+
+	if (is_extended)
+		ret = parse_nlmsg_extended(m, &sample, &name);
+	else
+		ret = parse_nlmsg(m, &sample, &name);
+	if (ret < 0 || !sample.ifindex)
+		return ret;
+
+	n = db_lookup(kern_hash, sample.ifindex);
+	if (!ret) {
+		/* link is down or has no counters, keep what we had */
+		if (n)
+			n->seen = scan_gen;
+		return 0;
+	}
+
+	if (!n) {
+		n = new_ent(&sample, name);
+		if (!n) {
+			errno = ENOMEM;
+			return -1;
+		}
+		n->next = *scan_pos;
+		*scan_pos = n;
+		db_hash_add(kern_hash, n);
+	} else {
+		if (strcmp(n->name, name)) {
+			char *new_name = strdup(name);
 
-				while (h != h1) {
-					struct ifstat_ent *tmp = h;
-
-					h = h->next;
-					free(tmp->name);
-					free(tmp);
-				};
-				h = h1->next;
-				free(h1->name);
-				free(h1);
-				break;
+			if (new_name) {
+				free(n->name);
+				n->name = new_name;
 			}
 		}
+		update_ent(n, &sample, *(int *)arg);
+	}
+
+	n->seen = scan_gen;
+	scan_pos = &n->next;
+	return 0;
+}
+
+/* Forget the links that were not in the last dump */
+static void update_end(void)
+{
+	struct ifstat_ent **pp = &kern_db;
+	struct ifstat_ent *n;
+
+	while ((n = *pp) != NULL) {
+		if (n->seen == scan_gen) {
+			pp = &n->next;
+			continue;
+		}
+		*pp = n->next;
+		db_hash_del(kern_hash, n);
+		free(n->name);
+		free(n);
 	}
 }
 
+static void update_db(int interval)
+{
+	struct rtnl_handle rth;
+	int err;
+
+	if (rtnl_open(&rth, 0) < 0)
+		exit(1);
+
+	if (is_extended) {
+		ll_init_map(&rth);
+		err = rtnl_statsdump_req_filter(&rth, AF_UNSPEC,
+						IFLA_STATS_FILTER_BIT(filter_type),
+						NULL, NULL);
+	} else {
+		err = rtnl_linkdump_req(&rth, AF_INET);
+	}
+	if (err < 0) {
+		perror("Cannot send dump request");
+		exit(1);
+	}
+
+	update_begin();
+	if (rtnl_dump_filter(&rth, update_nlmsg, &interval) < 0) {
+		perror("Dump terminated\n");
+		exit(1);
+	}
+	update_end();
+
+	rtnl_close(&rth);
+}
+
 #define T_DIFF(a, b) (((a).tv_sec-(b).tv_sec)*1000 + ((a).tv_usec-(b).tv_usec)/1000)
 
 
 static void server_loop(int fd)
 {
 	struct timeval snaptime = { 0 };
-	struct pollfd p;
+	struct pollfd p[2];
 
-	p.fd = fd;
-	p.events = p.revents = POLLIN;
+	p[0].fd = fd;
+	p[0].events = POLLIN;
+	p[1].fd = shm_fd;
+	p[1].events = POLLIN;
 
 	snprintf(info_source, sizeof(info_source), "%d.%lu sampling_interval=%d time_const=%d",
 		getpid(), (unsigned long)random(), scan_interval/1000, time_constant/1000);
 
-	load_info();
-
 	for (;;) {
-		int status;
+		int status, nready;
 		time_t tdiff;
 		struct timeval now;
 
@@ -716,12 +945,17 @@ static void server_loop(int fd)
 		tdiff = T_DIFF(now, snaptime);
 		if (tdiff >= scan_interval) {
 			update_db(tdiff);
+			shm_export();
 			snaptime = now;
 			tdiff = 0;
 		}
 
-		if (poll(&p, 1, scan_interval - tdiff) > 0
-		    && (p.revents&POLLIN)) {
+		nready = poll(p, 2, scan_interval - tdiff);
+
+		if (nready > 0 && (p[1].revents & POLLIN))
+			stats_shm_serve(&shm, shm_fd);
+
+		if (nready > 0 && (p[0].revents & POLLIN)) {
 			int clnt = accept(fd, NULL, NULL);
 
 			if (clnt >= 0) {
@@ -939,6 +1173,12 @@ int main(int argc, char *argv[])
 			perror("ifstat: listen");
 			exit(-1);
 		}
+		/* the text socket above keeps working without it */
+		if (stats_shm_create(&shm) == 0) {
+			shm_fd = stats_shm_listen("ifstat");
+			if (shm_fd < 0)
+				stats_shm_close(&shm);
+		}
 		if (daemon(0, 0)) {
 			perror("ifstat: daemon");
 			exit(-1);
@@ -1013,7 +1253,12 @@ int main(int argc, char *argv[])
 		kern_db = NULL;
 	}
 
-	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
+	if (load_shm_table() == 0) {
+		if (hist_db && source_mismatch) {
+			fprintf(stderr, "ifstat: history is stale, ignoring it.\n");
+			hist_db = NULL;
+		}
+	} else if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
 	    (connect(fd, (struct sockaddr *)&sun, 2+1+strlen(sun.sun_path+1)) == 0
 	     || (strcpy(sun.sun_path+1, "ifstat0"),
 		 connect(fd, (struct sockaddr *)&sun, 2+1+strlen(sun.sun_path+1)) == 0))
@@ -25,6 +25,7 @@
 #include <getopt.h>
 
 #include <json_writer.h>
+#include "stats_shm.h"
 #include "version.h"
 #include "utils.h"
 
@@ -152,6 +153,49 @@ static void load_good_table(FILE *fp)
 	}
 }
 
+/* Same as load_good_table(), from the daemon's shared memory snapshot */
+static int load_shm_table(void)
+{
+	struct stats_shm_nstat *recs;
+	struct nstat_ent **tail = &kern_db;
+	char source[sizeof(info_source)];
+	struct stats_shm shm;
+	__u32 i, nrec;
+
+	if (stats_shm_open(&shm, "nstat") < 0)
+		return -1;
+	recs = stats_shm_read(&shm, sizeof(*recs), &nrec,
+			      source, sizeof(source));
+	stats_shm_close(&shm);
+	if (!recs)
+		return -1;
+
+	if (info_source[0] && strcmp(info_source, source))
+		source_mismatch = 1;
+	strlcpy(info_source, source, sizeof(info_source));
+
+	for (i = 0; i < nrec; i++) {
+		struct nstat_ent *n;
+
+		recs[i].id[sizeof(recs[i].id) - 1] = 0;
+		if (useless_number(recs[i].id))
+			continue;
+		if ((n = malloc(sizeof(*n))) == NULL) {
+			perror("nstat: malloc");
+			exit(-1);
+		}
+		n->id = strdup(recs[i].id);
+		n->val = recs[i].val;
+		n->rate = recs[i].rate;
+		n->next = NULL;
+		*tail = n;
+		tail = &n->next;
+	}
+
+	free(recs);
+	return 0;
+}
+
 static int count_spaces(const char *line)
 {
 	int count = 0;
@@ -401,11 +445,44 @@ static void dump_incr_db(FILE *fp)
 }
 
 static int children;
+static struct stats_shm shm;
+static int shm_fd = -1;
 
 static void sigchild(int signo)
 {
 }
 
+/* Publish what dump_kern_db() would send to a client, in binary */
+static void shm_export(void)
+{
+	struct stats_shm_nstat *rec;
+	struct nstat_ent *n;
+	__u32 nrec = 0;
+
+	if (shm_fd < 0)
+		return;
+
+	for (n = kern_db; n; n = n->next)
+		if (dump_zeros || n->val || n->rate)
+			nrec++;
+
+	rec = stats_shm_write_begin(&shm, sizeof(*rec), nrec, info_source);
+	if (!rec)
+		return;
+
+	for (n = kern_db; n; n = n->next) {
+		if (!dump_zeros && !n->val && !n->rate)
+			continue;
+		memset(rec, 0, sizeof(*rec));
+		strlcpy(rec->id, n->id, sizeof(rec->id));
+		rec->val = n->val;
+		rec->rate = n->rate;
+		rec++;
+	}
+
+	stats_shm_write_end(&shm);
+}
+
 static void update_db(int interval)
 {
 	struct nstat_ent *n, *h;
@@ -465,10 +542,12 @@ static void update_db(int interval)
 static void server_loop(int fd)
 {
 	struct timeval snaptime = { 0 };
-	struct pollfd p;
+	struct pollfd p[2];
 
-	p.fd = fd;
-	p.events = p.revents = POLLIN;
+	p[0].fd = fd;
+	p[0].events = POLLIN;
+	p[1].fd = shm_fd;
+	p[1].events = POLLIN;
 
 	snprintf(info_source, sizeof(info_source), "%d.%lu sampling_interval=%d time_const=%d",
 		getpid(), (unsigned long)random(), scan_interval/1000, time_constant/1000);
@@ -479,7 +558,7 @@ static void server_loop(int fd)
 	load_sctp_snmp();
 
 	for (;;) {
-		int status;
+		int status, nready;
 		time_t tdiff;
 		struct timeval now;
 
@@ -487,11 +566,16 @@ static void server_loop(int fd)
 		tdiff = T_DIFF(now, snaptime);
 		if (tdiff >= scan_interval) {
 			update_db(tdiff);
+			shm_export();
 			snaptime = now;
 			tdiff = 0;
 		}
-		if (poll(&p, 1, scan_interval - tdiff) > 0
-		    && (p.revents&POLLIN)) {
+		nready = poll(p, 2, scan_interval - tdiff);
+
+		if (nready > 0 && (p[1].revents & POLLIN))
+			stats_shm_serve(&shm, shm_fd);
+
+		if (nready > 0 && (p[0].revents & POLLIN)) {
 			int clnt = accept(fd, NULL, NULL);
 
 			if (clnt >= 0) {
@@ -642,6 +726,12 @@ int main(int argc, char *argv[])
 			perror("nstat: listen");
 			exit(-1);
 		}
+		/* the text socket above keeps working without it */
+		if (stats_shm_create(&shm) == 0) {
+			shm_fd = stats_shm_listen("nstat");
+			if (shm_fd < 0)
+				stats_shm_close(&shm);
+		}
 		if (daemon(0, 0)) {
 			perror("nstat: daemon");
 			exit(-1);
@@ -710,7 +800,12 @@ int main(int argc, char *argv[])
 		kern_db = NULL;
 	}
 
-	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
+	if (load_shm_table() == 0) {
+		if (hist_db && source_mismatch) {
+			fprintf(stderr, "nstat: history is stale, ignoring it.\n");
+			hist_db = NULL;
+		}
+	} else if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
 	    (connect(fd, (struct sockaddr *)&sun, 2+1+strlen(sun.sun_path+1)) == 0
 	     || (strcpy(sun.sun_path+1, "nstat0"),
 		 connect(fd, (struct sockaddr *)&sun, 2+1+strlen(sun.sun_path+1)) == 0))
@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "ss_util.h"
 #include "utils.h"
@@ -110,6 +111,9 @@ static int show_tipcinfo;
 static int show_tos;
 static int show_cgroup;
 static int show_inet_sockopt;
+static int diag_parallel;
+static int stream_rows;
+static int rate_interval;
 int oneline;
 
 enum col_id {
@@ -179,6 +183,7 @@ static struct {
 	struct buf_chunk *head;	/* First chunk */
 	struct buf_chunk *tail;	/* Current chunk */
 	int chunks;		/* Number of allocated chunks */
+	int rows;		/* Complete lines since the last render */
 } buffer;
 
 static const char *TCP_PROTO = "tcp";
@@ -511,6 +516,41 @@ struct user_ent {
 #define USER_ENT_HASH_SIZE	256
 static struct user_ent *user_ent_hash[USER_ENT_HASH_SIZE];
 
+/* With -p the owners of the printed sockets are looked up right before
+ * the output is rendered: only the inodes of sockets that passed the
+ * filter are collected here, and the /proc walk skips everything else.
+ */
+struct user_ent_slot {
+	unsigned int	ino;
+	bool		found;
+	char		*users;
+};
+
+static struct {
+	struct user_ent_slot	*slots;
+	unsigned int		size;
+	unsigned int		count;
+	unsigned int		remaining;
+} user_ent_wanted;
+
+static bool user_ent_deferred;
+static bool user_ent_complete;
+static int user_ent_first;
+
+#define USER_ENT_WALKERS_MAX	16
+#define MAX_PATH_LEN		1024
+
+struct user_ent_walk {
+	char		root[MAX_PATH_LEN];
+	int		*pids;
+	int		npids;
+	int		next;
+	struct user_ent	**ents;		/* per pid, in /proc order */
+	bool		targeted;
+	bool		stop;		/* read without lock, see user_ent_stop() */
+	pthread_mutex_t	lock;
+};
+
 static int user_ent_hashfn(unsigned int ino)
 {
 	int val = (ino >> 24) ^ (ino >> 16) ^ (ino >> 8) ^ ino;
@@ -518,12 +558,65 @@ static int user_ent_hashfn(unsigned int ino)
 	return val & (USER_ENT_HASH_SIZE - 1);
 }
 
-static void user_ent_add(unsigned int ino, char *task,
-					int pid, int tid, int fd,
-					char *task_ctx,
-					char *sock_ctx)
+static struct user_ent_slot *user_ent_slot(unsigned int ino)
+{
+	unsigned int i, mask = user_ent_wanted.size - 1;
+	struct user_ent_slot *slot;
+
+	if (!user_ent_wanted.size)
+		return NULL;
+
+	for (i = ino * 2654435761U; ; i++) {
+		slot = &user_ent_wanted.slots[i & mask];
+		if (slot->ino == ino || !slot->ino)
+			return slot;
+	}
+}
+
+static void user_ent_want(unsigned int ino)
+{
+	struct user_ent_slot *slot;
+
+	if (user_ent_wanted.count * 2 >= user_ent_wanted.size) {
+		struct user_ent_slot *old = user_ent_wanted.slots;
+		unsigned int i, size = user_ent_wanted.size;
+
+		user_ent_wanted.size = size ? size * 2 : 1024;
+		user_ent_wanted.slots = calloc(user_ent_wanted.size,
+					       sizeof(*old));
+		if (!user_ent_wanted.slots) {
+			fprintf(stderr, "ss: failed to malloc buffer\n");
+			abort();
+		}
+		for (i = 0; i < size; i++)
+			if (old[i].ino)
+				*user_ent_slot(old[i].ino) = old[i];
+		free(old);
+	}
+
+	slot = user_ent_slot(ino);
+	if (slot->ino)
+		return;
+
+	slot->ino = ino;
+	user_ent_wanted.count++;
+}
+
+static void user_ent_want_reset(void)
 {
-	struct user_ent *p, **pp;
+	unsigned int i;
+
+	for (i = 0; i < user_ent_wanted.size; i++)
+		free(user_ent_wanted.slots[i].users);
+	free(user_ent_wanted.slots);
+	memset(&user_ent_wanted, 0, sizeof(user_ent_wanted));
+}
+
+static struct user_ent *user_ent_new(unsigned int ino, char *task,
+				     int pid, int tid, int fd,
+				     char *task_ctx, char *sock_ctx)
+{
+	struct user_ent *p;
 
 	p = malloc(sizeof(struct user_ent));
 	if (!p) {
@@ -539,39 +632,61 @@ static void user_ent_add(unsigned int ino, char *task,
 	p->task_ctx = strdup(task_ctx);
 	p->socket_ctx = strdup(sock_ctx);
 
-	pp = &user_ent_hash[user_ent_hashfn(ino)];
+	return p;
+}
+
+static void user_ent_add(struct user_ent *p)
+{
+	struct user_ent **pp;
+
+	pp = &user_ent_hash[user_ent_hashfn(p->ino)];
 	p->next = *pp;
 	*pp = p;
 }
 
-#define MAX_PATH_LEN	1024
+/* The directory loops poll this without taking w->lock */
+static bool user_ent_stop(struct user_ent_walk *w)
+{
+	return __atomic_load_n(&w->stop, __ATOMIC_RELAXED);
+}
+
+/* Account for a wanted socket, stop the walk once all have an owner */
+static void user_ent_found(struct user_ent_walk *w,
+			   struct user_ent_slot *slot)
+{
+	pthread_mutex_lock(&w->lock);
+	if (!slot->found) {
+		slot->found = true;
+		if (!--user_ent_wanted.remaining && user_ent_first)
+			__atomic_store_n(&w->stop, true, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
 
-static void user_ent_hash_build_task(char *path, int pid, int tid)
+static void user_ent_hash_build_task(struct user_ent_walk *w, char *path,
+				     int pid, int tid,
+				     struct user_ent ***tail)
 {
 	const char *no_ctx = "unavailable";
 	char task[16] = {'\0', };
 	char stat[MAX_PATH_LEN];
+	char *task_context = NULL;
 	int pos_id, pos_fd;
-	char *task_context;
 	struct dirent *d;
 	DIR *dir;
 
-	if (getpidcon(tid, &task_context) != 0)
-		task_context = strdup(no_ctx);
-
 	pos_id = strlen(path);	/* $PROC_ROOT/$ID/ */
 
 	snprintf(path + pos_id, MAX_PATH_LEN - pos_id, "fd/");
 	dir = opendir(path);
-	if (!dir) {
-		freecon(task_context);
+	if (!dir)
 		return;
-	}
 
 	pos_fd = strlen(path);	/* $PROC_ROOT/$ID/fd/ */
 
-	while ((d = readdir(dir)) != NULL) {
+	while (!user_ent_stop(w) && (d = readdir(dir)) != NULL) {
 		const char *pattern = "socket:[";
+		struct user_ent_slot *slot = NULL;
 		char *sock_context;
 		unsigned int ino;
 		ssize_t link_len;
@@ -594,6 +709,15 @@ static void user_ent_hash_build_task(char *path, int pid, int tid)
 		if (sscanf(lnk, "socket:[%u]", &ino) != 1)
 			continue;
 
+		if (w->targeted) {
+			slot = user_ent_slot(ino);
+			if (!slot->ino)
+				continue;
+		}
+
+		if (!task_context && getpidcon(tid, &task_context) != 0)
+			task_context = strdup(no_ctx);
+
 		if (getfilecon(path, &sock_context) <= 0)
 			sock_context = strdup(no_ctx);
 
@@ -612,8 +736,13 @@ static void user_ent_hash_build_task(char *path, int pid, int tid)
 			}
 		}
 
-		user_ent_add(ino, task, pid, tid, fd, task_context, sock_context);
+		**tail = user_ent_new(ino, task, pid, tid, fd, task_context,
+				      sock_context);
+		*tail = &(**tail)->next;
 		freecon(sock_context);
+
+		if (slot)
+			user_ent_found(w, slot);
 	}
 
 	freecon(task_context);
@@ -635,26 +764,84 @@ static void user_ent_destroy(void)
 			free(p);
 			p = p_next;
 		}
+		user_ent_hash[cnt] = NULL;
 		cnt++;
 	}
 }
 
-static void user_ent_hash_build(void)
+static void user_ent_walk_pid(struct user_ent_walk *w, int i)
 {
-	const char *root = getenv("PROC_ROOT") ? : "/proc/";
+	struct user_ent **tail = &w->ents[i];
 	char name[MAX_PATH_LEN];
+	int nameoff, pid = w->pids[i];
+
+	strlcpy(name, w->root, sizeof(name));
+	nameoff = strlen(name);
+
+	snprintf(name + nameoff, sizeof(name) - nameoff, "%d/", pid);
+	user_ent_hash_build_task(w, name, pid, pid, &tail);
+
+	if (show_threads) {
+		struct dirent *task_d;
+		DIR *task_dir;
+
+		snprintf(name + nameoff, sizeof(name) - nameoff, "%d/task/", pid);
+
+		task_dir = opendir(name);
+		if (!task_dir)
+			return;
+
+		while (!user_ent_stop(w) &&
+		       (task_d = readdir(task_dir)) != NULL) {
+			int tid;
+
+			if (sscanf(task_d->d_name, "%d%*c", &tid) != 1)
+				continue;
+			if (tid == pid)
+				continue;
+
+			snprintf(name + nameoff, sizeof(name) - nameoff, "%d/", tid);
+			user_ent_hash_build_task(w, name, pid, tid, &tail);
+		}
+		closedir(task_dir);
+	}
+}
+
+static void *user_ent_walker(void *arg)
+{
+	struct user_ent_walk *w = arg;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&w->lock);
+		i = w->stop ? w->npids : w->next++;
+		pthread_mutex_unlock(&w->lock);
+
+		if (i >= w->npids)
+			break;
+
+		user_ent_walk_pid(w, i);
+	}
+
+	return NULL;
+}
+
+/* Walk /proc for socket owners; with @targeted only the wanted inodes */
+static void user_ent_hash_build(bool targeted)
+{
+	const char *root = getenv("PROC_ROOT") ? : "/proc/";
+	pthread_t threads[USER_ENT_WALKERS_MAX];
+	struct user_ent_walk w = {};
+	int i, nthreads, size = 0;
 	struct dirent *d;
-	int nameoff;
 	DIR *dir;
 
-	strlcpy(name, root, sizeof(name));
+	strlcpy(w.root, root, sizeof(w.root));
 
-	if (strlen(name) == 0 || name[strlen(name) - 1] != '/')
-		strcat(name, "/");
-
-	nameoff = strlen(name);
+	if (strlen(w.root) == 0 || w.root[strlen(w.root) - 1] != '/')
+		strcat(w.root, "/");
 
-	dir = opendir(name);
+	dir = opendir(w.root);
 	if (!dir)
 		return;
 
@@ -664,34 +851,71 @@ static void user_ent_hash_build(void)
 		if (sscanf(d->d_name, "%d%*c", &pid) != 1)
 			continue;
 
-		snprintf(name + nameoff, sizeof(name) - nameoff, "%d/", pid);
-		user_ent_hash_build_task(name, pid, pid);
+		if (w.npids == size) {
+			int *pids;
 
-		if (show_threads) {
-			struct dirent *task_d;
-			DIR *task_dir;
+			size = size ? size * 2 : 1024;
+			pids = realloc(w.pids, size * sizeof(*pids));
+			if (!pids) {
+				fprintf(stderr, "ss: failed to malloc buffer\n");
+				abort();
+			}
+			w.pids = pids;
+		}
+		w.pids[w.npids++] = pid;
+	}
+	closedir(dir);
+
+	w.ents = calloc(w.npids ? : 1, sizeof(*w.ents));
+	if (!w.ents) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+	w.targeted = targeted;
+	user_ent_wanted.remaining = user_ent_wanted.count;
+	pthread_mutex_init(&w.lock, NULL);
 
-			snprintf(name + nameoff, sizeof(name) - nameoff, "%d/task/", pid);
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > USER_ENT_WALKERS_MAX)
+		nthreads = USER_ENT_WALKERS_MAX;
+	if (nthreads > w.npids / 64)
+		nthreads = w.npids / 64;
 
-			task_dir = opendir(name);
-			if (!task_dir)
-				continue;
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, user_ent_walker, &w))
+			break;
+	nthreads = i;
 
-			while ((task_d = readdir(task_dir)) != NULL) {
-				int tid;
+	user_ent_walker(&w);
 
-				if (sscanf(task_d->d_name, "%d%*c", &tid) != 1)
-					continue;
-				if (tid == pid)
-					continue;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&w.lock);
 
-				snprintf(name + nameoff, sizeof(name) - nameoff, "%d/", tid);
-				user_ent_hash_build_task(name, pid, tid);
-			}
-			closedir(task_dir);
+	/* Link in /proc order, as a sequential walk would have */
+	for (i = 0; i < w.npids; i++) {
+		struct user_ent *p, *next;
+
+		for (p = w.ents[i]; p; p = next) {
+			next = p->next;
+			user_ent_add(p);
 		}
 	}
-	closedir(dir);
+
+	free(w.ents);
+	free(w.pids);
+}
+
+/* Name of the task that find_entry() would list first */
+static const char *user_ent_task(unsigned int ino)
+{
+	struct user_ent *p;
+
+	for (p = user_ent_hash[user_ent_hashfn(ino)]; p; p = p->next)
+		if (p->ino == ino)
+			return p->task;
+
+	return NULL;
 }
 
 enum entry_types {
@@ -777,6 +1001,78 @@ next:
 	return cnt;
 }
 
+static int user_ent_type(void)
+{
+	if (show_proc_ctx || show_sock_ctx)
+		return (show_proc_ctx & show_sock_ctx) ? PROC_SOCK_CTX : PROC_CTX;
+
+	return USERS;
+}
+
+/* Find the owners of the sockets queued since the last render() */
+static void user_ent_resolve(void)
+{
+	unsigned int i;
+
+	if (!user_ent_wanted.count)
+		return;
+
+	if (!user_ent_complete) {
+		user_ent_destroy();
+
+		/* The buffer filled up and more sockets will follow, or
+		 * --stream renders one window after another: index all of
+		 * them now rather than walking /proc once per chunk. A
+		 * targeted walk still reads every process, and only pays off
+		 * when it is the only one.
+		 */
+		if (buffer.chunks >= BUF_CHUNKS_MAX || stream_rows) {
+			user_ent_hash_build(false);
+			user_ent_complete = true;
+		} else {
+			user_ent_hash_build(true);
+		}
+	}
+
+	for (i = 0; i < user_ent_wanted.size; i++) {
+		struct user_ent_slot *slot = &user_ent_wanted.slots[i];
+		char *buf;
+		int len;
+
+		if (!slot->ino ||
+		    find_entry(slot->ino, &buf, user_ent_type()) <= 0)
+			continue;
+
+		len = asprintf(&slot->users, " users:(%s)", buf);
+		free(buf);
+		if (len < 0) {
+			slot->users = NULL;
+			continue;
+		}
+
+		if (len > columns[COL_PROC].max_len)
+			columns[COL_PROC].max_len = len;
+	}
+}
+
+/* Swap a deferred inode token for the owners found by user_ent_resolve() */
+static void user_ent_token(const char **data, int *len)
+{
+	struct user_ent_slot *slot;
+	unsigned int ino = 0;
+	int i;
+
+	for (i = 0; i < *len; i++) {
+		if ((*data)[i] < '0' || (*data)[i] > '9')
+			return;	/* header */
+		ino = ino * 10 + (*data)[i] - '0';
+	}
+
+	slot = user_ent_slot(ino);
+	*data = slot && slot->users ? slot->users : "";
+	*len = strlen(*data);
+}
+
 static unsigned long long cookie_sk_get(const uint32_t *cookie)
 {
 	return (((unsigned long long)cookie[1] << 31) << 1) | cookie[0];
@@ -1172,6 +1468,7 @@ static void buf_free_all(void)
 	}
 	buffer.head = NULL;
 	buffer.chunks = 0;
+	buffer.rows = 0;
 }
 
 /* Get current screen width, returns -1 if TIOCGWINSZ fails */
@@ -1291,6 +1588,8 @@ newline:
 	}
 }
 
+static bool render_widths_fixed;
+
 /* Render buffered output with spacing and delimiters, then free up buffers */
 static void render(void)
 {
@@ -1306,7 +1605,13 @@ static void render(void)
 	/* Ensure end alignment of last token, it wasn't necessarily flushed */
 	buffer.tail->end += buffer.cur->len % 2;
 
-	render_calc_width();
+	if (user_ent_deferred)
+		user_ent_resolve();
+
+	/* When streaming, the first window sets the layout for good */
+	if (!stream_rows || !render_widths_fixed)
+		render_calc_width();
+	render_widths_fixed = true;
 
 	/* Rewind and replay */
 	buffer.tail = buffer.head;
@@ -1316,6 +1621,12 @@ static void render(void)
 		f++;
 
 	while (token) {
+		const char *data = token->data;
+		int len = token->len;
+
+		if (user_ent_deferred && f == &columns[COL_PROC])
+			user_ent_token(&data, &len);
+
 		/* Print left delimiter only if we already started a line */
 		if (line_started++)
 			printed = printf("%s", f->ldelim);
@@ -1323,8 +1634,8 @@ static void render(void)
 			printed = 0;
 
 		/* Print field content from token data with spacing */
-		printed += print_left_spacing(f, token->len, printed);
-		printed += fwrite(token->data, 1, token->len, stdout);
+		printed += print_left_spacing(f, len, printed);
+		printed += fwrite(data, 1, len, stdout);
 		print_right_spacing(f, printed);
 
 		/* Go to next non-empty field, deal with end-of-line */
@@ -1348,14 +1659,22 @@ static void render(void)
 
 	buf_free_all();
 	current_field = columns;
+
+	if (user_ent_deferred)
+		user_ent_want_reset();
+
+	if (stream_rows)
+		fflush(stdout);
 }
 
 /* Move to next field, and render buffer if we reached the maximum number of
- * chunks, at the last field in a line.
+ * chunks, or of lines when streaming, at the last field in a line.
  */
 static void field_next(void)
 {
-	if (field_is_last(current_field) && buffer.chunks >= BUF_CHUNKS_MAX) {
+	if (field_is_last(current_field) &&
+	    (buffer.chunks >= BUF_CHUNKS_MAX ||
+	     (stream_rows && ++buffer.rows >= stream_rows))) {
 		render();
 		return;
 	}
@@ -1384,25 +1703,26 @@ static void print_header(void)
 	}
 }
 
+static const char * const sstate_name[] = {
+	"UNKNOWN",
+	[SS_ESTABLISHED] = "ESTAB",
+	[SS_SYN_SENT] = "SYN-SENT",
+	[SS_SYN_RECV] = "SYN-RECV",
+	[SS_FIN_WAIT1] = "FIN-WAIT-1",
+	[SS_FIN_WAIT2] = "FIN-WAIT-2",
+	[SS_TIME_WAIT] = "TIME-WAIT",
+	[SS_CLOSE] = "UNCONN",
+	[SS_CLOSE_WAIT] = "CLOSE-WAIT",
+	[SS_LAST_ACK] = "LAST-ACK",
+	[SS_LISTEN] =	"LISTEN",
+	[SS_CLOSING] = "CLOSING",
+	[SS_NEW_SYN_RECV] = "UNDEF", /* Never returned by kernel */
+	[SS_BOUND_INACTIVE] = "UNDEF", /* Never returned by kernel */
+};
+
 static void sock_state_print(struct sockstat *s)
 {
 	const char *sock_name;
-	static const char * const sstate_name[] = {
-		"UNKNOWN",
-		[SS_ESTABLISHED] = "ESTAB",
-		[SS_SYN_SENT] = "SYN-SENT",
-		[SS_SYN_RECV] = "SYN-RECV",
-		[SS_FIN_WAIT1] = "FIN-WAIT-1",
-		[SS_FIN_WAIT2] = "FIN-WAIT-2",
-		[SS_TIME_WAIT] = "TIME-WAIT",
-		[SS_CLOSE] = "UNCONN",
-		[SS_CLOSE_WAIT] = "CLOSE-WAIT",
-		[SS_LAST_ACK] = "LAST-ACK",
-		[SS_LISTEN] =	"LISTEN",
-		[SS_CLOSING] = "CLOSING",
-		[SS_NEW_SYN_RECV] = "UNDEF", /* Never returned by kernel */
-		[SS_BOUND_INACTIVE] = "UNDEF", /* Never returned by kernel */
-	};
 
 	switch (s->local.family) {
 	case AF_UNIX:
@@ -2433,18 +2753,23 @@ static void proc_ctx_print(struct sockstat *s)
 {
 	char *buf;
 
-	if (show_proc_ctx || show_sock_ctx) {
-		if (find_entry(s->ino, &buf,
-				(show_proc_ctx & show_sock_ctx) ?
-				PROC_SOCK_CTX : PROC_CTX) > 0) {
-			out(" users:(%s)", buf);
-			free(buf);
-		}
-	} else if (show_processes || show_threads) {
-		if (find_entry(s->ino, &buf, USERS) > 0) {
-			out(" users:(%s)", buf);
-			free(buf);
+	if (user_ent_deferred) {
+		struct column *c = &columns[COL_PROC];
+		int max_len = c->max_len;
+
+		/* Only the inode for now, render() fills in the owners */
+		if (s->ino && !c->disabled) {
+			user_ent_want(s->ino);
+			out("%u", s->ino);
 		}
+		field_next();
+		c->max_len = max_len;
+		return;
+	}
+
+	if (find_entry(s->ino, &buf, user_ent_type()) > 0) {
+		out(" users:(%s)", buf);
+		free(buf);
 	}
 
 	field_next();
@@ -3825,109 +4150,461 @@ static int inet_show_sock(struct nlmsghdr *nlh,
 	return 0;
 }
 
-static int tcpdiag_send(int fd, int protocol, struct filter *f)
-{
-	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
-	struct {
-		struct nlmsghdr nlh;
-		struct inet_diag_req r;
-	} req = {
-		.nlh.nlmsg_len = sizeof(req),
-		.nlh.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST,
-		.nlh.nlmsg_seq = MAGIC_SEQ,
-		.r.idiag_family = AF_INET,
-		.r.idiag_states = f->states,
-	};
-	char    *bc = NULL;
-	int	bclen;
-	struct msghdr msg;
-	struct rtattr rta;
-	struct iovec iov[3];
-	int iovlen = 1;
+/* --group-by: instead of printing each inet socket, fold it into a group
+ * keyed by the selected fields and print per group statistics at the end.
+ */
+enum group_key {
+	GROUP_NETID,
+	GROUP_STATE,
+	GROUP_LPORT,
+	GROUP_RPORT,
+	GROUP_REMOTE,
+	GROUP_CGROUP,
+	GROUP_PROCESS,
+	GROUP_KEY_MAX
+};
 
-	if (protocol == IPPROTO_TCP)
-		req.nlh.nlmsg_type = TCPDIAG_GETSOCK;
-	else if (protocol == IPPROTO_DCCP)
-		req.nlh.nlmsg_type = DCCPDIAG_GETSOCK;
-	else
-		return -1;
+static const char * const group_key_names[GROUP_KEY_MAX] = {
+	[GROUP_NETID]	= "netid",
+	[GROUP_STATE]	= "state",
+	[GROUP_LPORT]	= "lport",
+	[GROUP_RPORT]	= "rport",
+	[GROUP_REMOTE]	= "remote",
+	[GROUP_CGROUP]	= "cgroup",
+	[GROUP_PROCESS]	= "process",
+};
 
-	if (show_mem) {
-		req.r.idiag_ext |= (1<<(INET_DIAG_MEMINFO-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_SKMEMINFO-1));
-	}
+enum group_metric {
+	GROUP_RTT,
+	GROUP_CWND,
+	GROUP_SENDQ,
+	GROUP_RECVQ,
+	GROUP_METRIC_MAX
+};
 
-	if (show_tcpinfo) {
-		req.r.idiag_ext |= (1<<(INET_DIAG_INFO-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_VEGASINFO-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_CONG-1));
-	}
+static const char * const group_metric_names[GROUP_METRIC_MAX] = {
+	[GROUP_RTT]	= "rtt",
+	[GROUP_CWND]	= "cwnd",
+	[GROUP_SENDQ]	= "send-q",
+	[GROUP_RECVQ]	= "recv-q",
+};
 
-	if (show_tos) {
-		req.r.idiag_ext |= (1<<(INET_DIAG_TOS-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_TCLASS-1));
-	}
+struct group_values {
+	double		*vals;
+	unsigned int	cnt;
+	unsigned int	size;
+	double		sum;
+};
 
-	iov[0] = (struct iovec){
-		.iov_base = &req,
-		.iov_len = sizeof(req)
-	};
-	if (f->f) {
-		bclen = ssfilter_bytecompile(f->f, &bc);
-		if (bclen) {
-			rta.rta_type = INET_DIAG_REQ_BYTECODE;
-			rta.rta_len = RTA_LENGTH(bclen);
-			iov[1] = (struct iovec){ &rta, sizeof(rta) };
-			iov[2] = (struct iovec){ bc, bclen };
-			req.nlh.nlmsg_len += RTA_LENGTH(bclen);
-			iovlen = 3;
-		}
-	}
+struct sock_group {
+	struct sock_group	*next;
+	unsigned int		hash;
+	unsigned long		count;
+	struct group_values	metrics[GROUP_METRIC_MAX];
+	char			key[];
+};
 
-	msg = (struct msghdr) {
-		.msg_name = (void *)&nladdr,
-		.msg_namelen = sizeof(nladdr),
-		.msg_iov = iov,
-		.msg_iovlen = iovlen,
-	};
+static int group_by[GROUP_KEY_MAX];
+static int group_by_cnt;
 
-	if (sendmsg(fd, &msg, 0) < 0) {
-		close(fd);
+static struct {
+	struct sock_group	**table;
+	unsigned int		size;
+	unsigned int		count;
+} groups;
+
+static int group_by_parse(const char *arg)
+{
+	char *keys, *key, *saveptr = NULL;
+	int i;
+
+	keys = strdup(arg);
+	if (!keys)
 		return -1;
+
+	for (key = strtok_r(keys, ",", &saveptr); key;
+	     key = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; i < GROUP_KEY_MAX; i++)
+			if (strcmp(key, group_key_names[i]) == 0)
+				break;
+
+		if (i == GROUP_KEY_MAX || group_by_cnt == GROUP_KEY_MAX) {
+			fprintf(stderr,
+				"ss: invalid group key \"%s\", expected {netid|state|lport|rport|remote|cgroup|process}[,...]\n",
+				key);
+			free(keys);
+			return -1;
+		}
+		group_by[group_by_cnt++] = i;
 	}
 
-	return 0;
+	free(keys);
+	return group_by_cnt ? 0 : -1;
 }
 
-static int sockdiag_send(int family, int fd, int protocol, struct filter *f)
+static int group_key_remote(char *buf, int len, const inet_prefix *a)
 {
-	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
-	DIAG_REQUEST(req, struct inet_diag_req_v2 r);
-	struct rtattr *bpf_rta = NULL;
-	char    *bc = NULL;
-	int	bclen;
-	__u32	proto;
-	struct msghdr msg;
-	struct rtattr rta_bc;
-	struct rtattr rta_proto;
-	struct iovec iov[6];
-	int iovlen = 1;
+	unsigned char addr[16] = {};
+	char abuf[INET6_ADDRSTRLEN];
+	int plen = 24;
 
-	if (family == PF_UNSPEC)
-		return tcpdiag_send(fd, protocol, f);
+	if (a->family == AF_INET6)
+		plen = 64;
+	else if (a->family != AF_INET)
+		return snprintf(buf, len, "*");
 
-	memset(&req.r, 0, sizeof(req.r));
-	req.r.sdiag_family = family;
-	req.r.sdiag_protocol = protocol;
-	req.r.idiag_states = f->states;
-	if (show_mem) {
-		req.r.idiag_ext |= (1<<(INET_DIAG_MEMINFO-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_SKMEMINFO-1));
-	}
+	memcpy(addr, a->data, plen / 8);
+	inet_ntop(a->family, addr, abuf, sizeof(abuf));
 
-	if (show_tcpinfo) {
-		req.r.idiag_ext |= (1<<(INET_DIAG_INFO-1));
-		req.r.idiag_ext |= (1<<(INET_DIAG_VEGASINFO-1));
+	return snprintf(buf, len, "%s/%d", abuf, plen);
+}
+
+static void group_key_build(char *buf, int len, const struct sockstat *s)
+{
+	const char *task;
+	int i, n = 0;
+
+	buf[0] = '\0';
+	for (i = 0; i < group_by_cnt && n < len; i++) {
+		if (i)
+			n += snprintf(buf + n, len - n, " ");
+		if (n >= len)
+			break;
+
+		n += snprintf(buf + n, len - n, "%s:",
+			      group_key_names[group_by[i]]);
+		if (n >= len)
+			break;
+
+		switch (group_by[i]) {
+		case GROUP_NETID:
+			n += snprintf(buf + n, len - n, "%s",
+				      proto_name(s->type));
+			break;
+		case GROUP_STATE:
+			n += snprintf(buf + n, len - n, "%s",
+				      sstate_name[s->state]);
+			break;
+		case GROUP_LPORT:
+			n += snprintf(buf + n, len - n, "%d", s->lport);
+			break;
+		case GROUP_RPORT:
+			n += snprintf(buf + n, len - n, "%d", s->rport);
+			break;
+		case GROUP_REMOTE:
+			n += group_key_remote(buf + n, len - n, &s->remote);
+			break;
+		case GROUP_CGROUP:
+			n += snprintf(buf + n, len - n, "%s",
+				      s->cgroup_id ?
+				      cg_id_to_path(s->cgroup_id) : "*");
+			break;
+		case GROUP_PROCESS:
+			task = user_ent_task(s->ino);
+			n += snprintf(buf + n, len - n, "%s", task ? : "*");
+			break;
+		}
+	}
+}
+
+static unsigned int group_hash(const char *key)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*key)
+		hash = (hash ^ (unsigned char)*key++) * 16777619U;
+
+	return hash;
+}
+
+static void group_table_grow(void)
+{
+	unsigned int i, size = groups.size ? groups.size * 2 : 1024;
+	struct sock_group **table, *g, *next;
+
+	table = calloc(size, sizeof(*table));
+	if (!table) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+
+	for (i = 0; i < groups.size; i++) {
+		for (g = groups.table[i]; g; g = next) {
+			next = g->next;
+			g->next = table[g->hash & (size - 1)];
+			table[g->hash & (size - 1)] = g;
+		}
+	}
+
+	free(groups.table);
+	groups.table = table;
+	groups.size = size;
+}
+
+static struct sock_group *group_get(const char *key)
+{
+	unsigned int hash = group_hash(key);
+	struct sock_group *g;
+
+	if (groups.table) {
+		for (g = groups.table[hash & (groups.size - 1)]; g; g = g->next)
+			if (g->hash == hash && strcmp(g->key, key) == 0)
+				return g;
+	}
+
+	if (groups.count >= groups.size)
+		group_table_grow();
+
+	g = calloc(1, sizeof(*g) + strlen(key) + 1);
+	if (!g) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+	g->hash = hash;
+	strcpy(g->key, key);
+	g->next = groups.table[hash & (groups.size - 1)];
+	groups.table[hash & (groups.size - 1)] = g;
+	groups.count++;
+
+	return g;
+}
+
+static void group_value_add(struct group_values *v, double val)
+{
+	if (v->cnt == v->size) {
+		double *vals;
+
+		v->size = v->size ? v->size * 2 : 16;
+		vals = realloc(v->vals, v->size * sizeof(*vals));
+		if (!vals) {
+			fprintf(stderr, "ss: failed to malloc buffer\n");
+			abort();
+		}
+		v->vals = vals;
+	}
+
+	v->vals[v->cnt++] = val;
+	v->sum += val;
+}
+
+static int group_inet_sock(struct nlmsghdr *nlh, struct sockstat *s)
+{
+	struct inet_diag_msg *r = NLMSG_DATA(nlh);
+	struct rtattr *tb[INET_DIAG_MAX+1];
+	struct sock_group *g;
+	char key[512];
+
+	parse_rtattr_flags(tb, INET_DIAG_MAX, (struct rtattr *)(r+1),
+			   nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*r)),
+			   NLA_F_NESTED);
+
+	if (tb[INET_DIAG_PROTOCOL])
+		s->type = rta_getattr_u8(tb[INET_DIAG_PROTOCOL]);
+
+	group_key_build(key, sizeof(key), s);
+	g = group_get(key);
+	g->count++;
+
+	group_value_add(&g->metrics[GROUP_SENDQ], s->wq);
+	group_value_add(&g->metrics[GROUP_RECVQ], s->rq);
+
+	if (s->type == IPPROTO_TCP && tb[INET_DIAG_INFO]) {
+		struct tcp_info info = {};
+		int len = RTA_PAYLOAD(tb[INET_DIAG_INFO]);
+
+		memcpy(&info, RTA_DATA(tb[INET_DIAG_INFO]),
+		       min(len, (int)sizeof(info)));
+
+		if (info.tcpi_rtt)
+			group_value_add(&g->metrics[GROUP_RTT],
+					(double)info.tcpi_rtt / 1000);
+		if (info.tcpi_snd_cwnd)
+			group_value_add(&g->metrics[GROUP_CWND],
+					info.tcpi_snd_cwnd);
+	}
+
+	return 0;
+}
+
+static int group_value_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int group_cmp(const void *a, const void *b)
+{
+	const struct sock_group *x = *(struct sock_group * const *)a;
+	const struct sock_group *y = *(struct sock_group * const *)b;
+
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+
+	return strcmp(x->key, y->key);
+}
+
+/* Nearest-rank percentile of sorted values */
+static double group_percentile(const struct group_values *v, int p)
+{
+	unsigned int rank = (v->cnt * p + 99) / 100;
+
+	return v->vals[rank ? rank - 1 : 0];
+}
+
+static void group_values_print(const char *name, struct group_values *v)
+{
+	qsort(v->vals, v->cnt, sizeof(*v->vals), group_value_cmp);
+
+	printf(" %s:(sum:%g,min:%g,max:%g,p50:%g,p90:%g,p99:%g)",
+	       name, v->sum, v->vals[0], v->vals[v->cnt - 1],
+	       group_percentile(v, 50), group_percentile(v, 90),
+	       group_percentile(v, 99));
+}
+
+static void group_print(void)
+{
+	struct sock_group **list, *g;
+	unsigned int i, n = 0;
+	int m;
+
+	if (!groups.count)
+		return;
+
+	list = malloc(groups.count * sizeof(*list));
+	if (!list) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+
+	for (i = 0; i < groups.size; i++)
+		for (g = groups.table[i]; g; g = g->next)
+			list[n++] = g;
+
+	qsort(list, n, sizeof(*list), group_cmp);
+
+	for (i = 0; i < n; i++) {
+		g = list[i];
+
+		printf("%s count:%lu\n\t", g->key, g->count);
+		for (m = 0; m < GROUP_METRIC_MAX; m++) {
+			if (g->metrics[m].cnt)
+				group_values_print(group_metric_names[m],
+						   &g->metrics[m]);
+			free(g->metrics[m].vals);
+		}
+		printf("\n");
+		free(g);
+	}
+
+	free(list);
+	free(groups.table);
+	memset(&groups, 0, sizeof(groups));
+}
+
+static int tcpdiag_send(int fd, int protocol, struct filter *f)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	struct {
+		struct nlmsghdr nlh;
+		struct inet_diag_req r;
+	} req = {
+		.nlh.nlmsg_len = sizeof(req),
+		.nlh.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST,
+		.nlh.nlmsg_seq = MAGIC_SEQ,
+		.r.idiag_family = AF_INET,
+		.r.idiag_states = f->states,
+	};
+	char    *bc = NULL;
+	int	bclen;
+	struct msghdr msg;
+	struct rtattr rta;
+	struct iovec iov[3];
+	int iovlen = 1;
+
+	if (protocol == IPPROTO_TCP)
+		req.nlh.nlmsg_type = TCPDIAG_GETSOCK;
+	else if (protocol == IPPROTO_DCCP)
+		req.nlh.nlmsg_type = DCCPDIAG_GETSOCK;
+	else
+		return -1;
+
+	if (show_mem) {
+		req.r.idiag_ext |= (1<<(INET_DIAG_MEMINFO-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_SKMEMINFO-1));
+	}
+
+	if (show_tcpinfo || group_by_cnt || rate_interval) {
+		req.r.idiag_ext |= (1<<(INET_DIAG_INFO-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_VEGASINFO-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_CONG-1));
+	}
+
+	if (show_tos) {
+		req.r.idiag_ext |= (1<<(INET_DIAG_TOS-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_TCLASS-1));
+	}
+
+	iov[0] = (struct iovec){
+		.iov_base = &req,
+		.iov_len = sizeof(req)
+	};
+	if (f->f) {
+		bclen = ssfilter_bytecompile(f->f, &bc);
+		if (bclen) {
+			rta.rta_type = INET_DIAG_REQ_BYTECODE;
+			rta.rta_len = RTA_LENGTH(bclen);
+			iov[1] = (struct iovec){ &rta, sizeof(rta) };
+			iov[2] = (struct iovec){ bc, bclen };
+			req.nlh.nlmsg_len += RTA_LENGTH(bclen);
+			iovlen = 3;
+		}
+	}
+
+	msg = (struct msghdr) {
+		.msg_name = (void *)&nladdr,
+		.msg_namelen = sizeof(nladdr),
+		.msg_iov = iov,
+		.msg_iovlen = iovlen,
+	};
+
+	if (sendmsg(fd, &msg, 0) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int sockdiag_send(int family, int fd, int protocol, struct filter *f)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	DIAG_REQUEST(req, struct inet_diag_req_v2 r);
+	struct rtattr *bpf_rta = NULL;
+	char    *bc = NULL;
+	int	bclen;
+	__u32	proto;
+	struct msghdr msg;
+	struct rtattr rta_bc;
+	struct rtattr rta_proto;
+	struct iovec iov[6];
+	int iovlen = 1;
+
+	if (family == PF_UNSPEC)
+		return tcpdiag_send(fd, protocol, f);
+
+	memset(&req.r, 0, sizeof(req.r));
+	req.r.sdiag_family = family;
+	req.r.sdiag_protocol = protocol;
+	req.r.idiag_states = f->states;
+	if (show_mem) {
+		req.r.idiag_ext |= (1<<(INET_DIAG_MEMINFO-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_SKMEMINFO-1));
+	}
+
+	if (show_tcpinfo || group_by_cnt || rate_interval) {
+		req.r.idiag_ext |= (1<<(INET_DIAG_INFO-1));
+		req.r.idiag_ext |= (1<<(INET_DIAG_VEGASINFO-1));
 		req.r.idiag_ext |= (1<<(INET_DIAG_CONG-1));
 	}
 
@@ -4023,49 +4700,336 @@ static int kill_inet_sock(struct nlmsghdr *h, void *arg, struct sockstat *s)
 		raw->sdiag_raw_protocol = s->raw_prot;
 	}
 
-	return rtnl_talk(rth, &req.nlh, NULL);
+	return rtnl_talk(rth, &req.nlh, NULL);
+}
+
+static int show_one_inet_sock(struct nlmsghdr *h, void *arg)
+{
+	int err;
+	struct inet_diag_arg *diag_arg = arg;
+	struct inet_diag_msg *r = NLMSG_DATA(h);
+	struct sockstat s = {};
+
+	if (!(diag_arg->f->families & FAMILY_MASK(r->idiag_family)))
+		return 0;
+
+	parse_diag_msg(h, &s);
+	s.type = diag_arg->protocol;
+
+	if (diag_arg->f->f && run_ssfilter(diag_arg->f->f, &s) == 0)
+		return 0;
+
+	if (diag_arg->f->kill && kill_inet_sock(h, arg, &s) != 0) {
+		if (errno == EOPNOTSUPP || errno == ENOENT) {
+			/* Socket can't be closed, or is already closed. */
+			return 0;
+		} else {
+			perror("SOCK_DESTROY answers");
+			return -1;
+		}
+	}
+
+	if (group_by_cnt)
+		return group_inet_sock(h, &s);
+
+	err = inet_show_sock(h, &s);
+	if (err < 0)
+		return err;
+
+	return 0;
+}
+
+/* With --parallel every sock_diag dump is requested up front on its own
+ * socket and drained by a worker thread, so the kernel walks all socket
+ * tables concurrently. Records are still filtered and printed by the main
+ * thread, one dump after the other, in the usual order.
+ *
+ * A worker stops reading once DIAG_PREFETCH_MAX bytes wait for the main
+ * thread, which pauses its dump in the kernel until they are consumed.
+ */
+#define DIAG_PREFETCH_MAX	(4 << 20)
+
+struct diag_chunk {
+	struct diag_chunk	*next;
+	int			len;
+	char			buf[];
+};
+
+struct diag_prefetch {
+	struct diag_prefetch	*next;
+	int			family;
+	int			protocol;
+	struct rtnl_handle	rth;
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;	/* a chunk was queued */
+	pthread_cond_t		room;	/* a chunk was consumed */
+	struct diag_chunk	*head;
+	struct diag_chunk	**tail;
+	size_t			queued;
+	bool			done;
+	bool			stop;
+	int			err;
+};
+
+static struct diag_prefetch *diag_prefetches;
+static bool diag_prefetching;
+
+static bool diag_chunk_last(const char *buf, int len)
+{
+	const struct nlmsghdr *h = (const struct nlmsghdr *)buf;
+
+	for (; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len))
+		if (h->nlmsg_type == NLMSG_DONE || h->nlmsg_type == NLMSG_ERROR)
+			return true;
+
+	return false;
+}
+
+static void *diag_prefetch_worker(void *arg)
+{
+	struct diag_prefetch *pf = arg;
+	struct diag_chunk *c;
+	bool last = false;
+	int err = 0;
+
+	while (!last) {
+		struct sockaddr_nl nladdr;
+		socklen_t alen = sizeof(nladdr);
+		bool stop;
+		int len;
+
+		pthread_mutex_lock(&pf->lock);
+		while (pf->queued >= DIAG_PREFETCH_MAX && !pf->stop)
+			pthread_cond_wait(&pf->room, &pf->lock);
+		stop = pf->stop;
+		pthread_mutex_unlock(&pf->lock);
+		if (stop)
+			break;
+
+		/* size the chunk to the datagram, so none is truncated */
+		len = recvfrom(pf->rth.fd, NULL, 0, MSG_PEEK | MSG_TRUNC,
+			       (struct sockaddr *)&nladdr, &alen);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			err = errno;
+			break;
+		}
+		if (len == 0) {
+			err = ENODATA;
+			break;
+		}
+
+		c = malloc(sizeof(*c) + len);
+		if (!c) {
+			err = ENOMEM;
+			break;
+		}
+		c->next = NULL;
+		do {
+			c->len = recv(pf->rth.fd, c->buf, len, 0);
+		} while (c->len < 0 && (errno == EINTR || errno == EAGAIN));
+		if (c->len != len) {
+			err = c->len < 0 ? errno : EMSGSIZE;
+			free(c);
+			break;
+		}
+		if (nladdr.nl_pid != 0) {
+			free(c);
+			continue;
+		}
+		last = diag_chunk_last(c->buf, len);
+
+		pthread_mutex_lock(&pf->lock);
+		*pf->tail = c;
+		pf->tail = &c->next;
+		pf->queued += len;
+		pf->done = last;
+		pthread_cond_signal(&pf->cond);
+		pthread_mutex_unlock(&pf->lock);
+	}
+
+	if (!last) {
+		pthread_mutex_lock(&pf->lock);
+		pf->err = err;
+		pf->done = true;
+		pthread_cond_signal(&pf->cond);
+		pthread_mutex_unlock(&pf->lock);
+	}
+
+	return NULL;
+}
+
+static struct diag_prefetch *diag_prefetch_open(int family, int protocol)
+{
+	struct diag_prefetch *pf;
+
+	pf = calloc(1, sizeof(*pf));
+	if (!pf)
+		return NULL;
+
+	if (rtnl_open_byproto(&pf->rth, 0, NETLINK_SOCK_DIAG)) {
+		free(pf);
+		return NULL;
+	}
+
+	pf->rth.dump = MAGIC_SEQ;
+	pf->family = family;
+	pf->protocol = protocol;
+	pf->tail = &pf->head;
+	pthread_mutex_init(&pf->lock, NULL);
+	pthread_cond_init(&pf->cond, NULL);
+	pthread_cond_init(&pf->room, NULL);
+
+	return pf;
+}
+
+static void diag_prefetch_free(struct diag_prefetch *pf)
+{
+	struct diag_chunk *c;
+
+	while ((c = pf->head) != NULL) {
+		pf->head = c->next;
+		free(c);
+	}
+	pthread_cond_destroy(&pf->room);
+	pthread_cond_destroy(&pf->cond);
+	pthread_mutex_destroy(&pf->lock);
+	rtnl_close(&pf->rth);
+	free(pf);
+}
+
+/* The request has been sent on pf->rth, hand the replies to a worker */
+static void diag_prefetch_start(struct diag_prefetch *pf)
+{
+	struct diag_prefetch **pp = &diag_prefetches;
+
+	if (pthread_create(&pf->thread, NULL, diag_prefetch_worker, pf)) {
+		diag_prefetch_free(pf);
+		return;
+	}
+
+	while (*pp)
+		pp = &(*pp)->next;
+	*pp = pf;
+}
+
+static struct diag_prefetch *diag_prefetch_take(int family, int protocol)
+{
+	struct diag_prefetch **pp, *pf;
+
+	for (pp = &diag_prefetches; (pf = *pp) != NULL; pp = &pf->next) {
+		if (pf->family == family && pf->protocol == protocol) {
+			*pp = pf->next;
+			return pf;
+		}
+	}
+
+	return NULL;
+}
+
+static void diag_prefetch_close(struct diag_prefetch *pf)
+{
+	/* a worker that is not done yet waits for room or the kernel */
+	pthread_mutex_lock(&pf->lock);
+	pf->stop = true;
+	pthread_cond_signal(&pf->room);
+	pthread_mutex_unlock(&pf->lock);
+
+	pthread_join(pf->thread, NULL);
+	diag_prefetch_free(pf);
 }
 
-static int show_one_inet_sock(struct nlmsghdr *h, void *arg)
+static void diag_prefetch_close_all(void)
 {
-	int err;
-	struct inet_diag_arg *diag_arg = arg;
-	struct inet_diag_msg *r = NLMSG_DATA(h);
-	struct sockstat s = {};
+	struct diag_prefetch *pf;
 
-	if (!(diag_arg->f->families & FAMILY_MASK(r->idiag_family)))
-		return 0;
+	while ((pf = diag_prefetches) != NULL) {
+		diag_prefetches = pf->next;
+		diag_prefetch_close(pf);
+	}
+}
 
-	parse_diag_msg(h, &s);
-	s.type = diag_arg->protocol;
+/* Same contract as rtnl_dump_filter(), fed from the worker's queue */
+static int diag_prefetch_dump(struct diag_prefetch *pf,
+			      rtnl_filter_t filter, void *arg)
+{
+	int dump_intr = 0;
+	int ret = 0;
 
-	if (diag_arg->f->f && run_ssfilter(diag_arg->f->f, &s) == 0)
-		return 0;
+	while (!ret) {
+		struct diag_chunk *c;
+		int err;
+
+		pthread_mutex_lock(&pf->lock);
+		while (!pf->head && !pf->done)
+			pthread_cond_wait(&pf->cond, &pf->lock);
+		c = pf->head;
+		if (c) {
+			pf->head = c->next;
+			if (!pf->head)
+				pf->tail = &pf->head;
+			pf->queued -= c->len;
+			pthread_cond_signal(&pf->room);
+		}
+		err = pf->err;
+		pthread_mutex_unlock(&pf->lock);
 
-	if (diag_arg->f->kill && kill_inet_sock(h, arg, &s) != 0) {
-		if (errno == EOPNOTSUPP || errno == ENOENT) {
-			/* Socket can't be closed, or is already closed. */
-			return 0;
-		} else {
-			perror("SOCK_DESTROY answers");
-			return -1;
+		if (!c) {
+			fprintf(stderr, "netlink receive error %s (%d)\n",
+				strerror(err), err);
+			ret = -err;
+			break;
 		}
+
+		ret = rtnl_dump_filter_buf(&pf->rth, c->buf, c->len,
+					   filter, arg, &dump_intr);
+		free(c);
 	}
 
-	err = inet_show_sock(h, &s);
-	if (err < 0)
-		return err;
+	diag_prefetch_close(pf);
 
-	return 0;
+	return ret < 0 ? ret : 0;
+}
+
+static void inet_prefetch(struct filter *f, int protocol, int family)
+{
+	struct diag_prefetch *pf;
+
+	pf = diag_prefetch_open(family, protocol);
+	if (!pf)
+		return;
+
+	if (protocol > 255)
+		pf->rth.flags |= RTNL_HANDLE_F_SUPPRESS_NLERR;
+
+	/* sockdiag_send() closes the socket when it fails */
+	if (sockdiag_send(family, pf->rth.fd, protocol, f)) {
+		pf->rth.fd = -1;
+		diag_prefetch_free(pf);
+		return;
+	}
+
+	diag_prefetch_start(pf);
 }
 
 static int inet_show_netlink(struct filter *f, FILE *dump_fp, int protocol)
 {
 	int err = 0;
 	struct rtnl_handle rth, rth2;
+	struct diag_prefetch *pf;
 	int family = PF_INET;
 	struct inet_diag_arg arg = { .f = f, .protocol = protocol };
 
+	if (diag_prefetching) {
+		if (preferred_family != PF_INET6)
+			inet_prefetch(f, protocol, PF_INET);
+		if (preferred_family != PF_INET)
+			inet_prefetch(f, protocol, PF_INET6);
+		return 0;
+	}
+
 	if (rtnl_open_byproto(&rth, 0, NETLINK_SOCK_DIAG))
 		return -1;
 
@@ -4091,10 +5055,15 @@ static int inet_show_netlink(struct filter *f, FILE *dump_fp, int protocol)
 		rth.flags |= RTNL_HANDLE_F_SUPPRESS_NLERR;
 
 again:
-	if ((err = sockdiag_send(family, rth.fd, protocol, f)))
+	pf = diag_prefetch_take(family, protocol);
+	if (pf)
+		err = diag_prefetch_dump(pf, show_one_inet_sock, &arg);
+	else if ((err = sockdiag_send(family, rth.fd, protocol, f)))
 		goto Exit;
+	else
+		err = rtnl_dump_filter(&rth, show_one_inet_sock, &arg);
 
-	if ((err = rtnl_dump_filter(&rth, show_one_inet_sock, &arg))) {
+	if (err) {
 		if (family != PF_UNSPEC) {
 			family = PF_UNSPEC;
 			goto again;
@@ -4113,6 +5082,340 @@ Exit:
 	return err;
 }
 
+/* --interval: sample TCP sockets periodically and report per socket rates
+ * computed from the tcp_info counters, keyed by the socket cookie.
+ */
+enum rate_key {
+	RATE_BYTES,
+	RATE_RETRANS,
+};
+
+struct rate_ent {
+	struct rate_ent	*next;
+	struct sockstat	ss;
+	unsigned int	gen;
+	bool		valid;
+	__u64		bytes_acked;
+	__u64		bytes_received;
+	__u32		segs_out;
+	__u32		segs_in;
+	__u32		retrans;
+	double		tx_bps;
+	double		rx_bps;
+	double		segs_out_rate;
+	double		segs_in_rate;
+	double		retrans_rate;
+};
+
+#define RATE_HASH_SIZE	4096
+
+static struct {
+	struct rate_ent	*hash[RATE_HASH_SIZE];
+	unsigned int	gen;
+	double		elapsed;
+	unsigned int	count;
+} rate;
+
+static int rate_count;
+static int rate_top;
+static int rate_key = RATE_BYTES;
+
+static struct rate_ent *rate_ent_get(unsigned long long cookie)
+{
+	struct rate_ent **pp, *e;
+
+	pp = &rate.hash[(cookie ^ (cookie >> 32)) % RATE_HASH_SIZE];
+	for (e = *pp; e; e = e->next)
+		if (e->ss.sk == cookie)
+			return e;
+
+	e = calloc(1, sizeof(*e));
+	if (!e) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+	e->ss.sk = cookie;
+	e->next = *pp;
+	*pp = e;
+	rate.count++;
+
+	return e;
+}
+
+static int rate_sample_sock(struct nlmsghdr *h, void *arg)
+{
+	struct inet_diag_msg *r = NLMSG_DATA(h);
+	struct rtattr *tb[INET_DIAG_MAX+1];
+	struct filter *f = arg;
+	struct tcp_info info = {};
+	struct sockstat s = {};
+	struct rate_ent *e;
+	double secs = rate.elapsed;
+
+	if (!(f->families & FAMILY_MASK(r->idiag_family)))
+		return 0;
+
+	parse_diag_msg(h, &s);
+	s.type = IPPROTO_TCP;
+
+	if (f->f && run_ssfilter(f->f, &s) == 0)
+		return 0;
+
+	parse_rtattr(tb, INET_DIAG_MAX, (struct rtattr *)(r+1),
+		     h->nlmsg_len - NLMSG_LENGTH(sizeof(*r)));
+	if (!tb[INET_DIAG_INFO])
+		return 0;
+
+	memcpy(&info, RTA_DATA(tb[INET_DIAG_INFO]),
+	       min(RTA_PAYLOAD(tb[INET_DIAG_INFO]), sizeof(info)));
+
+	e = rate_ent_get(s.sk);
+	e->valid = e->gen && e->gen == rate.gen - 1 && secs > 0;
+	if (e->valid) {
+		e->tx_bps = (info.tcpi_bytes_acked - e->bytes_acked) * 8 / secs;
+		e->rx_bps = (info.tcpi_bytes_received - e->bytes_received) * 8 / secs;
+		e->segs_out_rate = (__u32)(info.tcpi_segs_out - e->segs_out) / secs;
+		e->segs_in_rate = (__u32)(info.tcpi_segs_in - e->segs_in) / secs;
+		e->retrans_rate = (__u32)(info.tcpi_total_retrans - e->retrans) / secs;
+	}
+
+	e->ss = s;
+	e->gen = rate.gen;
+	e->bytes_acked = info.tcpi_bytes_acked;
+	e->bytes_received = info.tcpi_bytes_received;
+	e->segs_out = info.tcpi_segs_out;
+	e->segs_in = info.tcpi_segs_in;
+	e->retrans = info.tcpi_total_retrans;
+
+	return 0;
+}
+
+static double rate_ent_key(const struct rate_ent *e)
+{
+	if (rate_key == RATE_RETRANS)
+		return e->retrans_rate;
+
+	return e->tx_bps + e->rx_bps;
+}
+
+static int rate_ent_cmp(const void *a, const void *b)
+{
+	const struct rate_ent *x = *(struct rate_ent * const *)a;
+	const struct rate_ent *y = *(struct rate_ent * const *)b;
+	double kx = rate_ent_key(x), ky = rate_ent_key(y);
+
+	if (kx != ky)
+		return kx < ky ? 1 : -1;
+
+	return x->ss.sk < y->ss.sk ? -1 : x->ss.sk > y->ss.sk;
+}
+
+/* Print the busiest sockets of this round, forget the closed ones */
+static void rate_print(void)
+{
+	struct rate_ent **list, **pp, *e;
+	unsigned int i, n = 0;
+	char b1[64], b2[64];
+
+	list = malloc((rate.count ? : 1) * sizeof(*list));
+	if (!list) {
+		fprintf(stderr, "ss: failed to malloc buffer\n");
+		abort();
+	}
+
+	for (i = 0; i < RATE_HASH_SIZE; i++) {
+		for (pp = &rate.hash[i]; (e = *pp) != NULL; ) {
+			if (e->gen != rate.gen) {
+				*pp = e->next;
+				free(e);
+				rate.count--;
+				continue;
+			}
+			if (e->valid)
+				list[n++] = e;
+			pp = &e->next;
+		}
+	}
+
+	qsort(list, n, sizeof(*list), rate_ent_cmp);
+	if (rate_top && n > rate_top)
+		n = rate_top;
+
+	if (show_header)
+		print_header();
+
+	for (i = 0; i < n; i++) {
+		e = list[i];
+
+		inet_stats_print(&e->ss, false);
+		out(" tx:%sbps rx:%sbps", sprint_bw(b1, e->tx_bps),
+		    sprint_bw(b2, e->rx_bps));
+		out(" segs_out:%.0f/s segs_in:%.0f/s retrans:%.0f/s",
+		    e->segs_out_rate, e->segs_in_rate, e->retrans_rate);
+	}
+
+	render();
+	fflush(stdout);
+	free(list);
+}
+
+static double rate_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int tcp_read_netlink_file(FILE *fp, char *buf, size_t len);
+
+/* $TCPDIAG_FILE holds one recorded dump per round, SECS apart */
+static int rate_sample_file(FILE *fp, struct filter *f)
+{
+	char buf[16384];
+	int err;
+
+	while ((err = tcp_read_netlink_file(fp, buf, sizeof(buf))) > 0)
+		rate_sample_sock((struct nlmsghdr *)buf, f);
+
+	return err;
+}
+
+static int rate_show(struct filter *f)
+{
+	const char *file = getenv("TCPDIAG_FILE");
+	struct rtnl_handle rth;
+	double last = 0, now;
+	int family, err = 0;
+	int rounds = 0;
+	FILE *fp = NULL;
+	int c;
+
+	if (file) {
+		fp = fopen(file, "r");
+		if (!fp) {
+			perror("fopen($TCPDIAG_FILE)");
+			return -1;
+		}
+	} else if (rtnl_open_byproto(&rth, 0, NETLINK_SOCK_DIAG)) {
+		return -1;
+	}
+
+	rth.dump = MAGIC_SEQ;
+
+	for (;;) {
+		if (fp) {
+			c = getc(fp);
+			if (c == EOF)
+				break;
+			ungetc(c, fp);
+
+			rate.elapsed = rate.gen ? rate_interval : 0;
+			rate.gen++;
+			err = rate_sample_file(fp, f);
+			if (err)
+				goto out;
+		} else {
+			now = rate_now();
+			rate.elapsed = last ? now - last : 0;
+			rate.gen++;
+			last = now;
+		}
+
+		for (family = PF_INET; !fp && family <= PF_INET6;
+		     family = family == PF_INET ? PF_INET6 : PF_MAX) {
+			if (preferred_family != PF_UNSPEC &&
+			    preferred_family != family)
+				continue;
+
+			/* sockdiag_send() closes the socket on failure */
+			err = sockdiag_send(family, rth.fd, IPPROTO_TCP, f);
+			if (err) {
+				perror("Cannot send dump request");
+				return err;
+			}
+			err = rtnl_dump_filter(&rth, rate_sample_sock, f);
+			if (err)
+				goto out;
+		}
+
+		/* The first round only sets the baseline */
+		if (rate.gen > 1) {
+			if (rounds)
+				printf("\n");
+			rate_print();
+			if (++rounds == rate_count)
+				break;
+		}
+
+		if (fp)
+			continue;
+
+		now = rate_interval - (rate_now() - last);
+		if (now > 0)
+			usleep(now * 1e6);
+	}
+
+out:
+	if (fp)
+		fclose(fp);
+	else
+		rtnl_close(&rth);
+	return err;
+}
+
+/* Reads the next message of a recorded dump into buf. Returns 1 for a
+ * message, 0 at the end of the dump and -1 on errors.
+ */
+static int tcp_read_netlink_file(FILE *fp, char *buf, size_t len)
+{
+	struct nlmsghdr *h = (struct nlmsghdr *)buf;
+	size_t status, nitems;
+
+	status = fread(buf, 1, sizeof(*h), fp);
+	if (status != sizeof(*h)) {
+		if (ferror(fp))
+			perror("Reading header from $TCPDIAG_FILE");
+		if (feof(fp))
+			fprintf(stderr, "Unexpected EOF reading $TCPDIAG_FILE");
+		return -1;
+	}
+
+	nitems = NLMSG_ALIGN(h->nlmsg_len - sizeof(*h));
+	if (h->nlmsg_len < sizeof(*h) || nitems > len - sizeof(*h)) {
+		fprintf(stderr, "Bad message length in $TCPDIAG_FILE\n");
+		return -1;
+	}
+	status = fread(h+1, 1, nitems, fp);
+
+	if (status != nitems) {
+		if (ferror(fp))
+			perror("Reading $TCPDIAG_FILE");
+		if (feof(fp))
+			fprintf(stderr, "Unexpected EOF reading $TCPDIAG_FILE");
+		return -1;
+	}
+
+	/* The only legal exit point */
+	if (h->nlmsg_type == NLMSG_DONE)
+		return 0;
+
+	if (h->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(h);
+
+		if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+			fprintf(stderr, "ERROR truncated\n");
+		} else {
+			errno = -err->error;
+			perror("TCPDIAG answered");
+		}
+		return -1;
+	}
+
+	return 1;
+}
+
 static int tcp_show_netlink_file(struct filter *f)
 {
 	FILE	*fp;
@@ -4126,45 +5429,12 @@ static int tcp_show_netlink_file(struct filter *f)
 
 	while (1) {
 		int err2;
-		size_t status, nitems;
 		struct nlmsghdr *h = (struct nlmsghdr *)buf;
 		struct sockstat s = {};
 
-		status = fread(buf, 1, sizeof(*h), fp);
-		if (status != sizeof(*h)) {
-			if (ferror(fp))
-				perror("Reading header from $TCPDIAG_FILE");
-			if (feof(fp))
-				fprintf(stderr, "Unexpected EOF reading $TCPDIAG_FILE");
-			break;
-		}
-
-		nitems = NLMSG_ALIGN(h->nlmsg_len - sizeof(*h));
-		status = fread(h+1, 1, nitems, fp);
-
-		if (status != nitems) {
-			if (ferror(fp))
-				perror("Reading $TCPDIAG_FILE");
-			if (feof(fp))
-				fprintf(stderr, "Unexpected EOF reading $TCPDIAG_FILE");
-			break;
-		}
-
-		/* The only legal exit point */
-		if (h->nlmsg_type == NLMSG_DONE) {
-			err = 0;
-			break;
-		}
-
-		if (h->nlmsg_type == NLMSG_ERROR) {
-			struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(h);
-
-			if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
-				fprintf(stderr, "ERROR truncated\n");
-			} else {
-				errno = -err->error;
-				perror("TCPDIAG answered");
-			}
+		err2 = tcp_read_netlink_file(fp, buf, sizeof(buf));
+		if (err2 <= 0) {
+			err = err2;
 			break;
 		}
 
@@ -4174,7 +5444,10 @@ static int tcp_show_netlink_file(struct filter *f)
 		if (f && f->f && run_ssfilter(f->f, &s) == 0)
 			continue;
 
-		err2 = inet_show_sock(h, &s);
+		if (group_by_cnt)
+			err2 = group_inet_sock(h, &s);
+		else
+			err2 = inet_show_sock(h, &s);
 		if (err2 < 0) {
 			err = err2;
 			break;
@@ -4517,9 +5790,26 @@ static int unix_show_sock(struct nlmsghdr *nlh, void *arg)
 static int handle_netlink_request(struct filter *f, struct nlmsghdr *req,
 		size_t size, rtnl_filter_t show_one_sock)
 {
+	int family = ((struct sock_diag_req *)NLMSG_DATA(req))->sdiag_family;
+	struct diag_prefetch *pf;
 	int ret = -1;
 	struct rtnl_handle rth;
 
+	if (diag_prefetching) {
+		pf = diag_prefetch_open(family, 0);
+		if (!pf)
+			return 0;
+		if (rtnl_send(&pf->rth, req, size) < 0)
+			diag_prefetch_free(pf);
+		else
+			diag_prefetch_start(pf);
+		return 0;
+	}
+
+	pf = diag_prefetch_take(family, 0);
+	if (pf)
+		return diag_prefetch_dump(pf, show_one_sock, f) ? -1 : 0;
+
 	if (rtnl_open_byproto(&rth, 0, NETLINK_SOCK_DIAG))
 		return -1;
 
@@ -5457,6 +6747,53 @@ static int tipc_show(struct filter *f)
 	return handle_netlink_request(f, &req.nlh, sizeof(req), tipc_show_sock);
 }
 
+static bool inet_prefetch_wanted(struct filter *f, int db,
+				 const char *env)
+{
+	return (f->dbs & (1 << db)) && !getenv(env) &&
+	       (filter_af_get(f, AF_INET) || filter_af_get(f, AF_INET6));
+}
+
+/* Kick off every dump main() is going to ask for, see diag_prefetch */
+static void diag_prefetch_all(struct filter *f)
+{
+	if (getenv("PROC_ROOT"))
+		return;
+
+	diag_prefetching = true;
+
+	if ((f->dbs & (1<<NETLINK_DB)) && filter_af_get(f, AF_NETLINK) &&
+	    (f->states & (1 << SS_CLOSE)) && !getenv("PROC_NET_NETLINK"))
+		netlink_show_netlink(f);
+	if ((f->dbs & PACKET_DBM) && filter_af_get(f, AF_PACKET) &&
+	    (f->states & (1 << SS_CLOSE)) && !getenv("PROC_NET_PACKET"))
+		packet_show_netlink(f);
+	if ((f->dbs & UNIX_DBM) && filter_af_get(f, AF_UNIX) &&
+	    !getenv("PROC_NET_UNIX"))
+		unix_show_netlink(f);
+	if (inet_prefetch_wanted(f, RAW_DB, "PROC_NET_RAW"))
+		inet_show_netlink(f, NULL, IPPROTO_RAW);
+	if (inet_prefetch_wanted(f, UDP_DB, "PROC_NET_UDP"))
+		inet_show_netlink(f, NULL, IPPROTO_UDP);
+	if (inet_prefetch_wanted(f, TCP_DB, "PROC_NET_TCP") &&
+	    !getenv("TCPDIAG_FILE"))
+		inet_show_netlink(f, NULL, IPPROTO_TCP);
+	if (inet_prefetch_wanted(f, DCCP_DB, "PROC_NET_DCCP"))
+		inet_show_netlink(f, NULL, IPPROTO_DCCP);
+	if (inet_prefetch_wanted(f, SCTP_DB, "PROC_NET_SCTP"))
+		inet_show_netlink(f, NULL, IPPROTO_SCTP);
+	if (f->dbs & VSOCK_DBM)
+		vsock_show(f);
+	if (f->dbs & (1<<TIPC_DB))
+		tipc_show(f);
+	if (f->dbs & (1<<XDP_DB))
+		xdp_show(f);
+	if (inet_prefetch_wanted(f, MPTCP_DB, "PROC_NET_MPTCP"))
+		inet_show_netlink(f, NULL, IPPROTO_MPTCP);
+
+	diag_prefetching = false;
+}
+
 struct sock_diag_msg {
 	__u8 sdiag_family;
 };
@@ -5742,6 +7079,13 @@ static void _usage(FILE *dest)
 "   -Q, --no-queues     Suppress sending and receiving queue columns\n"
 "   -O, --oneline       socket's data printed on a single line\n"
 "       --inet-sockopt  show various inet socket options\n"
+"       --parallel      query all socket tables concurrently\n"
+"       --first-user    with -p, show only the first process found per socket\n"
+"       --stream[=ROWS] print as sockets arrive, size columns on first ROWS\n"
+"       --group-by=KEYS summarize inet sockets per group instead of listing them\n"
+"       KEYS := {netid|state|lport|rport|remote|cgroup|process}[,KEYS]\n"
+"       --interval=SECS[,COUNT] report per socket TCP rates every SECS\n"
+"       --top=[retrans:]N  with --interval, show the N busiest sockets only\n"
 "\n"
 "   -A, --query=QUERY, --socket=QUERY\n"
 "       QUERY := {all|inet|tcp|mptcp|udp|raw|unix|unix_dgram|unix_stream|unix_seqpacket|packet|packet_raw|packet_dgram|netlink|dccp|sctp|vsock_stream|vsock_dgram|tipc|xdp}[,QUERY]\n"
@@ -5845,6 +7189,17 @@ wrong_state:
 #define OPT_BPF_MAPS 263
 #define OPT_BPF_MAP_ID 264
 
+#define OPT_PARALLEL 265
+
+#define OPT_FIRST_USER 266
+
+#define OPT_STREAM 267
+
+#define OPT_GROUP_BY 268
+
+#define OPT_INTERVAL 269
+#define OPT_TOP 270
+
 static const struct option long_opts[] = {
 	{ "numeric", 0, 0, 'n' },
 	{ "resolve", 0, 0, 'r' },
@@ -5891,6 +7246,12 @@ static const struct option long_opts[] = {
 	{ "mptcp", 0, 0, 'M' },
 	{ "oneline", 0, 0, 'O' },
 	{ "inet-sockopt", 0, 0, OPT_INET_SOCKOPT },
+	{ "parallel", 0, 0, OPT_PARALLEL },
+	{ "first-user", 0, 0, OPT_FIRST_USER },
+	{ "stream", 2, 0, OPT_STREAM },
+	{ "group-by", 1, 0, OPT_GROUP_BY },
+	{ "interval", 1, 0, OPT_INTERVAL },
+	{ "top", 1, 0, OPT_TOP },
 #ifdef ENABLE_BPF_SKSTORAGE_SUPPORT
 	{ "bpf-maps", 0, 0, OPT_BPF_MAPS},
 	{ "bpf-map-id", 1, 0, OPT_BPF_MAP_ID},
@@ -6100,6 +7461,45 @@ int main(int argc, char *argv[])
 		case 'O':
 			oneline = 1;
 			break;
+		case OPT_PARALLEL:
+			diag_parallel = 1;
+			break;
+		case OPT_FIRST_USER:
+			user_ent_first = 1;
+			break;
+		case OPT_INTERVAL:
+			if (sscanf(optarg, "%d,%d", &rate_interval,
+				   &rate_count) < 1 || rate_interval <= 0 ||
+			    rate_count < 0) {
+				fprintf(stderr, "ss: invalid interval %s\n",
+					optarg);
+				exit(-1);
+			}
+			break;
+		case OPT_TOP:
+			if (strncmp(optarg, "retrans:", 8) == 0) {
+				rate_key = RATE_RETRANS;
+				optarg += 8;
+			}
+			if (get_integer(&rate_top, optarg, 0) || rate_top <= 0) {
+				fprintf(stderr, "ss: invalid top count %s\n",
+					optarg);
+				exit(-1);
+			}
+			break;
+		case OPT_GROUP_BY:
+			if (group_by_parse(optarg))
+				exit(-1);
+			break;
+		case OPT_STREAM:
+			stream_rows = 256;
+			if (optarg && (get_integer(&stream_rows, optarg, 0) ||
+				       stream_rows <= 0)) {
+				fprintf(stderr, "ss: invalid stream window %s\n",
+					optarg);
+				exit(-1);
+			}
+			break;
 		case OPT_INET_SOCKOPT:
 			show_inet_sockopt = 1;
 			break;
@@ -6124,8 +7524,12 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (show_processes || show_threads || show_proc_ctx || show_sock_ctx)
-		user_ent_hash_build();
+	if (show_processes || show_threads || show_proc_ctx || show_sock_ctx) {
+		if (follow_events)
+			user_ent_hash_build(false);
+		else
+			user_ent_deferred = true;
+	}
 
 	argc -= optind;
 	argv += optind;
@@ -6205,6 +7609,25 @@ int main(int argc, char *argv[])
 	if (ssfilter_parse(&current_filter.f, argc, argv, filter_fp))
 		usage();
 
+	if (group_by_cnt) {
+		int i;
+
+		current_filter.dbs &= INET_DBM;
+		if (!current_filter.dbs) {
+			fprintf(stderr, "ss: --group-by only applies to inet sockets.\n");
+			exit(-1);
+		}
+		show_header = 0;
+
+		for (i = 0; i < group_by_cnt; i++) {
+			if (group_by[i] == GROUP_PROCESS && !user_ent_complete) {
+				user_ent_deferred = false;
+				user_ent_hash_build(false);
+				user_ent_complete = true;
+			}
+		}
+	}
+
 	if (!show_processes)
 		columns[COL_PROC].disabled = 1;
 
@@ -6219,6 +7642,15 @@ int main(int argc, char *argv[])
 	if (!(current_filter.states & (current_filter.states - 1)))
 		columns[COL_STATE].disabled = 1;
 
+	if (rate_interval) {
+		if (!(current_filter.dbs & (1<<TCP_DB))) {
+			fprintf(stderr, "ss: --interval only applies to TCP sockets.\n");
+			exit(-1);
+		}
+		columns[COL_NETID].disabled = 1;
+		exit(rate_show(&current_filter));
+	}
+
 	if (show_header)
 		print_header();
 
@@ -6227,6 +7659,9 @@ int main(int argc, char *argv[])
 	if (follow_events)
 		exit(handle_follow_request(&current_filter));
 
+	if (diag_parallel && !current_filter.kill)
+		diag_prefetch_all(&current_filter);
+
 	if (current_filter.dbs & (1<<NETLINK_DB))
 		netlink_show(&current_filter);
 	if (current_filter.dbs & PACKET_DBM)
@@ -6252,8 +7687,7 @@ int main(int argc, char *argv[])
 	if (current_filter.dbs & (1<<MPTCP_DB))
 		mptcp_show(&current_filter);
 
-	if (show_processes || show_threads || show_proc_ctx || show_sock_ctx)
-		user_ent_destroy();
+	diag_prefetch_close_all();
 
 #ifdef ENABLE_BPF_SKSTORAGE_SUPPORT
 	bpf_map_opts_destroy();
@@ -6261,5 +7695,12 @@ int main(int argc, char *argv[])
 
 	render();
 
+	if (group_by_cnt)
+		group_print();
+
+	if (show_processes || show_threads || show_proc_ctx || show_sock_ctx ||
+	    user_ent_complete)
+		user_ent_destroy();
+
 	return 0;
 }
@@ -18,6 +18,10 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include <linux/if.h>
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
@@ -34,10 +38,13 @@ static void explain(void)
 {
 	fprintf(stderr,
 		"Usage: ... p4 \n"
-		"                 pname PNAME [ action ACTION_SPEC ] [ classid CLASSID ]\n"
+		"                 pname PNAME [ shared ] [ action ACTION_SPEC ] [ classid CLASSID ]\n"
 		"       ACTION_SPEC := ... look at individual actions\n"
 		"\n"
-		"NOTE: CLASSID is parsed as hexadecimal input.\n");
+		"NOTE: CLASSID is parsed as hexadecimal input.\n"
+		"      With shared, the bpf action object is loaded once per pipeline\n"
+		"      and pinned, later filters reuse it. Shared filters need a prio,\n"
+		"      and \"pname PNAME shared\" on delete to drop their fields.\n");
 }
 
 static void p4tc_ebpf_cb(void *nl, int fd, const char *annotation)
@@ -73,6 +80,39 @@ struct p4tc_filter_fields {
 	__u16 prio;
 };
 
+/* Identifies a filter, the key of its fields in a shared program's map */
+struct p4tc_filter_key {
+	__u32 ifindex;	/* 0 on a shared block */
+	__u32 blockid;
+	__u32 parent;
+	__u32 chain;
+	__u32 handle;
+	__u16 prio;
+	__u16 pad;
+};
+
+struct p4tc_filter_opts {
+	struct p4tc_filter_fields fields;
+	struct p4tc_filter_key key;
+	const char *pname;
+	bool shared;
+};
+
+/* Parsed shared filter, waiting for the kernel's ACK */
+static struct p4tc_filter_opts p4_shared_opts;
+static bool p4_shared_pending;
+
+/*
+ * A shared program is pinned with its fields map under
+ * <bpffs>/tc/p4/<pname>/. It looks up its p4tc_fields map, a hash from
+ * struct p4tc_filter_key to struct p4tc_filter_fields, since every filter
+ * runs the same program and .bss can not tell them apart.
+ */
+#define P4TC_PIN_DIR		"tc/p4"
+#define P4TC_PIN_PROG		"prog"
+#define P4TC_PIN_FIELDS		"fields"
+#define P4TC_FIELDS_MAP		"p4tc_fields"
+
 #define MAX_BSS_SEC_PREFIX_LEN 8
 #define BSS_SEC_SUFFIX_LEN (strlen(".bss"))
 #define MAX_BSS_SEC_LEN (MAX_BSS_SEC_PREFIX_LEN + BSS_SEC_SUFFIX_LEN + 1)
@@ -137,9 +177,247 @@ close_bpf_obj:
 	return err;
 }
 
+static int p4tc_pin_dir(char *dir, size_t len, const char *pname,
+			bool create)
+{
+	const char *mnt = getenv(BPF_ENV_MNT) ? : BPF_DIR_MNT;
+	char *sep;
+	int ret;
+
+	ret = snprintf(dir, len, "%s/%s/%s", mnt, P4TC_PIN_DIR, pname);
+	if (ret < 0 || ret >= len || strchr(pname, '/')) {
+		fprintf(stderr, "Invalid pin directory for pipeline %s\n", pname);
+		return -1;
+	}
+	if (!create)
+		return 0;
+
+	/* create tc/, tc/p4/ and the pipeline directory under the mount */
+	for (sep = strchr(dir + strlen(mnt) + 1, '/'); sep;
+	     sep = strchr(sep + 1, '/')) {
+		*sep = 0;
+		ret = mkdir(dir, S_IRWXU);
+		*sep = '/';
+		if (ret && errno != EEXIST)
+			goto err;
+	}
+	if (mkdir(dir, S_IRWXU) && errno != EEXIST)
+		goto err;
+	return 0;
+err:
+	fprintf(stderr, "mkdir %s failed: %s\n", dir, strerror(errno));
+	return -1;
+}
+
+/*
+ * First filter of the pipeline: load the object and pin what is shared.
+ * Returns -EEXIST if another tc pinned them first.
+ */
+static int p4tc_bpf_load_pinned(struct bpf_cfg_in *cfg, const char *prog_path,
+				const char *map_path, struct nlmsghdr *n)
+{
+	struct bpf_object *bpf_obj;
+	struct bpf_map *map;
+	int err;
+
+	if (bpf_load_common_obj(cfg, &bpf_cb_ops, &bpf_obj, n) < 0 || !bpf_obj) {
+		fprintf(stderr, "Unable to load bpf object\n");
+		return -1;
+	}
+
+	map = bpf_object__find_map_by_name(bpf_obj, P4TC_FIELDS_MAP);
+	if (!map ||
+	    bpf_map__key_size(map) != sizeof(struct p4tc_filter_key) ||
+	    bpf_map__value_size(map) != sizeof(struct p4tc_filter_fields)) {
+		fprintf(stderr,
+			"Shared programs need a %s map from struct p4tc_filter_key to struct p4tc_filter_fields\n",
+			P4TC_FIELDS_MAP);
+		bpf_object__close(bpf_obj);
+		return -1;
+	}
+
+	err = bpf_obj_pin(bpf_map__fd(map), map_path);
+	if (!err) {
+		err = bpf_obj_pin(cfg->prog_fd, prog_path);
+		if (err)
+			unlink(map_path);
+	}
+	if (err) {
+		err = errno;
+		bpf_object__close(bpf_obj);
+		if (err == EEXIST)
+			return -EEXIST;
+		fprintf(stderr, "Cannot pin %s: %s\n", prog_path,
+			strerror(err));
+		return -1;
+	}
+
+	bpf_object__close(bpf_obj);
+	return 0;
+}
+
+/*
+ * Refuse to attach a pinned program that is not the one @cfg asks for.
+ * Its tag can not be known without loading the object, which is what
+ * sharing avoids, so compare the program name and type instead.
+ */
+static int p4tc_bpf_check_pinned(struct bpf_cfg_in *cfg, int prog_fd,
+				 const char *prog_path)
+{
+	struct bpf_prog_info info = {};
+	__u32 len = sizeof(info);
+	struct bpf_program *prog;
+	struct bpf_object *obj;
+	const char *name = NULL;
+	int ret = -1;
+
+	if (bpf_obj_get_info_by_fd(prog_fd, &info, &len)) {
+		fprintf(stderr, "Cannot get info of %s: %s\n", prog_path,
+			strerror(errno));
+		return -1;
+	}
+
+	obj = bpf_object__open_file(cfg->object, NULL);
+	if (libbpf_get_error(obj)) {
+		fprintf(stderr, "Cannot open bpf object %s\n", cfg->object);
+		return -1;
+	}
+
+	bpf_object__for_each_program(prog, obj) {
+		if (cfg->prog_name ?
+		    !strcmp(bpf_program__name(prog), cfg->prog_name) :
+		    !strcmp(bpf_program__section_name(prog), cfg->section)) {
+			name = bpf_program__name(prog);
+			break;
+		}
+	}
+
+	if (!name) {
+		fprintf(stderr, "object file doesn't contain %s %s\n",
+			cfg->prog_name ? "prog" : "sec",
+			cfg->prog_name ? : cfg->section);
+	} else if (info.type != cfg->type ||
+		   strncmp(info.name, name, sizeof(info.name) - 1)) {
+		fprintf(stderr,
+			"%s is program \"%s\", not \"%s\" of %s; remove the pins under %s to replace it\n",
+			prog_path, info.name, name, cfg->object,
+			dirname(strdupa(prog_path)));
+	} else {
+		ret = 0;
+	}
+
+	bpf_object__close(obj);
+	return ret;
+}
+
+/* Attempts at attaching while another tc is pinning the program */
+#define P4TC_PIN_RETRIES	10
+
+/*
+ * Use the pipeline's pinned program, loading it if this is the first
+ * filter. Returns with the program fd added to @n; this filter's fields
+ * go to the shared map in p4_commit_opt(), once the kernel has it.
+ */
+static int p4tc_bpf_shared(struct bpf_cfg_in *cfg,
+			   struct p4tc_filter_opts *opts, struct nlmsghdr *n)
+{
+	char dir[PATH_MAX], prog_path[PATH_MAX], map_path[PATH_MAX];
+	int retries = P4TC_PIN_RETRIES;
+	char annotation[256];
+	__u32 len = n->nlmsg_len;
+	int map_fd, err;
+
+	if (bpf_parse_common(cfg, &bpf_cb_ops) < 0)
+		return -1;
+	if (cfg->mode != EBPF_OBJECT) {
+		fprintf(stderr, "shared needs a bpf object file\n");
+		return -1;
+	}
+
+	if (p4tc_pin_dir(dir, sizeof(dir), opts->pname, true) < 0)
+		return -1;
+	snprintf(prog_path, sizeof(prog_path), "%s/%s", dir, P4TC_PIN_PROG);
+	snprintf(map_path, sizeof(map_path), "%s/%s", dir, P4TC_PIN_FIELDS);
+
+again:
+	cfg->prog_fd = bpf_obj_get(prog_path);
+	if (cfg->prog_fd >= 0) {
+		if (p4tc_bpf_check_pinned(cfg, cfg->prog_fd, prog_path) < 0) {
+			close(cfg->prog_fd);
+			return -1;
+		}
+		map_fd = bpf_obj_get(map_path);
+		if (map_fd < 0) {
+			fprintf(stderr, "Cannot get pinned %s: %s\n",
+				map_path, strerror(errno));
+			return -1;
+		}
+		close(map_fd);
+		snprintf(annotation, sizeof(annotation), "%s:[%s]",
+			 basename(strdupa(cfg->object)),
+			 cfg->section ? : P4TC_PIN_PROG);
+		p4tc_ebpf_cb(n, cfg->prog_fd, annotation);
+	} else if (errno == ENOENT) {
+		err = p4tc_bpf_load_pinned(cfg, prog_path, map_path, n);
+		if (err == -EEXIST && --retries) {
+			/* lost the race to pin it, use the winner's */
+			n->nlmsg_len = len;
+			usleep(1000);
+			goto again;
+		}
+		if (err < 0) {
+			if (err == -EEXIST)
+				fprintf(stderr, "Cannot get pinned %s\n",
+					prog_path);
+			return -1;
+		}
+	} else {
+		fprintf(stderr, "Cannot get pinned %s: %s\n", prog_path,
+			strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Store or drop a shared filter's fields in the pipeline's map */
+static int p4tc_bpf_shared_commit(struct p4tc_filter_opts *opts, bool del)
+{
+	char dir[PATH_MAX], map_path[PATH_MAX];
+	int map_fd, err;
+
+	if (p4tc_pin_dir(dir, sizeof(dir), opts->pname, false) < 0)
+		return -1;
+	snprintf(map_path, sizeof(map_path), "%s/%s", dir, P4TC_PIN_FIELDS);
+
+	map_fd = bpf_obj_get(map_path);
+	if (map_fd < 0) {
+		if (del && errno == ENOENT)
+			return 0;
+		fprintf(stderr, "Cannot get pinned %s: %s\n", map_path,
+			strerror(errno));
+		return -1;
+	}
+
+	if (del) {
+		err = bpf_map_delete_elem(map_fd, &opts->key);
+		if (err < 0 && errno != ENOENT)
+			fprintf(stderr, "bpf_map_delete_elem failed %d\n", err);
+		else
+			err = 0;
+	} else {
+		err = bpf_map_update_elem(map_fd, &opts->key, &opts->fields,
+					  BPF_ANY);
+		if (err < 0)
+			fprintf(stderr, "bpf_map_update_elem failed %d\n", err);
+	}
+	close(map_fd);
+	return err < 0 ? -1 : 0;
+}
+
 static int p4tc_bpf_parse_opt(struct action_util *a, int *ptr_argc,
 			      char ***ptr_argv, int tca_id,
-			      struct p4tc_filter_fields *p4tc_filter_fields,
+			      struct p4tc_filter_opts *opts,
 			      struct nlmsghdr *n)
 {
 	struct tc_act_bpf parm = {};
@@ -166,6 +444,12 @@ static int p4tc_bpf_parse_opt(struct action_util *a, int *ptr_argc,
 	cfg.argv = argv;
 	cfg.type = bpf_type;
 
+	if (opts->shared) {
+		if (p4tc_bpf_shared(&cfg, opts, n) < 0)
+			return -1;
+		goto parms;
+	}
+
 	if (bpf_parse_and_load_common_obj(&cfg, &bpf_cb_ops, &bpf_obj, n) < 0) {
 		fprintf(stderr,
 			"Unable to parse bpf command line\n");
@@ -177,10 +461,11 @@ static int p4tc_bpf_parse_opt(struct action_util *a, int *ptr_argc,
 		return -1;
 	}
 
-	err = p4tc_bpf_populate_bss_section(p4tc_filter_fields, &cfg, bpf_obj);
+	err = p4tc_bpf_populate_bss_section(&opts->fields, &cfg, bpf_obj);
 	if (err < 0)
 		return err;
 
+parms:
 	argc = cfg.argc;
 	argv = cfg.argv;
 
@@ -211,7 +496,7 @@ static int p4tc_bpf_parse_opt(struct action_util *a, int *ptr_argc,
 }
 
 static int p4tc_parse_action(int *argc_p, char ***argv_p, int tca_id,
-			     struct p4tc_filter_fields *p4tc_filter_fields,
+			     struct p4tc_filter_opts *opts,
 			     struct nlmsghdr *n)
 {
 	int argc = *argc_p;
@@ -282,7 +567,7 @@ static int p4tc_parse_action(int *argc_p, char ***argv_p, int tca_id,
 			if (strcmp(a->id, "bpf") == 0)
 				ret = p4tc_bpf_parse_opt(a, &argc, &argv,
 							 TCA_ACT_OPTIONS | NLA_F_NESTED,
-							 p4tc_filter_fields, n);
+							 opts, n);
 			else
 				ret = a->parse_aopt(a, &argc, &argv,
 						    TCA_ACT_OPTIONS | NLA_F_NESTED,
@@ -378,7 +663,7 @@ bad_val:
 }
 
 static int p4_parse_prog_opt(int *argc_p, char ***argv_p,
-			     struct p4tc_filter_fields *p4tc_filter_fields,
+			     struct p4tc_filter_opts *opts,
 			     struct nlmsghdr *n)
 {
 	char **argv = *argv_p;
@@ -411,7 +696,7 @@ static int p4_parse_opt(struct filter_util *qu,
 			struct tc_filter_fields *filter_fields,
 			int argc, char **argv, struct nlmsghdr *n)
 {
-	struct p4tc_filter_fields p4tc_filter_fields = {};
+	struct p4tc_filter_opts opts = {};
 	char *handle = filter_fields->handle;
 	struct tcmsg *t = NLMSG_DATA(n);
 	struct rtattr *tail;
@@ -426,11 +711,21 @@ static int p4_parse_opt(struct filter_util *qu,
 			return -1;
 		}
 	}
+	p4_shared_pending = false;
 	t->tcm_handle = h;
-	p4tc_filter_fields.classid = filter_fields->classid;
-	p4tc_filter_fields.proto = filter_fields->proto;
-	p4tc_filter_fields.prio = filter_fields->prio;
-	p4tc_filter_fields.chain = filter_fields->chain;
+	opts.fields.classid = filter_fields->classid;
+	opts.fields.proto = filter_fields->proto;
+	opts.fields.prio = filter_fields->prio;
+	opts.fields.chain = filter_fields->chain;
+	if (t->tcm_ifindex == TCM_IFINDEX_MAGIC_BLOCK)
+		opts.fields.blockid = t->tcm_block_index;
+	else
+		opts.key.ifindex = t->tcm_ifindex;
+	opts.key.blockid = opts.fields.blockid;
+	opts.key.parent = t->tcm_parent;
+	opts.key.chain = filter_fields->chain;
+	opts.key.handle = h;
+	opts.key.prio = filter_fields->prio;
 
 	if (argc == 0)
 		return 0;
@@ -448,13 +743,24 @@ static int p4_parse_opt(struct filter_util *qu,
 				return -1;
 			}
 			addattr32(n, MAX_MSG, TCA_P4_CLASSID, handle);
-			p4tc_filter_fields.handle = handle;
-			p4tc_filter_fields.classid = handle;
+			opts.fields.handle = handle;
+			opts.fields.classid = handle;
+		} else if (strcmp(*argv, "shared") == 0) {
+			opts.shared = true;
 		} else if (strcmp(*argv, "action") == 0) {
 			NEXT_ARG();
+			if (opts.shared && !pname) {
+				fprintf(stderr, "shared needs pname before action\n");
+				return -1;
+			}
+			/* otherwise the kernel picks one, and the key is wrong */
+			if (opts.shared && !opts.key.prio) {
+				fprintf(stderr, "shared needs a prio\n");
+				return -1;
+			}
 			if (p4tc_parse_action(&argc, &argv,
 					      TCA_P4_ACT | NLA_F_NESTED,
-					      &p4tc_filter_fields, n)) {
+					      &opts, n)) {
 				fprintf(stderr, "Illegal \"action\"\n");
 				return -1;
 			}
@@ -466,16 +772,16 @@ static int p4_parse_opt(struct filter_util *qu,
 			NEXT_ARG();
 
 			pname = *argv;
+			opts.pname = pname;
 			addattrstrz(n, MAX_MSG, TCA_P4_PNAME, *argv);
 			ret = p4tc_pipeline_get_id(pname, &pipeid);
 			if (ret < 0) {
 				fprintf(stderr, "Pipeline doesn't exist\n");
 				return -1;
 			}
-			p4tc_filter_fields.pipeid = pipeid;
+			opts.fields.pipeid = pipeid;
 		} else if (strcmp(*argv, "prog") == 0) {
-			if (p4_parse_prog_opt(&argc, &argv, &p4tc_filter_fields,
-					      n) < 0)
+			if (p4_parse_prog_opt(&argc, &argv, &opts, n) < 0)
 				return -1;
 		} else if (strcmp(*argv, "help") == 0) {
 			explain();
@@ -494,9 +800,28 @@ static int p4_parse_opt(struct filter_util *qu,
 		return -1;
 	}
 
+	if (opts.shared) {
+		p4_shared_opts = opts;
+		p4_shared_pending = true;
+	}
+
 	return 0;
 }
 
+/* The kernel took the filter, now its fields can be shared */
+static int p4_commit_opt(struct filter_util *qu, struct nlmsghdr *n)
+{
+	if (!p4_shared_pending)
+		return 0;
+	p4_shared_pending = false;
+
+	if (n->nlmsg_type != RTM_NEWTFILTER && n->nlmsg_type != RTM_DELTFILTER)
+		return 0;
+
+	return p4tc_bpf_shared_commit(&p4_shared_opts,
+				      n->nlmsg_type == RTM_DELTFILTER);
+}
+
 static int p4_print_opt(struct filter_util *qu, FILE *f,
 			   struct rtattr *opt, __u32 handle)
 {
@@ -534,4 +859,5 @@ struct filter_util p4_filter_util = {
 	.id = "p4",
 	.parse_fopt = p4_parse_opt,
 	.print_fopt = p4_print_opt,
+	.commit_fopt = p4_commit_opt,
 };
@@ -859,7 +859,7 @@ static int tc_action_gd(int cmd, unsigned int flags,
 		if (echo_request)
 			ret = rtnl_echo_talk(&rth, &req.n, json, print_action);
 		else
-			ret = rtnl_talk(&rth, &req.n, NULL);
+			ret = tc_talk(&req.n);
 	} else {
 		ret = rtnl_talk(&rth, &req.n, &ans);
 	}
@@ -917,7 +917,7 @@ static int tc_action_modify(int cmd, unsigned int flags,
 	if (echo_request)
 		ret = rtnl_echo_talk(&rth, &req.n, json, print_action);
 	else
-		ret = rtnl_talk(&rth, &req.n, NULL);
+		ret = tc_talk(&req.n);
 
 	if (ret < 0) {
 		fprintf(stderr, "We have an error talking to the kernel\n");
@@ -1021,7 +1021,7 @@ static int tc_act_list_or_flush(int *argc_p, char ***argv_p, int event)
 		if (echo_request)
 			ret = rtnl_echo_talk(&rth, &req.n, json, print_action);
 		else
-			ret = rtnl_talk(&rth, &req.n, NULL);
+			ret = tc_talk(&req.n);
 		if (ret < 0) {
 			fprintf(stderr, "We have an error flushing\n");
 			return 1;
@@ -174,7 +174,30 @@ p4tc_act_param_build(struct p4tc_json_actions_list *act,
 #ifdef P4TC
 int do_p4_runtime(int argc, char **argv);
 int print_p4ctrl(struct nlmsghdr *n, void *arg);
+void p4ctrl_batch_start(const char *name);
+int p4ctrl_batch_flush(void);
+bool p4ctrl_batch_failed(void);
+int p4ctrl_batch_end(void);
 #else
+static inline void p4ctrl_batch_start(const char *name)
+{
+}
+
+static inline int p4ctrl_batch_flush(void)
+{
+	return 0;
+}
+
+static inline bool p4ctrl_batch_failed(void)
+{
+	return false;
+}
+
+static inline int p4ctrl_batch_end(void)
+{
+	return 0;
+}
+
 static inline int do_p4_runtime(int argc, char **argv)
 {
 	fprintf(stderr, "Must compile with libbpf >= %s to use P4TC\n",
@@ -3,10 +3,12 @@
 #include <string.h>
 #include <limits.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "cjson_utils.h"
 #include "p4tc_json.h"
 #include "p4_types.h"
+#include "ll_map.h"
 #include <json_print.h>
 
 #define SCOPE_CB ("ControlBlock")
@@ -92,12 +94,310 @@ static void p4tc_json_free_table(struct p4tc_json_table *table)
 	}
 }
 
-void p4tc_json_free_pipeline(struct p4tc_json_pipeline *pipeline_info)
+/* Per-entry printing and parsing look up tables, actions, key fields and
+ * externs by name or id many times per dump or batch, so every pipeline
+ * model gets hash indexes over its lists once it is loaded. Lookups fall
+ * back to walking the lists when an index could not be built.
+ */
+#define P4TC_JSON_NEXT(node, next_off) \
+	(*(void **)((char *)(node) + (next_off)))
+
+/* Open addressing name -> node index. Only the first node carrying a name
+ * is kept, so lookups return what a walk of the list would have found.
+ */
+struct p4tc_json_name_idx {
+	unsigned int mask;
+	size_t name_off;
+	void *slots[];
+};
+
+/* Dense id -> node array, used when ids are reasonably compact */
+struct p4tc_json_id_idx {
+	int max_id;
+	void *slots[];
+};
+
+struct p4tc_json_table_idx {
+	struct p4tc_json_name_idx *key_fields;
+	struct p4tc_json_id_idx *key_fields_byid;
+	struct p4tc_json_name_idx *actions;
+};
+
+struct p4tc_json_pipeline_idx {
+	struct p4tc_json_name_idx *tables;
+	struct p4tc_json_id_idx *tables_byid;
+	struct p4tc_json_name_idx *actions;
+	struct p4tc_json_name_idx *externs;
+};
+
+static int p4tc_json_list_len(void *head, size_t next_off)
+{
+	int count = 0;
+
+	for (; head; head = P4TC_JSON_NEXT(head, next_off))
+		count++;
+
+	return count;
+}
+
+static struct p4tc_json_name_idx *p4tc_json_name_idx_alloc(int count,
+							   size_t name_off)
+{
+	struct p4tc_json_name_idx *idx;
+	unsigned int size = 16;
+
+	while (size < 2 * count)
+		size <<= 1;
+
+	idx = calloc(1, sizeof(*idx) + size * sizeof(idx->slots[0]));
+	if (!idx)
+		return NULL;
+
+	idx->mask = size - 1;
+	idx->name_off = name_off;
+
+	return idx;
+}
+
+static const char *p4tc_json_name_idx_name(struct p4tc_json_name_idx *idx,
+					   void *node)
+{
+	return (const char *)node + idx->name_off;
+}
+
+static void p4tc_json_name_idx_add(struct p4tc_json_name_idx *idx, void *node)
+{
+	const char *name = p4tc_json_name_idx_name(idx, node);
+	unsigned int h = namehash(name) & idx->mask;
+
+	while (idx->slots[h]) {
+		if (!strcmp(p4tc_json_name_idx_name(idx, idx->slots[h]), name))
+			return;
+		h = (h + 1) & idx->mask;
+	}
+
+	idx->slots[h] = node;
+}
+
+static void *p4tc_json_name_idx_find(struct p4tc_json_name_idx *idx,
+				     const char *name)
+{
+	unsigned int h = namehash(name) & idx->mask;
+
+	while (idx->slots[h]) {
+		if (!strcmp(p4tc_json_name_idx_name(idx, idx->slots[h]), name))
+			return idx->slots[h];
+		h = (h + 1) & idx->mask;
+	}
+
+	return NULL;
+}
+
+static struct p4tc_json_name_idx *
+p4tc_json_name_idx_build(void *head, size_t next_off, size_t name_off)
+{
+	struct p4tc_json_name_idx *idx;
+
+	idx = p4tc_json_name_idx_alloc(p4tc_json_list_len(head, next_off),
+				       name_off);
+	if (!idx)
+		return NULL;
+
+	for (; head; head = P4TC_JSON_NEXT(head, next_off))
+		p4tc_json_name_idx_add(idx, head);
+
+	return idx;
+}
+
+/* Returns NULL, without it being an error, when ids are too sparse */
+static int p4tc_json_id_idx_build(void *head, size_t next_off, size_t id_off,
+				  struct p4tc_json_id_idx **idx_p)
+{
+	int count = p4tc_json_list_len(head, next_off);
+	struct p4tc_json_id_idx *idx;
+	int max_id = 0;
+	void *node;
+
+	*idx_p = NULL;
+	for (node = head; node; node = P4TC_JSON_NEXT(node, next_off)) {
+		int id = *(int *)((char *)node + id_off);
+
+		if (id < 0 || id > 4 * count + 64)
+			return 0;
+		if (id > max_id)
+			max_id = id;
+	}
+
+	idx = calloc(1, sizeof(*idx) + (max_id + 1) * sizeof(idx->slots[0]));
+	if (!idx)
+		return -1;
+
+	idx->max_id = max_id;
+	for (node = head; node; node = P4TC_JSON_NEXT(node, next_off)) {
+		int id = *(int *)((char *)node + id_off);
+
+		if (!idx->slots[id])
+			idx->slots[id] = node;
+	}
+
+	*idx_p = idx;
+
+	return 0;
+}
+
+static void *p4tc_json_id_idx_find(struct p4tc_json_id_idx *idx, int id)
+{
+	if (id < 0 || id > idx->max_id)
+		return NULL;
+
+	return idx->slots[id];
+}
+
+static void p4tc_json_unindex_table(struct p4tc_json_table *t)
+{
+	struct p4tc_json_table_idx *idx = t->idx;
+
+	if (!idx)
+		return;
+
+	free(idx->key_fields);
+	free(idx->key_fields_byid);
+	free(idx->actions);
+	free(idx);
+	t->idx = NULL;
+}
+
+static void p4tc_json_unindex_pipeline(struct p4tc_json_pipeline *p)
+{
+	struct p4tc_json_pipeline_idx *idx = p->idx;
+	struct p4tc_json_externs_list *ext;
+	struct p4tc_json_table_list *tl;
+
+	for (tl = p->mat_tables; tl; tl = tl->next)
+		p4tc_json_unindex_table(&tl->table);
+
+	for (ext = p->externs; ext; ext = ext->next) {
+		free(ext->insts_idx);
+		ext->insts_idx = NULL;
+	}
+
+	if (!idx)
+		return;
+
+	free(idx->tables);
+	free(idx->tables_byid);
+	free(idx->actions);
+	free(idx->externs);
+	free(idx);
+	p->idx = NULL;
+}
+
+static int p4tc_json_index_table(struct p4tc_json_table *t)
+{
+	struct p4tc_json_table_idx *idx;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return -1;
+	t->idx = idx;
+
+	idx->key_fields =
+		p4tc_json_name_idx_build(t->key_fields,
+					 offsetof(struct p4tc_json_key_fields_list, next),
+					 offsetof(struct p4tc_json_key_fields_list, name));
+	idx->actions =
+		p4tc_json_name_idx_build(t->actions,
+					 offsetof(struct p4tc_json_actions_list, next),
+					 offsetof(struct p4tc_json_actions_list, name));
+	if (!idx->key_fields || !idx->actions)
+		return -1;
+
+	return p4tc_json_id_idx_build(t->key_fields,
+				      offsetof(struct p4tc_json_key_fields_list, next),
+				      offsetof(struct p4tc_json_key_fields_list, id),
+				      &idx->key_fields_byid);
+}
+
+/* Failing to index is not fatal; lookups then walk the lists as before */
+static void p4tc_json_index_pipeline(struct p4tc_json_pipeline *p)
+{
+	struct p4tc_json_pipeline_idx *idx;
+	struct p4tc_json_externs_list *ext;
+	struct p4tc_json_table_list *tl;
+	int nactions = 0;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return;
+	p->idx = idx;
+
+	idx->tables =
+		p4tc_json_name_idx_build(p->mat_tables,
+					 offsetof(struct p4tc_json_table_list, next),
+					 offsetof(struct p4tc_json_table_list, table.name));
+	idx->externs =
+		p4tc_json_name_idx_build(p->externs,
+					 offsetof(struct p4tc_json_externs_list, next),
+					 offsetof(struct p4tc_json_externs_list, name));
+	if (!idx->tables || !idx->externs)
+		goto err;
+
+	if (p4tc_json_id_idx_build(p->mat_tables,
+				   offsetof(struct p4tc_json_table_list, next),
+				   offsetof(struct p4tc_json_table_list, table.id),
+				   &idx->tables_byid) < 0)
+		goto err;
+
+	for (tl = p->mat_tables; tl; tl = tl->next) {
+		if (p4tc_json_index_table(&tl->table) < 0)
+			goto err;
+		nactions += p4tc_json_list_len(tl->table.actions,
+					       offsetof(struct p4tc_json_actions_list,
+							next));
+	}
+
+	/* Pipeline wide action lookups return the first match in table order */
+	idx->actions = p4tc_json_name_idx_alloc(nactions,
+						offsetof(struct p4tc_json_actions_list,
+							 name));
+	if (!idx->actions)
+		goto err;
+
+	for (tl = p->mat_tables; tl; tl = tl->next) {
+		struct p4tc_json_actions_list *act;
+
+		for (act = tl->table.actions; act; act = act->next)
+			p4tc_json_name_idx_add(idx->actions, act);
+	}
+
+	for (ext = p->externs; ext; ext = ext->next) {
+		ext->insts_idx =
+			p4tc_json_name_idx_build(ext->insts,
+						 offsetof(struct p4tc_json_extern_insts_list, next),
+						 offsetof(struct p4tc_json_extern_insts_list, name));
+		if (!ext->insts_idx)
+			goto err;
+	}
+
+	return;
+
+err:
+	p4tc_json_unindex_pipeline(p);
+}
+
+static void __p4tc_json_free_pipeline(struct p4tc_json_pipeline *pipeline_info)
 {
 	struct p4tc_json_externs_list *ext, *ext_tmp;
 	struct p4tc_json_table_list *mat_tables = pipeline_info->mat_tables;
 	struct p4tc_json_table_list *mat_tables_tmp;
 
+	p4tc_json_unindex_pipeline(pipeline_info);
+
+	if (pipeline_info->blob) {
+		munmap(pipeline_info->blob, pipeline_info->blob_len);
+		return;
+	}
+
 	while (mat_tables) {
 		mat_tables_tmp = mat_tables;
 		p4tc_json_free_table(&mat_tables->table);
@@ -115,6 +415,17 @@ void p4tc_json_free_pipeline(struct p4tc_json_pipeline *pipeline_info)
 	free(pipeline_info);
 }
 
+/* Drops the caller's reference on a pipeline returned by p4tc_json_import().
+ * The model itself stays cached until the introspection file changes.
+ */
+void p4tc_json_free_pipeline(struct p4tc_json_pipeline *pipeline_info)
+{
+	if (--pipeline_info->refcnt > 0)
+		return;
+
+	__p4tc_json_free_pipeline(pipeline_info);
+}
+
 __u32 p4tc_json_find_action(struct p4tc_json_actions_list *action)
 {
 	if (strncmp(action->action_scope, SCOPE_GLOBAL, P4TC_NAME_LEN) == 0)
@@ -928,6 +1239,9 @@ p4tc_json_find_table_keyfield_byid(struct p4tc_json_table *t, __u32 keyid)
 {
 	struct p4tc_json_key_fields_list *key_fields = t->key_fields;
 
+	if (t->idx && t->idx->key_fields_byid)
+		return p4tc_json_id_idx_find(t->idx->key_fields_byid, keyid);
+
 	while (key_fields) {
 		if (keyid == key_fields->id)
 			return key_fields;
@@ -998,6 +1312,9 @@ __p4tc_json_find_extern_inst(struct p4tc_json_externs_list *e,
 {
 	struct p4tc_json_extern_insts_list *iter = e->insts;
 
+	if (e->insts_idx)
+		return p4tc_json_name_idx_find(e->insts_idx, instname);
+
 	while (iter) {
 		if (!strcmp(instname, iter->name))
 			return iter;
@@ -1014,6 +1331,11 @@ p4tc_json_find_extern_inst(struct p4tc_json_pipeline *p, const char *extname,
 {
 	struct p4tc_json_externs_list *iter = p->externs;
 
+	if (p->idx) {
+		iter = p4tc_json_name_idx_find(p->idx->externs, extname);
+		return iter ? __p4tc_json_find_extern_inst(iter, instname) : NULL;
+	}
+
 	while (iter) {
 		if (!strcmp(extname, iter->name))
 			return __p4tc_json_find_extern_inst(iter, instname);
@@ -1029,6 +1351,9 @@ p4tc_json_find_extern(struct p4tc_json_pipeline *p, const char *extname)
 {
 	struct p4tc_json_externs_list *iter = p->externs;
 
+	if (p->idx)
+		return p4tc_json_name_idx_find(p->idx->externs, extname);
+
 	while (iter) {
 		if (!strcmp(extname, iter->name))
 			return iter;
@@ -1076,6 +1401,9 @@ p4tc_json_find_table_act(struct p4tc_json_table *tbl,
 {
 	struct p4tc_json_actions_list *actions = tbl->actions;
 
+	if (tbl->idx)
+		return p4tc_json_name_idx_find(tbl->idx->actions, act_name);
+
 	while (actions) {
 		if (!strcmp(act_name, actions->name))
 		    return actions;
@@ -1093,6 +1421,9 @@ p4tc_json_find_act(struct p4tc_json_pipeline *p,
 	struct p4tc_json_table_list *mat_tables = p->mat_tables;
 	struct p4tc_json_actions_list *action;
 
+	if (p->idx)
+		return p4tc_json_name_idx_find(p->idx->actions, act_name);
+
 	while (mat_tables) {
 		action = p4tc_json_find_table_act(&mat_tables->table, act_name);
 		if (action)
@@ -1111,6 +1442,10 @@ p4tc_json_find_table_keyfield(struct p4tc_json_table *t, __u32 keyid,
 {
 	struct p4tc_json_key_fields_list *key_fields = t->key_fields;
 
+	if (t->idx)
+		return p4tc_json_name_idx_find(t->idx->key_fields,
+					       key_field_name);
+
 	while (key_fields) {
 		if (!strcmp(key_field_name, key_fields->name))
 			return key_fields;
@@ -1126,6 +1461,11 @@ p4tc_json_find_table_byid(struct p4tc_json_pipeline *p, int tab_id)
 {
 	struct p4tc_json_table_list *mat_tables = p->mat_tables;
 
+	if (p->idx && p->idx->tables_byid) {
+		mat_tables = p4tc_json_id_idx_find(p->idx->tables_byid, tab_id);
+		return mat_tables ? &mat_tables->table : NULL;
+	}
+
 	while (mat_tables) {
 		if (tab_id == mat_tables->table.id)
 			return &mat_tables->table;
@@ -1141,6 +1481,11 @@ struct p4tc_json_table *p4tc_json_find_table(struct p4tc_json_pipeline *p,
 {
 	struct p4tc_json_table_list *mat_tables = p->mat_tables;
 
+	if (p->idx) {
+		mat_tables = p4tc_json_name_idx_find(p->idx->tables, tab_name);
+		return mat_tables ? &mat_tables->table : NULL;
+	}
+
 	while (mat_tables) {
 		if (!strcmp(tab_name, mat_tables->table.name))
 			return &mat_tables->table;
@@ -1193,16 +1538,11 @@ static char *get_introspection_path(void)
 	return getenv(ENV_VAR);
 }
 
-/*
- * This function parses JSON describing tables for a P4 program
- */
-struct p4tc_json_pipeline *p4tc_json_import(const char *pname)
+static struct p4tc_json_pipeline *
+p4tc_json_parse_file(const char *json_file_path, struct stat *stat_b)
 {
 	struct p4tc_json_pipeline *pipeline_info;
-	char *introspection_dir = NULL;
-	char json_file_path[PATH_MAX];
 	char *json_file_buffer;
-	struct stat stat_b;
 	size_t file_size;
 	size_t num_items;
 	cJSON *root;
@@ -1211,19 +1551,6 @@ struct p4tc_json_pipeline *p4tc_json_import(const char *pname)
 	int ret;
 	int fd;
 
-	introspection_dir = get_introspection_path();
-	if (!pname) {
-		fprintf(stderr,
-			"Must specify pipeline name for introspection\n");
-		return NULL;
-	}
-
-	if (snprintf(json_file_path, PATH_MAX, "%s/%s.json", introspection_dir,
-		     pname) >= PATH_MAX) {
-		fprintf(stderr, "Pipeline name too long\n");
-		return NULL;
-	}
-
 	file = fopen(json_file_path, "r");
 	if (file == NULL) {
 		fprintf(stderr, "XUnable to open introspection file: <%s>\n",
@@ -1234,20 +1561,24 @@ struct p4tc_json_pipeline *p4tc_json_import(const char *pname)
 	pipeline_info = calloc(1, sizeof(*pipeline_info));
 	if (!pipeline_info) {
 		fprintf(stderr, "No resources\n");
-		return NULL;
+		goto json_file_buffer_alloc_err;
 	}
 
 	fd = fileno(file);
-	fstat(fd, &stat_b);
-	file_size = stat_b.st_size + 1;
+	if (fstat(fd, stat_b) < 0) {
+		fprintf(stderr, "Unable to stat introspection file: <%s>\n",
+			json_file_path);
+		goto json_file_stat_err;
+	}
+	file_size = stat_b->st_size + 1;
 	json_file_buffer = calloc(1, file_size);
 	if (!json_file_buffer) {
 		fprintf(stderr, "Could not alloc memory for json file <%s>\n",
 			json_file_path);
-		goto json_file_buffer_alloc_err;
+		goto json_file_stat_err;
 	}
 
-	num_items = fread(json_file_buffer, stat_b.st_size, 1, file);
+	num_items = fread(json_file_buffer, stat_b->st_size, 1, file);
 	if (num_items != 1) {
 		if (ferror(file)) {
 			fprintf(stderr, "Error reading json file buffer <%s>\n",
@@ -1284,6 +1615,8 @@ struct p4tc_json_pipeline *p4tc_json_import(const char *pname)
 	free(json_file_buffer);
 	fclose(file);
 
+	pipeline_info->refcnt = 1;
+
 	return pipeline_info;
 
 json_file_parse_tables_err:
@@ -1291,11 +1624,221 @@ json_file_parse_tables_err:
 json_file_parse_err:
 json_file_fread_err:
 	free(json_file_buffer);
+json_file_stat_err:
+	free(pipeline_info);
 json_file_buffer_alloc_err:
 	fclose(file);
 	return NULL;
 }
 
+/* Parsed pipeline models are kept for the lifetime of the process, keyed by
+ * introspection file path, so that one tc invocation (or a whole -batch run)
+ * parses each pipeline description only once. The cache owns one reference
+ * on every model; an entry is dropped and reparsed when the file's inode,
+ * size or mtime no longer match what was loaded. A compiled file's entry
+ * also remembers its JSON, as editing the JSON makes the compiled file stale.
+ */
+struct p4tc_json_cache_file {
+	bool exists;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtim;
+};
+
+struct p4tc_json_cache_ent {
+	char path[PATH_MAX];
+	struct p4tc_json_cache_file file;
+	struct p4tc_json_cache_file src;
+	struct p4tc_json_pipeline *pipeline;
+	struct p4tc_json_cache_ent *next;
+};
+
+static struct p4tc_json_cache_ent *p4tc_json_cache;
+
+static void p4tc_json_cache_file_set(struct p4tc_json_cache_file *file,
+				     const struct stat *stat_b)
+{
+	file->exists = stat_b != NULL;
+	if (!stat_b)
+		return;
+
+	file->dev = stat_b->st_dev;
+	file->ino = stat_b->st_ino;
+	file->size = stat_b->st_size;
+	file->mtim = stat_b->st_mtim;
+}
+
+static bool p4tc_json_cache_file_valid(const struct p4tc_json_cache_file *file,
+				       const char *path)
+{
+	struct stat stat_b;
+
+	if (stat(path, &stat_b) < 0)
+		return !file->exists;
+
+	return file->exists &&
+	       file->dev == stat_b.st_dev && file->ino == stat_b.st_ino &&
+	       file->size == stat_b.st_size &&
+	       file->mtim.tv_sec == stat_b.st_mtim.tv_sec &&
+	       file->mtim.tv_nsec == stat_b.st_mtim.tv_nsec;
+}
+
+static void p4tc_json_cache_del(struct p4tc_json_cache_ent *ent)
+{
+	struct p4tc_json_cache_ent **pprev = &p4tc_json_cache;
+
+	while (*pprev != ent)
+		pprev = &(*pprev)->next;
+	*pprev = ent->next;
+
+	p4tc_json_free_pipeline(ent->pipeline);
+	free(ent);
+}
+
+/* Returns a referenced cached model for path if it is still current. For a
+ * compiled file, src_path is the JSON it was checked against when loaded.
+ */
+static struct p4tc_json_pipeline *p4tc_json_cache_get(const char *path,
+						      const char *src_path)
+{
+	struct p4tc_json_cache_ent *ent;
+
+	for (ent = p4tc_json_cache; ent; ent = ent->next) {
+		if (!strcmp(ent->path, path))
+			break;
+	}
+
+	if (!ent)
+		return NULL;
+
+	if (p4tc_json_cache_file_valid(&ent->file, path) &&
+	    (!src_path || p4tc_json_cache_file_valid(&ent->src, src_path))) {
+		ent->pipeline->refcnt++;
+		return ent->pipeline;
+	}
+
+	p4tc_json_cache_del(ent);
+
+	return NULL;
+}
+
+static void p4tc_json_cache_add(const char *path, const struct stat *stat_b,
+				const char *src_path,
+				struct p4tc_json_pipeline *pipeline)
+{
+	struct p4tc_json_cache_ent *ent;
+	struct stat src_stat;
+
+	/* Not being able to cache is not fatal, we just reparse next time */
+	ent = calloc(1, sizeof(*ent));
+	if (!ent)
+		return;
+
+	strcpy(ent->path, path);
+	p4tc_json_cache_file_set(&ent->file, stat_b);
+	if (src_path)
+		p4tc_json_cache_file_set(&ent->src,
+					 stat(src_path, &src_stat) == 0 ?
+					 &src_stat : NULL);
+	ent->pipeline = pipeline;
+	pipeline->refcnt++;
+
+	ent->next = p4tc_json_cache;
+	p4tc_json_cache = ent;
+}
+
+static int p4tc_json_file_paths(const char *pname, char *json_file_path,
+				char *bin_file_path)
+{
+	char *introspection_dir = get_introspection_path();
+
+	if (!pname) {
+		fprintf(stderr,
+			"Must specify pipeline name for introspection\n");
+		return -1;
+	}
+
+	if (snprintf(json_file_path, PATH_MAX, "%s/%s.json", introspection_dir,
+		     pname) >= PATH_MAX ||
+	    snprintf(bin_file_path, PATH_MAX, "%s/%s" P4TC_JSON_BIN_SUFFIX,
+		     introspection_dir, pname) >= PATH_MAX) {
+		fprintf(stderr, "Pipeline name too long\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * This function returns the model describing tables for a P4 program.
+ * A compiled introspection file (see p4tc_json_compile()) is mapped when
+ * present and current, otherwise the JSON is parsed. Either way the result
+ * is cached, and callers must release it with p4tc_json_free_pipeline().
+ */
+struct p4tc_json_pipeline *p4tc_json_import(const char *pname)
+{
+	struct p4tc_json_pipeline *pipeline_info;
+	char json_file_path[PATH_MAX];
+	char bin_file_path[PATH_MAX];
+	struct stat stat_b;
+
+	if (p4tc_json_file_paths(pname, json_file_path, bin_file_path) < 0)
+		return NULL;
+
+	pipeline_info = p4tc_json_cache_get(bin_file_path, json_file_path);
+	if (pipeline_info)
+		return pipeline_info;
+
+	pipeline_info = p4tc_json_cache_get(json_file_path, NULL);
+	if (pipeline_info)
+		return pipeline_info;
+
+	pipeline_info = p4tc_json_bin_load(bin_file_path, json_file_path,
+					   &stat_b);
+	if (pipeline_info) {
+		p4tc_json_index_pipeline(pipeline_info);
+		p4tc_json_cache_add(bin_file_path, &stat_b, json_file_path,
+				    pipeline_info);
+		return pipeline_info;
+	}
+
+	pipeline_info = p4tc_json_parse_file(json_file_path, &stat_b);
+	if (!pipeline_info)
+		return NULL;
+
+	p4tc_json_index_pipeline(pipeline_info);
+	p4tc_json_cache_add(json_file_path, &stat_b, NULL, pipeline_info);
+
+	return pipeline_info;
+}
+
+/* Compiles the JSON introspection file of pipeline pname into the binary
+ * form loaded by p4tc_json_import(). By default the result is written next
+ * to the JSON.
+ */
+int p4tc_json_compile(const char *pname, const char *out_path)
+{
+	struct p4tc_json_pipeline *pipeline_info;
+	char json_file_path[PATH_MAX];
+	char bin_file_path[PATH_MAX];
+	struct stat stat_b;
+	int ret;
+
+	if (p4tc_json_file_paths(pname, json_file_path, bin_file_path) < 0)
+		return -1;
+
+	pipeline_info = p4tc_json_parse_file(json_file_path, &stat_b);
+	if (!pipeline_info)
+		return -1;
+
+	ret = p4tc_json_bin_write(pipeline_info, &stat_b,
+				  out_path ? out_path : bin_file_path);
+	p4tc_json_free_pipeline(pipeline_info);
+
+	return ret;
+}
+
 static int json_parse_profile(cJSON *profile_cjson,
 			      struct p4tc_json_profile *profile)
 {
@@ -16,7 +16,18 @@
 		} \
 	}
 
+/* Compiled introspection files live next to the JSON as <pname>.bin */
+#define P4TC_JSON_BIN_SUFFIX ".bin"
+
+struct stat;
+
 struct p4tc_json_pipeline *p4tc_json_import(const char *pname);
+int p4tc_json_compile(const char *pname, const char *out_path);
+int p4tc_json_bin_write(struct p4tc_json_pipeline *p,
+			const struct stat *src_stat, const char *path);
+struct p4tc_json_pipeline *p4tc_json_bin_load(const char *path,
+					      const char *src_path,
+					      struct stat *stat_b);
 void p4tc_json_free_pipeline(struct p4tc_json_pipeline *pipeline_info);
 void p4tc_json_print_pipeline(struct p4tc_json_pipeline *pipeline,
 			      FILE *fp);
@@ -0,0 +1,574 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * p4tc_json_bin.c	Compiled P4TC introspection files
+ *
+ *              This program is free software; you can distribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * A compiled introspection file is the in-memory pipeline model produced by
+ * p4tc_json_import() written out as one blob. Every pointer in the model is
+ * stored as an offset from the start of the blob (0 meaning NULL), so loading
+ * is a private mmap() followed by one pass turning offsets back into
+ * pointers. No JSON is parsed and nothing is malloc()ed, but that pass
+ * writes to every page holding a pointer, so copy-on-write still gives
+ * the process its own copy of most of the mapping.
+ *
+ * The layout mirrors the structures in p4tc_json_infra.h, so the header
+ * records their sizes and a byte order marker and the blob is refused
+ * (and the JSON used instead) by any tc built with a different layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "p4tc_json.h"
+
+#define P4TC_JSON_BIN_MAGIC	"P4TCJBIN"
+#define P4TC_JSON_BIN_VERSION	1
+#define P4TC_JSON_BIN_BYTEORDER	0x01020304
+#define P4TC_JSON_BIN_ALIGN	8
+
+struct p4tc_json_bin_hdr {
+	char magic[8];
+	__u32 version;
+	__u32 byteorder;
+	__u64 blob_len;
+	/* Size and mtime of the JSON file the blob was compiled from */
+	__u64 src_size;
+	__s64 src_mtime_sec;
+	__s64 src_mtime_nsec;
+	/* Layout guard for the structures stored in the blob */
+	__u16 ptr_size;
+	__u16 sz_pipeline;
+	__u16 sz_table_list;
+	__u16 sz_key_field;
+	__u16 sz_action;
+	__u16 sz_action_data;
+	__u16 sz_extern;
+	__u16 sz_extern_inst;
+	__u16 sz_extern_inst_data;
+	__u16 pad[3];
+	__u64 pipeline_off;
+};
+
+static void p4tc_json_bin_hdr_layout(struct p4tc_json_bin_hdr *hdr)
+{
+	memcpy(hdr->magic, P4TC_JSON_BIN_MAGIC, sizeof(hdr->magic));
+	hdr->version = P4TC_JSON_BIN_VERSION;
+	hdr->byteorder = P4TC_JSON_BIN_BYTEORDER;
+	hdr->ptr_size = sizeof(void *);
+	hdr->sz_pipeline = sizeof(struct p4tc_json_pipeline);
+	hdr->sz_table_list = sizeof(struct p4tc_json_table_list);
+	hdr->sz_key_field = sizeof(struct p4tc_json_key_fields_list);
+	hdr->sz_action = sizeof(struct p4tc_json_actions_list);
+	hdr->sz_action_data = sizeof(struct p4tc_json_action_data);
+	hdr->sz_extern = sizeof(struct p4tc_json_externs_list);
+	hdr->sz_extern_inst = sizeof(struct p4tc_json_extern_insts_list);
+	hdr->sz_extern_inst_data = sizeof(struct p4tc_json_extern_insts_data);
+}
+
+struct p4tc_json_bin_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+/* Appends obj to the blob and stores its offset in *obj_off */
+static int p4tc_json_bin_put(struct p4tc_json_bin_buf *b, const void *obj,
+			     size_t sz, size_t *obj_off)
+{
+	size_t off = (b->len + P4TC_JSON_BIN_ALIGN - 1) &
+		     ~(size_t)(P4TC_JSON_BIN_ALIGN - 1);
+
+	if (off + sz > b->size) {
+		size_t size = b->size ? b->size : 4096;
+		char *data;
+
+		while (off + sz > size)
+			size *= 2;
+
+		data = realloc(b->data, size);
+		if (!data) {
+			fprintf(stderr, "No resources to compile pipeline\n");
+			return -1;
+		}
+
+		memset(data + b->size, 0, size - b->size);
+		b->data = data;
+		b->size = size;
+	}
+
+	memcpy(b->data + off, obj, sz);
+	b->len = off + sz;
+	*obj_off = off;
+
+	return 0;
+}
+
+static void p4tc_json_bin_set(struct p4tc_json_bin_buf *b, size_t field_off,
+			      size_t val)
+{
+	uintptr_t v = val;
+
+	memcpy(b->data + field_off, &v, sizeof(v));
+}
+
+#define BIN_FIELD(node_off, type, member) \
+	((node_off) + offsetof(type, member))
+
+typedef int (*p4tc_json_bin_put_children_t)(struct p4tc_json_bin_buf *b,
+					    const void *node, size_t off);
+
+/* Writes a singly linked list whose link lives at next_off in every node and
+ * returns the offset of its head. Children of each node are written right
+ * after the node itself so every link in the blob points forward.
+ */
+static int p4tc_json_bin_put_list(struct p4tc_json_bin_buf *b,
+				  const void *head, size_t sz, size_t next_off,
+				  p4tc_json_bin_put_children_t put_children,
+				  size_t *head_off)
+{
+	size_t prev = 0;
+	const void *node;
+
+	*head_off = 0;
+	for (node = head; node;
+	     node = *(void * const *)((const char *)node + next_off)) {
+		size_t off;
+
+		if (p4tc_json_bin_put(b, node, sz, &off) < 0)
+			return -1;
+
+		p4tc_json_bin_set(b, off + next_off, 0);
+		if (prev)
+			p4tc_json_bin_set(b, prev + next_off, off);
+		else
+			*head_off = off;
+		prev = off;
+
+		if (put_children && put_children(b, node, off) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int p4tc_json_bin_put_action(struct p4tc_json_bin_buf *b,
+				    const void *node, size_t off)
+{
+	const struct p4tc_json_actions_list *act = node;
+	size_t head;
+
+	if (p4tc_json_bin_put_list(b, act->data, sizeof(*act->data),
+				   offsetof(struct p4tc_json_action_data, next),
+				   NULL, &head) < 0)
+		return -1;
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_actions_list, data),
+			  head);
+
+	return 0;
+}
+
+static int p4tc_json_bin_put_table(struct p4tc_json_bin_buf *b,
+				   const void *node, size_t off)
+{
+	const struct p4tc_json_table_list *tl = node;
+	const struct p4tc_json_table *t = &tl->table;
+	size_t head;
+
+	if (p4tc_json_bin_put_list(b, t->key_fields, sizeof(*t->key_fields),
+				   offsetof(struct p4tc_json_key_fields_list,
+					    next),
+				   NULL, &head) < 0)
+		return -1;
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_table_list,
+				       table.key_fields), head);
+
+	if (p4tc_json_bin_put_list(b, t->actions, sizeof(*t->actions),
+				   offsetof(struct p4tc_json_actions_list, next),
+				   p4tc_json_bin_put_action, &head) < 0)
+		return -1;
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_table_list,
+				       table.actions), head);
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_table_list,
+				       table.idx), 0);
+
+	return 0;
+}
+
+static int p4tc_json_bin_put_inst(struct p4tc_json_bin_buf *b,
+				  const void *node, size_t off)
+{
+	const struct p4tc_json_extern_insts_list *inst = node;
+	size_t head;
+
+	if (p4tc_json_bin_put_list(b, inst->data, sizeof(*inst->data),
+				   offsetof(struct p4tc_json_extern_insts_data,
+					    next),
+				   NULL, &head) < 0)
+		return -1;
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_extern_insts_list,
+				       data), head);
+
+	return 0;
+}
+
+static int p4tc_json_bin_put_extern(struct p4tc_json_bin_buf *b,
+				    const void *node, size_t off)
+{
+	const struct p4tc_json_externs_list *ext = node;
+	size_t head;
+
+	if (p4tc_json_bin_put_list(b, ext->insts, sizeof(*ext->insts),
+				   offsetof(struct p4tc_json_extern_insts_list,
+					    next),
+				   p4tc_json_bin_put_inst, &head) < 0)
+		return -1;
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_externs_list,
+				       insts), head);
+	p4tc_json_bin_set(b, BIN_FIELD(off, struct p4tc_json_externs_list,
+				       insts_idx), 0);
+
+	return 0;
+}
+
+static int p4tc_json_bin_write_file(const char *path, const void *data,
+				    size_t len)
+{
+	char tmp_path[PATH_MAX];
+	const char *p = data;
+	int fd;
+
+	/* Write to a temporary file and rename it into place so readers
+	 * never map a partially written blob.
+	 */
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >=
+	    sizeof(tmp_path)) {
+		fprintf(stderr, "Output path too long\n");
+		return -1;
+	}
+
+	fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create <%s>: %s\n", tmp_path,
+			strerror(errno));
+		return -1;
+	}
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to write <%s>: %s\n", tmp_path,
+				strerror(errno));
+			goto err_unlink;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	if (fchmod(fd, 0644) < 0 || close(fd) < 0) {
+		fd = -1;
+		fprintf(stderr, "Unable to finish <%s>: %s\n", tmp_path,
+			strerror(errno));
+		goto err_unlink;
+	}
+	fd = -1;
+
+	if (rename(tmp_path, path) < 0) {
+		fprintf(stderr, "Unable to rename <%s> to <%s>: %s\n",
+			tmp_path, path, strerror(errno));
+		goto err_unlink;
+	}
+
+	return 0;
+
+err_unlink:
+	if (fd >= 0)
+		close(fd);
+	unlink(tmp_path);
+	return -1;
+}
+
+int p4tc_json_bin_write(struct p4tc_json_pipeline *p,
+			const struct stat *src_stat, const char *path)
+{
+	struct p4tc_json_bin_buf b = {};
+	struct p4tc_json_bin_hdr hdr = {};
+	struct p4tc_json_pipeline *bp;
+	size_t hdr_off, pipe_off, head;
+	int ret = -1;
+
+	p4tc_json_bin_hdr_layout(&hdr);
+	hdr.src_size = src_stat->st_size;
+	hdr.src_mtime_sec = src_stat->st_mtim.tv_sec;
+	hdr.src_mtime_nsec = src_stat->st_mtim.tv_nsec;
+
+	/* The header is rewritten once the blob length is known */
+	if (p4tc_json_bin_put(&b, &hdr, sizeof(hdr), &hdr_off) < 0 ||
+	    p4tc_json_bin_put(&b, p, sizeof(*p), &pipe_off) < 0)
+		goto out;
+
+	if (p4tc_json_bin_put_list(&b, p->mat_tables, sizeof(*p->mat_tables),
+				   offsetof(struct p4tc_json_table_list, next),
+				   p4tc_json_bin_put_table, &head) < 0)
+		goto out;
+	p4tc_json_bin_set(&b, BIN_FIELD(pipe_off, struct p4tc_json_pipeline,
+					mat_tables), head);
+
+	if (p4tc_json_bin_put_list(&b, p->externs, sizeof(*p->externs),
+				   offsetof(struct p4tc_json_externs_list, next),
+				   p4tc_json_bin_put_extern, &head) < 0)
+		goto out;
+	p4tc_json_bin_set(&b, BIN_FIELD(pipe_off, struct p4tc_json_pipeline,
+					externs), head);
+
+	/* Process local state never makes it to disk */
+	bp = (struct p4tc_json_pipeline *)(b.data + pipe_off);
+	bp->refcnt = 0;
+	bp->idx = NULL;
+	bp->blob = NULL;
+	bp->blob_len = 0;
+
+	hdr.blob_len = b.len;
+	hdr.pipeline_off = pipe_off;
+	memcpy(b.data + hdr_off, &hdr, sizeof(hdr));
+
+	ret = p4tc_json_bin_write_file(path, b.data, b.len);
+
+out:
+	free(b.data);
+	return ret;
+}
+
+struct p4tc_json_bin_ctx {
+	char *base;
+	size_t len;
+};
+
+/* Turns the offset stored in *pp into a pointer. Offsets must point forward
+ * from the node holding them, which rules out cycles in corrupt blobs.
+ */
+static int p4tc_json_bin_reloc(struct p4tc_json_bin_ctx *ctx, void *pp,
+			       const void *node, size_t sz)
+{
+	size_t node_off = (const char *)node - ctx->base;
+	uintptr_t off;
+	void *ptr;
+
+	memcpy(&off, pp, sizeof(off));
+	if (!off) {
+		ptr = NULL;
+		memcpy(pp, &ptr, sizeof(ptr));
+		return 0;
+	}
+
+	if (off <= node_off || off % P4TC_JSON_BIN_ALIGN ||
+	    off > ctx->len || ctx->len - off < sz)
+		return -1;
+
+	ptr = ctx->base + off;
+	memcpy(pp, &ptr, sizeof(ptr));
+
+	return 0;
+}
+
+#define BIN_TERMINATE(s) ((s)[sizeof(s) - 1] = '\0')
+
+static int p4tc_json_bin_reloc_action(struct p4tc_json_bin_ctx *ctx,
+				      struct p4tc_json_actions_list *act)
+{
+	struct p4tc_json_action_data *data;
+
+	BIN_TERMINATE(act->name);
+	BIN_TERMINATE(act->action_scope);
+	if (p4tc_json_bin_reloc(ctx, &act->data, act, sizeof(*data)))
+		return -1;
+
+	for (data = act->data; data; data = data->next) {
+		BIN_TERMINATE(data->name);
+		BIN_TERMINATE(data->type);
+		if (p4tc_json_bin_reloc(ctx, &data->next, data, sizeof(*data)))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int p4tc_json_bin_reloc_table(struct p4tc_json_bin_ctx *ctx,
+				     struct p4tc_json_table *t)
+{
+	struct p4tc_json_key_fields_list *kf;
+	struct p4tc_json_actions_list *act;
+
+	BIN_TERMINATE(t->name);
+	t->idx = NULL;
+	if (p4tc_json_bin_reloc(ctx, &t->key_fields, t, sizeof(*kf)) ||
+	    p4tc_json_bin_reloc(ctx, &t->actions, t, sizeof(*act)))
+		return -1;
+
+	for (kf = t->key_fields; kf; kf = kf->next) {
+		BIN_TERMINATE(kf->name);
+		BIN_TERMINATE(kf->type);
+		if (p4tc_json_bin_reloc(ctx, &kf->next, kf, sizeof(*kf)))
+			return -1;
+	}
+
+	for (act = t->actions; act; act = act->next) {
+		if (p4tc_json_bin_reloc(ctx, &act->next, act, sizeof(*act)) ||
+		    p4tc_json_bin_reloc_action(ctx, act))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int p4tc_json_bin_reloc_extern(struct p4tc_json_bin_ctx *ctx,
+				      struct p4tc_json_externs_list *ext)
+{
+	struct p4tc_json_extern_insts_data *data;
+	struct p4tc_json_extern_insts_list *inst;
+
+	BIN_TERMINATE(ext->name);
+	ext->insts_idx = NULL;
+	if (p4tc_json_bin_reloc(ctx, &ext->insts, ext, sizeof(*inst)))
+		return -1;
+
+	for (inst = ext->insts; inst; inst = inst->next) {
+		BIN_TERMINATE(inst->name);
+		BIN_TERMINATE(inst->type);
+		if (p4tc_json_bin_reloc(ctx, &inst->next, inst, sizeof(*inst)) ||
+		    p4tc_json_bin_reloc(ctx, &inst->data, inst, sizeof(*data)))
+			return -1;
+
+		for (data = inst->data; data; data = data->next) {
+			BIN_TERMINATE(data->name);
+			BIN_TERMINATE(data->type);
+			if (p4tc_json_bin_reloc(ctx, &data->next, data,
+						sizeof(*data)))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int p4tc_json_bin_reloc_pipeline(struct p4tc_json_bin_ctx *ctx,
+					struct p4tc_json_pipeline *p)
+{
+	struct p4tc_json_externs_list *ext;
+	struct p4tc_json_table_list *tl;
+
+	BIN_TERMINATE(p->name);
+	p->idx = NULL;
+	if (p4tc_json_bin_reloc(ctx, &p->mat_tables, p, sizeof(*tl)) ||
+	    p4tc_json_bin_reloc(ctx, &p->externs, p, sizeof(*ext)))
+		return -1;
+
+	for (tl = p->mat_tables; tl; tl = tl->next) {
+		if (p4tc_json_bin_reloc(ctx, &tl->next, tl, sizeof(*tl)) ||
+		    p4tc_json_bin_reloc_table(ctx, &tl->table))
+			return -1;
+	}
+
+	for (ext = p->externs; ext; ext = ext->next) {
+		if (p4tc_json_bin_reloc(ctx, &ext->next, ext, sizeof(*ext)) ||
+		    p4tc_json_bin_reloc_extern(ctx, ext))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Maps the compiled introspection file at path. Returns NULL without a
+ * message when the file is missing or was compiled from a different version
+ * of src_path, so that callers can quietly fall back to the JSON.
+ */
+struct p4tc_json_pipeline *p4tc_json_bin_load(const char *path,
+					      const char *src_path,
+					      struct stat *stat_b)
+{
+	struct p4tc_json_bin_hdr layout = {};
+	struct p4tc_json_bin_hdr *hdr;
+	struct p4tc_json_bin_ctx ctx;
+	struct p4tc_json_pipeline *p;
+	struct stat src_stat;
+	void *base;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, stat_b) < 0 || stat_b->st_size < sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, stat_b->st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	ctx.base = base;
+	ctx.len = stat_b->st_size;
+	hdr = base;
+
+	p4tc_json_bin_hdr_layout(&layout);
+	if (memcmp(hdr->magic, layout.magic, sizeof(hdr->magic)) ||
+	    hdr->version != layout.version ||
+	    hdr->byteorder != layout.byteorder ||
+	    memcmp(&hdr->ptr_size, &layout.ptr_size,
+		   offsetof(struct p4tc_json_bin_hdr, pad) -
+		   offsetof(struct p4tc_json_bin_hdr, ptr_size))) {
+		fprintf(stderr,
+			"Ignoring incompatible compiled introspection file <%s>\n",
+			path);
+		goto unmap;
+	}
+
+	/* A blob older than its JSON is stale; the JSON wins */
+	if (src_path && stat(src_path, &src_stat) == 0 &&
+	    (hdr->src_size != src_stat.st_size ||
+	     hdr->src_mtime_sec != src_stat.st_mtim.tv_sec ||
+	     hdr->src_mtime_nsec != src_stat.st_mtim.tv_nsec))
+		goto unmap;
+
+	if (hdr->blob_len != ctx.len ||
+	    hdr->pipeline_off % P4TC_JSON_BIN_ALIGN ||
+	    hdr->pipeline_off < sizeof(*hdr) ||
+	    hdr->pipeline_off > ctx.len ||
+	    ctx.len - hdr->pipeline_off < sizeof(*p))
+		goto corrupt;
+
+	p = (struct p4tc_json_pipeline *)(ctx.base + hdr->pipeline_off);
+	if (p4tc_json_bin_reloc_pipeline(&ctx, p) < 0)
+		goto corrupt;
+
+	p->blob = base;
+	p->blob_len = ctx.len;
+	p->refcnt = 1;
+
+	return p;
+
+corrupt:
+	fprintf(stderr, "Ignoring corrupt compiled introspection file <%s>\n",
+		path);
+unmap:
+	munmap(base, ctx.len);
+	return NULL;
+}
@@ -3,6 +3,7 @@
 #ifndef __JSON_INFRA_H__
 #define __JSON_INFRA_H__
 #include <stdbool.h>
+#include <stddef.h>
 #include <linux/types.h>
 
 #define P4TC_NAME_LEN 256
@@ -50,6 +51,11 @@
 #define JSON_PROFILE_NAME "name"
 #define JSON_PROFILE_AGING "aging"
 
+/* Lookup indexes built by p4tc_json_import(), private to p4tc_json.c */
+struct p4tc_json_name_idx;
+struct p4tc_json_table_idx;
+struct p4tc_json_pipeline_idx;
+
 enum p4_tc_match_type {
 	P4TC_MATCH_TYPE_EXACT = 0,
 	P4TC_MATCH_TYPE_TERNARY,
@@ -110,6 +116,7 @@ struct p4tc_json_externs_list {
 	struct p4tc_json_extern_insts_list *insts;
 	struct p4tc_json_externs_list *next;
 	int insts_count;
+	struct p4tc_json_name_idx *insts_idx;
 };
 
 struct p4tc_json_table {
@@ -123,6 +130,7 @@ struct p4tc_json_table {
 	int actions_count;
 	struct p4tc_json_actions_list *actions;
 	__u16 permissions;
+	struct p4tc_json_table_idx *idx;
 };
 
 struct p4tc_json_table_list {
@@ -139,6 +147,11 @@ struct p4tc_json_pipeline {
 	int actions_count;
 	struct p4tc_json_externs_list *externs;
 	int externs_count;
+	int refcnt;
+	struct p4tc_json_pipeline_idx *idx;
+	/* Set when the model lives in a mapped compiled introspection file */
+	void *blob;
+	size_t blob_len;
 };
 
 struct p4tc_json_profile {
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
@@ -24,6 +25,7 @@
 #include <string.h>
 #include <dlfcn.h>
 #include <dirent.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #include "utils.h"
@@ -38,12 +40,15 @@ static void help_p4ctrl(void)
 {
 	fprintf(stderr,
 		"Usage: tc p4ctrl [COMMAND] PNAME/OBJTYPE/OBJPATH OBJATTRS\n"
+		"       tc p4ctrl load FILE [ update ]\n"
+		"       tc p4ctrl save PNAME/table/OBJPATH FILE\n"
 		"where:\n"
 		"\tCOMMAND := <create | update | get | delete | help>\n"
 		"\tPNAME is the pipeline name\n"
 		"\tOBJTYPE := <table | extern>\n"
 		"\tOBJPATH := path to the object, example mycontrolblock/mytable\n"
-		"\tOBJATTRS are the object specific attributes, example entry keys\n");
+		"\tOBJATTRS are the object specific attributes, example entry keys\n"
+		"\tFILE is a table entry file, \"-\" for standard input/output\n");
 }
 
 int print_p4ctrl(struct nlmsghdr *n, void *arg)
@@ -60,6 +65,368 @@ int print_p4ctrl(struct nlmsghdr *n, void *arg)
 	}
 }
 
+/*
+ * In batch mode consecutive table create/update/delete lines for the same
+ * pipeline are coalesced into one request carrying up to
+ * P4TC_MSGBATCH_SIZE entries. With -force up to P4CTRL_BATCH_WINDOW of
+ * those requests are pipelined in a single sendmsg(), with -async alone
+ * they join the tc_async request window instead.
+ */
+#define P4CTRL_BATCH_WINDOW 4
+
+struct p4ctrl_batch_msg {
+	struct {
+		struct nlmsghdr n;
+		struct p4tcmsg t;
+		char buf[MAX_MSG];
+	} req;
+	__u32 root_off;
+	__u32 len;
+	int nents;
+	int err_ent;
+	bool failed;
+	bool split;	/* send one entry per round */
+	struct tc_async_ent ents[P4TC_MSGBATCH_SIZE];
+};
+
+static struct {
+	const char *name;
+	bool active;
+	bool failed;
+	int cmd;
+	unsigned int flags;
+	__u32 pipeid;
+	char pname[P4TC_PIPELINE_NAMSIZ];
+	int nmsgs;
+	struct p4ctrl_batch_msg msgs[P4CTRL_BATCH_WINDOW];
+} p4ctrl_batch;
+
+static const char *p4ctrl_batch_errmsg;
+static __u32 p4ctrl_batch_erroff;
+
+void p4ctrl_batch_start(const char *name)
+{
+	p4ctrl_batch.name = name ? name : "-";
+	p4ctrl_batch.active = true;
+	p4ctrl_batch.failed = false;
+	p4ctrl_batch.nmsgs = 0;
+}
+
+static int p4ctrl_batch_nents(struct rtattr *root)
+{
+	struct rtattr *rta;
+	int len, n = 0;
+
+	for (rta = RTA_DATA(root), len = RTA_PAYLOAD(root); RTA_OK(rta, len);
+	     rta = RTA_NEXT(rta, len))
+		n++;
+
+	return n;
+}
+
+static bool p4ctrl_batch_ok(int cmd, unsigned int flags, int obj,
+			    struct rtattr *root)
+{
+	int nents;
+
+	if (!p4ctrl_batch.active || echo_request)
+		return false;
+	if (obj != P4TC_OBJ_RUNTIME_TABLE)
+		return false;
+	if (cmd != RTM_P4TC_CREATE && cmd != RTM_P4TC_UPDATE &&
+	    cmd != RTM_P4TC_DEL)
+		return false;
+	/* flushes must not be merged with anything else */
+	if (flags & NLM_F_ROOT)
+		return false;
+
+	nents = p4ctrl_batch_nents(root);
+
+	return nents > 0 && nents <= P4TC_MSGBATCH_SIZE;
+}
+
+static struct rtattr *p4ctrl_batch_root(struct p4ctrl_batch_msg *msg)
+{
+	return (struct rtattr *)((char *)&msg->req.n + msg->root_off);
+}
+
+static struct p4ctrl_batch_msg *p4ctrl_batch_msg_new(void)
+{
+	struct p4ctrl_batch_msg *msg;
+
+	msg = &p4ctrl_batch.msgs[p4ctrl_batch.nmsgs++];
+	memset(&msg->req, 0, sizeof(msg->req.n) + sizeof(msg->req.t));
+	msg->req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct p4tcmsg));
+	msg->req.n.nlmsg_flags = NLM_F_REQUEST | p4ctrl_batch.flags;
+	msg->req.n.nlmsg_type = p4ctrl_batch.cmd;
+	msg->req.t.pipeid = p4ctrl_batch.pipeid;
+	msg->req.t.obj = P4TC_OBJ_RUNTIME_TABLE;
+
+	if (p4ctrl_batch.pname[0])
+		addattrstrz(&msg->req.n, sizeof(msg->req), P4TC_ROOT_PNAME,
+			    p4ctrl_batch.pname);
+
+	msg->root_off = NLMSG_ALIGN(msg->req.n.nlmsg_len);
+	addattr_nest(&msg->req.n, sizeof(msg->req), P4TC_ROOT | NLA_F_NESTED);
+	msg->nents = 0;
+	msg->split = false;
+
+	return msg;
+}
+
+/* Keep only the entries from @first on, renumbering their nests */
+static void p4ctrl_batch_msg_trim(struct p4ctrl_batch_msg *msg, int first)
+{
+	char *base = (char *)&msg->req.n;
+	__u32 start = msg->ents[0].off;
+	__u32 from = msg->ents[first].off;
+	int i;
+
+	memmove(base + start, base + from, msg->req.n.nlmsg_len - from);
+	msg->req.n.nlmsg_len -= from - start;
+
+	for (i = first; i < msg->nents; i++) {
+		struct tc_async_ent *ent = &msg->ents[i - first];
+		struct rtattr *rta;
+
+		*ent = msg->ents[i];
+		ent->off -= from - start;
+		rta = (struct rtattr *)(base + ent->off);
+		rta->rta_type = (i - first + 1) | NLA_F_NESTED;
+	}
+	msg->nents -= first;
+}
+
+static int p4ctrl_batch_msg_ent(struct p4ctrl_batch_msg *msg, __u32 off)
+{
+	int i;
+
+	if (!off || off < msg->ents[0].off || off >= msg->req.n.nlmsg_len)
+		return -1;
+
+	for (i = msg->nents - 1; i >= 0; i--)
+		if (off >= msg->ents[i].off)
+			return i;
+
+	return -1;
+}
+
+static int p4ctrl_batch_extack(const char *errmsg, uint32_t off,
+			       const struct nlmsghdr *inner_nlh)
+{
+	p4ctrl_batch_errmsg = errmsg;
+	p4ctrl_batch_erroff = inner_nlh ? off : 0;
+
+	return 0;
+}
+
+static int p4ctrl_batch_err(struct nlmsghdr *h, void *arg)
+{
+	const struct nlmsgerr *err = NLMSG_DATA(h);
+	struct p4ctrl_batch_msg *msg = NULL;
+	const char *errmsg;
+	int i;
+
+	for (i = 0; i < p4ctrl_batch.nmsgs; i++) {
+		if (p4ctrl_batch.msgs[i].req.n.nlmsg_seq == err->msg.nlmsg_seq) {
+			msg = &p4ctrl_batch.msgs[i];
+			break;
+		}
+	}
+	if (!msg)
+		return 0;
+
+	p4ctrl_batch_errmsg = NULL;
+	p4ctrl_batch_erroff = 0;
+	nl_dump_ext_ack(h, p4ctrl_batch_extack);
+
+	msg->failed = true;
+	msg->err_ent = p4ctrl_batch_msg_ent(msg, p4ctrl_batch_erroff);
+
+	errmsg = p4ctrl_batch_errmsg;
+	if (errmsg && *errmsg)
+		fprintf(stderr, "Error: %s%s\n", errmsg,
+			errmsg[strlen(errmsg) - 1] == '.' ? "" : ".");
+	else
+		fprintf(stderr, "RTNETLINK answers: %s\n",
+			strerror(-err->error));
+
+	if (msg->err_ent >= 0 || msg->split)
+		fprintf(stderr, "Command failed %s:%d\n", p4ctrl_batch.name,
+			msg->ents[msg->err_ent > 0 ? msg->err_ent : 0].lineno);
+	else
+		fprintf(stderr, "Command failed %s:%d-%d\n", p4ctrl_batch.name,
+			msg->ents[0].lineno,
+			msg->ents[msg->nents - 1].lineno);
+
+	return RTNL_SUPPRESS_NLMSG_ERROR_NLERR;
+}
+
+/*
+ * Retry what the kernel did not get to after a rejected entry. Without an
+ * extack offset there is no telling how far it got, so the message is
+ * resent one entry at a time; entries it had applied already may then be
+ * rejected and reported a second time.
+ */
+static void p4ctrl_batch_requeue(void)
+{
+	int i, nmsgs = 0;
+
+	for (i = 0; i < p4ctrl_batch.nmsgs; i++) {
+		struct p4ctrl_batch_msg *msg = &p4ctrl_batch.msgs[i];
+
+		if (msg->split) {
+			/* only the first entry went out, move on to the next */
+			msg->req.n.nlmsg_len = msg->len;
+			if (msg->nents <= 1)
+				continue;
+			p4ctrl_batch_msg_trim(msg, 1);
+		} else if (!msg->failed || msg->nents <= 1) {
+			continue;
+		} else if (msg->err_ent < 0) {
+			msg->split = true;
+		} else {
+			if (msg->err_ent + 1 >= msg->nents)
+				continue;
+			p4ctrl_batch_msg_trim(msg, msg->err_ent + 1);
+		}
+
+		if (i != nmsgs)
+			memcpy(&p4ctrl_batch.msgs[nmsgs], msg, sizeof(*msg));
+		nmsgs++;
+	}
+	p4ctrl_batch.nmsgs = nmsgs;
+}
+
+int p4ctrl_batch_flush(void)
+{
+	struct iovec iov[P4CTRL_BATCH_WINDOW];
+	int ret = 0;
+	int i;
+
+	/* An -async window cannot resend the entries after a rejected one,
+	 * so with -force they take the pipelined path below, which does.
+	 */
+	if (tc_async_active() && !force) {
+		for (i = 0; i < p4ctrl_batch.nmsgs; i++) {
+			struct p4ctrl_batch_msg *msg = &p4ctrl_batch.msgs[i];
+
+			addattr_nest_end(&msg->req.n, p4ctrl_batch_root(msg));
+			if (tc_async_talk_ents(&msg->req.n, msg->ents,
+					       msg->nents) < 0) {
+				p4ctrl_batch.failed = true;
+				ret = -1;
+				break;
+			}
+		}
+		p4ctrl_batch.nmsgs = 0;
+		return ret;
+	}
+
+	while (p4ctrl_batch.nmsgs) {
+		for (i = 0; i < p4ctrl_batch.nmsgs; i++) {
+			struct p4ctrl_batch_msg *msg = &p4ctrl_batch.msgs[i];
+
+			msg->len = msg->req.n.nlmsg_len;
+			if (msg->split && msg->nents > 1)
+				msg->req.n.nlmsg_len = msg->ents[1].off;
+			addattr_nest_end(&msg->req.n, p4ctrl_batch_root(msg));
+			msg->failed = false;
+			msg->err_ent = -1;
+			iov[i].iov_base = &msg->req.n;
+			iov[i].iov_len = msg->req.n.nlmsg_len;
+		}
+
+		if (rtnl_talk_iov(&rth, iov, p4ctrl_batch.nmsgs,
+				  p4ctrl_batch_err, NULL) < 0) {
+			ret = -1;
+			p4ctrl_batch.failed = true;
+			if (!force) {
+				p4ctrl_batch.nmsgs = 0;
+				break;
+			}
+		}
+		p4ctrl_batch_requeue();
+	}
+
+	return ret;
+}
+
+bool p4ctrl_batch_failed(void)
+{
+	return p4ctrl_batch.failed;
+}
+
+int p4ctrl_batch_end(void)
+{
+	int ret = p4ctrl_batch_flush();
+
+	p4ctrl_batch.active = false;
+
+	return ret < 0 || p4ctrl_batch.failed ? -1 : 0;
+}
+
+static int p4ctrl_batch_add(int cmd, unsigned int flags, const char *pname,
+			    __u32 pipeid, struct rtattr *root)
+{
+	struct p4ctrl_batch_msg *msg = NULL;
+	int nents = p4ctrl_batch_nents(root);
+	int window = force ? P4CTRL_BATCH_WINDOW : 1;
+	struct rtattr *rta;
+	int len;
+
+	if (!pname)
+		pname = "";
+
+	if (p4ctrl_batch.nmsgs &&
+	    (p4ctrl_batch.cmd != cmd || p4ctrl_batch.flags != flags ||
+	     p4ctrl_batch.pipeid != pipeid ||
+	     strcmp(p4ctrl_batch.pname, pname) != 0)) {
+		/* the failure was reported against the queued lines, and
+		 * this entry is not queued
+		 */
+		if (p4ctrl_batch_flush() < 0 && !force)
+			return -1;
+	}
+
+	if (!p4ctrl_batch.nmsgs) {
+		if (strlen(pname) >= sizeof(p4ctrl_batch.pname)) {
+			fprintf(stderr, "Pipeline name too long\n");
+			return -1;
+		}
+		strcpy(p4ctrl_batch.pname, pname);
+		p4ctrl_batch.cmd = cmd;
+		p4ctrl_batch.flags = flags;
+		p4ctrl_batch.pipeid = pipeid;
+	} else {
+		msg = &p4ctrl_batch.msgs[p4ctrl_batch.nmsgs - 1];
+	}
+
+	if (!msg || msg->nents + nents > P4TC_MSGBATCH_SIZE ||
+	    NLMSG_ALIGN(msg->req.n.nlmsg_len) + RTA_PAYLOAD(root) >
+	    sizeof(msg->req)) {
+		if (p4ctrl_batch.nmsgs == window &&
+		    p4ctrl_batch_flush() < 0 && !force)
+			return -1;
+		msg = p4ctrl_batch_msg_new();
+	}
+
+	for (rta = RTA_DATA(root), len = RTA_PAYLOAD(root); RTA_OK(rta, len);
+	     rta = RTA_NEXT(rta, len)) {
+		struct tc_async_ent *ent = &msg->ents[msg->nents];
+
+		ent->lineno = cmdlineno;
+		ent->off = NLMSG_ALIGN(msg->req.n.nlmsg_len);
+		if (addattr_l(&msg->req.n, sizeof(msg->req),
+			      (msg->nents + 1) | NLA_F_NESTED, RTA_DATA(rta),
+			      RTA_PAYLOAD(rta)) < 0)
+			return -1;
+		msg->nents++;
+	}
+
+	return 0;
+}
+
 static int tc_table_cmd(int cmd, unsigned int flags, int *argc_p, char ***argv_p)
 {
 	char *p4tcpath[MAX_PATH_COMPONENTS] = {NULL};
@@ -140,7 +507,15 @@ static int tc_table_cmd(int cmd, unsigned int flags, int *argc_p, char ***argv_p
 	req.n.nlmsg_flags = NLM_F_REQUEST | flags,
 	addattr_nest_end(&req.n, root);
 
-	if (cmd == RTM_P4TC_GET) {
+	if (p4ctrl_batch_ok(cmd, flags, req.t.obj, root)) {
+		ret = p4ctrl_batch_add(cmd, flags,
+				       p4tcpath[PATH_TABLE_PNAME_IDX],
+				       req.t.pipeid, root);
+		if (ret < 0)
+			return -1;
+	} else if (p4ctrl_batch_flush() < 0 && !force) {
+		return -1;
+	} else if (cmd == RTM_P4TC_GET) {
 		if (flags & NLM_F_ROOT) {
 			int msg_size;
 
@@ -153,6 +528,7 @@ static int tc_table_cmd(int cmd, unsigned int flags, int *argc_p, char ***argv_p
 			}
 
 			new_json_obj(json);
+			rtnl_set_recvmmsg(&rth);
 			if (rtnl_dump_filter(&rth, print_p4ctrl, stdout) < 0) {
 				fprintf(stderr, "Dump terminated\n");
 				return -1;
@@ -176,7 +552,7 @@ static int tc_table_cmd(int cmd, unsigned int flags, int *argc_p, char ***argv_p
 			ret = rtnl_echo_talk(&rth, &req.n, json,
 					     print_p4ctrl);
 		else
-			ret = rtnl_talk(&rth, &req.n, NULL);
+			ret = tc_talk(&req.n);
 
 		if (ret < 0) {
 			fprintf(stderr, "We have an error talking to the kernel\n");
@@ -190,6 +566,466 @@ static int tc_table_cmd(int cmd, unsigned int flags, int *argc_p, char ***argv_p
 	return ret;
 }
 
+/*
+ * Table entry files hold the entries of one table in binary form:
+ * a struct p4tc_entfile_hdr followed by one record per entry. A record is
+ * a P4TC_PARAMS attribute whose payload carries the P4TC_ENTRY_* attributes
+ * of the entry (key and mask blobs, priority, actions, ...) exactly as
+ * they are sent to and dumped by the kernel, in native byte order. Loading
+ * them thus needs neither argument parsing nor introspection.
+ */
+#define P4TC_ENTFILE_MAGIC	0x45543450	/* "P4TE" */
+#define P4TC_ENTFILE_VERSION	1
+
+struct p4tc_entfile_hdr {
+	__u32 magic;
+	__u16 version;
+	__u16 hdr_len;
+	__u32 tbl_id;
+	__u32 count;	/* number of records, 0 if not known */
+	char pname[P4TC_PIPELINE_NAMSIZ];
+	char tblname[P4TC_TABLE_NAMSIZ];
+};
+
+/* Attributes of a record that make sense when (re)creating the entry */
+static bool p4ctrl_entfile_attr_ok(unsigned short type)
+{
+	switch (type & NLA_TYPE_MASK) {
+	case P4TC_ENTRY_KEY_BLOB:
+	case P4TC_ENTRY_MASK_BLOB:
+	case P4TC_ENTRY_PRIO:
+	case P4TC_ENTRY_ACT:
+	case P4TC_ENTRY_PERMISSIONS:
+	case P4TC_ENTRY_DYNAMIC:
+	case P4TC_ENTRY_AGING:
+	case P4TC_ENTRY_PROFILE_ID:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int p4ctrl_entfile_read(FILE *fp, void *buf, size_t len)
+{
+	if (fread(buf, 1, len, fp) == len)
+		return 1;
+
+	return ferror(fp) ? -1 : 0;
+}
+
+static double p4ctrl_elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void p4ctrl_print_rate(const char *file, unsigned int count,
+			      double secs)
+{
+	new_json_obj(json);
+	open_json_object(NULL);
+	print_string(PRINT_ANY, "file", "%s: ", file);
+	print_uint(PRINT_ANY, "entries", "%u entries", count);
+	print_float(PRINT_ANY, "time", " in %.3fs", secs);
+	print_float(PRINT_ANY, "rate", " (%.0f entries/s)",
+		    secs > 0 ? count / secs : 0);
+	print_nl();
+	close_json_object();
+	delete_json_obj();
+}
+
+static int p4ctrl_load_entries(FILE *fp, const struct p4tc_entfile_hdr *hdr,
+			       int cmd, unsigned int flags, unsigned int *count)
+{
+	struct {
+		struct nlmsghdr n;
+		char buf[MAX_MSG];
+	} req;
+	struct rtattr rec;
+	char *payload = NULL;
+	int ret = 0;
+
+	payload = malloc(MAX_MSG);
+	if (!payload)
+		return -1;
+
+	for (;;) {
+		struct rtattr *root, *ent, *parm, *rta;
+		int len, err;
+
+		/* an earlier entry was rejected, possibly in the background */
+		if (p4ctrl_batch_failed() && !force) {
+			ret = -1;
+			break;
+		}
+
+		err = p4ctrl_entfile_read(fp, &rec, sizeof(rec));
+		if (!err)
+			break;
+		if (err < 0 || rec.rta_len < sizeof(rec) ||
+		    RTA_ALIGN(rec.rta_len) > MAX_MSG ||
+		    (rec.rta_type & NLA_TYPE_MASK) != P4TC_PARAMS) {
+			fprintf(stderr, "Corrupted entry %u\n", *count + 1);
+			ret = -1;
+			break;
+		}
+
+		len = RTA_ALIGN(rec.rta_len) - sizeof(rec);
+		if (p4ctrl_entfile_read(fp, payload, len) <= 0) {
+			fprintf(stderr, "Truncated entry %u\n", *count + 1);
+			ret = -1;
+			break;
+		}
+
+		req.n.nlmsg_len = NLMSG_LENGTH(0);
+		root = addattr_nest(&req.n, sizeof(req), P4TC_ROOT | NLA_F_NESTED);
+		ent = addattr_nest(&req.n, sizeof(req), 1 | NLA_F_NESTED);
+		parm = addattr_nest(&req.n, sizeof(req),
+				    P4TC_PARAMS | NLA_F_NESTED);
+		addattrstrz(&req.n, sizeof(req), P4TC_ENTRY_TBLNAME,
+			    hdr->tblname);
+		len = rec.rta_len - sizeof(rec);
+		for (rta = (struct rtattr *)payload; RTA_OK(rta, len);
+		     rta = RTA_NEXT(rta, len)) {
+			if (!p4ctrl_entfile_attr_ok(rta->rta_type))
+				continue;
+			if (addattr_l(&req.n, sizeof(req), rta->rta_type,
+				      RTA_DATA(rta), RTA_PAYLOAD(rta)) < 0) {
+				ret = -1;
+				goto out;
+			}
+		}
+		addattr8(&req.n, sizeof(req), P4TC_ENTRY_WHODUNNIT,
+			 P4TC_ENTITY_TC);
+		addattr_nest_end(&req.n, parm);
+		addattr32(&req.n, sizeof(req), P4TC_PATH, hdr->tbl_id);
+		addattr_nest_end(&req.n, ent);
+		addattr_nest_end(&req.n, root);
+
+		/* failures are reported as FILE:<entry number> */
+		cmdlineno = ++(*count);
+		if (p4ctrl_batch_add(cmd, flags, hdr->pname, 0, root) < 0) {
+			ret = -1;
+			if (!force) {
+				/* this one was not even queued */
+				(*count)--;
+				break;
+			}
+		}
+	}
+
+out:
+	free(payload);
+	return ret;
+}
+
+static int p4ctrl_load(int argc, char **argv)
+{
+	unsigned int flags = NLM_F_EXCL | NLM_F_CREATE;
+	const char *saved_name = p4ctrl_batch.name;
+	bool saved_failed = p4ctrl_batch.failed;
+	bool nested = p4ctrl_batch.active;
+	int saved_lineno = cmdlineno;
+	int cmd = RTM_P4TC_CREATE;
+	struct p4tc_entfile_hdr hdr;
+	unsigned int count = 0;
+	struct timespec start;
+	const char *file;
+	double secs;
+	FILE *fp;
+	int ret;
+
+	NEXT_ARG();
+	file = *argv;
+	while (NEXT_ARG_OK()) {
+		NEXT_ARG();
+		if (matches(*argv, "update") == 0) {
+			cmd = RTM_P4TC_UPDATE;
+			flags = 0;
+		} else {
+			fprintf(stderr, "Unknown load option \"%s\"\n", *argv);
+			return -1;
+		}
+	}
+
+	if (strcmp(file, "-") == 0) {
+		fp = stdin;
+	} else {
+		fp = fopen(file, "r");
+		if (!fp) {
+			fprintf(stderr, "Cannot open %s: %s\n", file,
+				strerror(errno));
+			return -1;
+		}
+	}
+
+	if (p4ctrl_entfile_read(fp, &hdr, sizeof(hdr)) <= 0 ||
+	    hdr.magic != P4TC_ENTFILE_MAGIC ||
+	    hdr.version != P4TC_ENTFILE_VERSION ||
+	    hdr.hdr_len != sizeof(hdr)) {
+		fprintf(stderr, "%s is not a P4 table entry file\n", file);
+		ret = -1;
+		goto close;
+	}
+	hdr.pname[sizeof(hdr.pname) - 1] = '\0';
+	hdr.tblname[sizeof(hdr.tblname) - 1] = '\0';
+
+	/* whatever a batch file queued so far goes first; a failure
+	 * there was reported against the queued lines
+	 */
+	if (p4ctrl_batch_flush() < 0 && !force) {
+		ret = 0;
+		goto close;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	p4ctrl_batch_start(file);
+	ret = p4ctrl_load_entries(fp, &hdr, cmd, flags, &count);
+	if (p4ctrl_batch_end() < 0)
+		ret = -1;
+	secs = p4ctrl_elapsed(&start);
+
+	p4ctrl_print_rate(file, count, secs);
+
+	/* back to the batch file load was called from */
+	if (nested) {
+		p4ctrl_batch_start(saved_name);
+		p4ctrl_batch.failed = saved_failed;
+		cmdlineno = saved_lineno;
+	}
+
+close:
+	if (fp != stdin)
+		fclose(fp);
+	return ret;
+}
+
+struct p4ctrl_save_ctx {
+	FILE *fp;
+	struct p4tc_entfile_hdr hdr;
+	unsigned int count;
+};
+
+static bool p4ctrl_save_attr_ok(unsigned short type)
+{
+	return p4ctrl_entfile_attr_ok(type) ||
+	       (type & NLA_TYPE_MASK) == P4TC_ENTRY_TM;
+}
+
+static void p4ctrl_save_ent(struct p4ctrl_save_ctx *ctx, struct rtattr *arg)
+{
+	static const char pad[RTA_ALIGNTO];
+	struct rtattr *tb[P4TC_MAX + 1];
+	struct rtattr *rta, rec;
+	int len, total = 0;
+
+	parse_rtattr_nested(tb, P4TC_MAX, arg);
+	if (!tb[P4TC_PARAMS])
+		return;
+
+	if (tb[P4TC_PATH] && !ctx->hdr.tbl_id)
+		ctx->hdr.tbl_id = rta_getattr_u32(tb[P4TC_PATH]);
+
+	len = RTA_PAYLOAD(tb[P4TC_PARAMS]);
+	for (rta = RTA_DATA(tb[P4TC_PARAMS]); RTA_OK(rta, len);
+	     rta = RTA_NEXT(rta, len))
+		if (p4ctrl_save_attr_ok(rta->rta_type))
+			total += RTA_ALIGN(rta->rta_len);
+
+	rec.rta_type = P4TC_PARAMS | NLA_F_NESTED;
+	rec.rta_len = RTA_LENGTH(total);
+	fwrite(&rec, sizeof(rec), 1, ctx->fp);
+
+	/* the attributes go out as the kernel sent them */
+	len = RTA_PAYLOAD(tb[P4TC_PARAMS]);
+	for (rta = RTA_DATA(tb[P4TC_PARAMS]); RTA_OK(rta, len);
+	     rta = RTA_NEXT(rta, len)) {
+		if (!p4ctrl_save_attr_ok(rta->rta_type))
+			continue;
+		fwrite(rta, rta->rta_len, 1, ctx->fp);
+		fwrite(pad, RTA_ALIGN(rta->rta_len) - rta->rta_len, 1,
+		       ctx->fp);
+	}
+
+	ctx->count++;
+}
+
+static int p4ctrl_save_msg(struct nlmsghdr *n, void *arg)
+{
+	struct rtattr *ents[P4TC_MSGBATCH_SIZE + 1];
+	struct rtattr *tb[P4TC_ROOT_MAX + 1];
+	struct p4ctrl_save_ctx *ctx = arg;
+	struct p4tcmsg *t = NLMSG_DATA(n);
+	int len, i;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*t));
+	if (len < 0 || t->obj != P4TC_OBJ_RUNTIME_TABLE)
+		return 0;
+
+	parse_rtattr_flags(tb, P4TC_ROOT_MAX, P4TC_RTA(t), len, NLA_F_NESTED);
+	if (!tb[P4TC_ROOT])
+		return 0;
+
+	parse_rtattr_nested(ents, P4TC_MSGBATCH_SIZE, tb[P4TC_ROOT]);
+	for (i = 1; i < P4TC_MSGBATCH_SIZE + 1 && ents[i]; i++)
+		p4ctrl_save_ent(ctx, ents[i]);
+
+	return ferror(ctx->fp) ? -1 : 0;
+}
+
+static int p4ctrl_save(int argc, char **argv)
+{
+	char *p4tcpath[MAX_PATH_COMPONENTS] = {NULL};
+	struct p4ctrl_save_ctx ctx = {
+		.hdr = {
+			.magic = P4TC_ENTFILE_MAGIC,
+			.version = P4TC_ENTFILE_VERSION,
+			.hdr_len = sizeof(struct p4tc_entfile_hdr),
+		},
+	};
+	struct {
+		struct nlmsghdr n;
+		struct p4tcmsg t;
+		char buf[MAX_MSG];
+	} req = {
+		.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct p4tcmsg)),
+		.n.nlmsg_type = RTM_P4TC_GET,
+		.t.obj = P4TC_OBJ_RUNTIME_TABLE,
+	};
+	char tmp_path[PATH_MAX];
+	unsigned int flags = 0;
+	struct timespec start;
+	struct rtattr *root;
+	const char *file;
+	char *path;
+	int ret = 0;
+	double secs;
+	int msg_size;
+	int fd;
+
+	NEXT_ARG();
+	path = *argv;
+	NEXT_ARG();
+	file = *argv;
+	if (NEXT_ARG_OK()) {
+		fprintf(stderr, "Unknown save option \"%s\"\n", argv[1]);
+		return -1;
+	}
+
+	parse_path(path, p4tcpath, "/");
+	if (!p4tcpath[PATH_TABLE_PNAME_IDX] || !p4tcpath[PATH_TABLE_OBJ_IDX] ||
+	    get_obj_runtime_type(p4tcpath[PATH_TABLE_OBJ_IDX]) !=
+	    P4TC_OBJ_RUNTIME_TABLE || !p4tcpath[PATH_TBLNAME_IDX]) {
+		fprintf(stderr, "Expected PNAME/table/CBNAME/TBLNAME\n");
+		return -1;
+	}
+
+	if (strlen(p4tcpath[PATH_TABLE_PNAME_IDX]) >= sizeof(ctx.hdr.pname) ||
+	    concat_cb_name(ctx.hdr.tblname, p4tcpath[PATH_CBNAME_IDX],
+			   p4tcpath[PATH_TBLNAME_IDX],
+			   sizeof(ctx.hdr.tblname)) < 0) {
+		fprintf(stderr, "Pipeline or table name too long\n");
+		return -1;
+	}
+	strcpy(ctx.hdr.pname, p4tcpath[PATH_TABLE_PNAME_IDX]);
+
+	addattrstrz(&req.n, MAX_MSG, P4TC_ROOT_PNAME,
+		    p4tcpath[PATH_TABLE_PNAME_IDX]);
+	root = addattr_nest(&req.n, MAX_MSG, P4TC_ROOT | NLA_F_NESTED);
+	register_known_unprefixed_names();
+	argc = 0;
+	if (parse_table_entry(RTM_P4TC_GET, &argc, &argv, p4tcpath, &req.n,
+			      &flags) < 0)
+		return -1;
+	addattr_nest_end(&req.n, root);
+
+	if (strcmp(file, "-") == 0) {
+		ctx.fp = stdout;
+	} else {
+		/* the previous snapshot stays until this one is complete */
+		if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmpXXXXXX",
+			     file) >= sizeof(tmp_path)) {
+			fprintf(stderr, "File name too long\n");
+			return -1;
+		}
+		fd = mkstemp(tmp_path);
+		if (fd < 0) {
+			fprintf(stderr, "Cannot create %s: %s\n", tmp_path,
+				strerror(errno));
+			return -1;
+		}
+		ctx.fp = fdopen(fd, "w");
+		if (!ctx.fp || fchmod(fd, 0644) < 0) {
+			fprintf(stderr, "Cannot open %s: %s\n", tmp_path,
+				strerror(errno));
+			if (ctx.fp)
+				fclose(ctx.fp);
+			else
+				close(fd);
+			unlink(tmp_path);
+			return -1;
+		}
+	}
+	setvbuf(ctx.fp, NULL, _IOFBF, 256 * 1024);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* the entry count is filled in once known, if the file allows */
+	fwrite(&ctx.hdr, sizeof(ctx.hdr), 1, ctx.fp);
+
+	msg_size = NLMSG_ALIGN(req.n.nlmsg_len) -
+		   NLMSG_ALIGN(sizeof(struct nlmsghdr));
+	if (rtnl_dump_request(&rth, RTM_P4TC_GET, (void *)&req.t,
+			      msg_size) < 0) {
+		perror("Cannot send dump request");
+		ret = -1;
+		goto close;
+	}
+
+	rtnl_set_recvmmsg(&rth);
+	if (rtnl_dump_filter(&rth, p4ctrl_save_msg, &ctx) < 0) {
+		fprintf(stderr, "Dump terminated\n");
+		ret = -1;
+		goto close;
+	}
+
+	ctx.hdr.count = ctx.count;
+	if (ctx.fp != stdout && fseek(ctx.fp, 0, SEEK_SET) == 0)
+		fwrite(&ctx.hdr, sizeof(ctx.hdr), 1, ctx.fp);
+
+close:
+	if (fflush(ctx.fp) || ferror(ctx.fp)) {
+		fprintf(stderr, "Cannot write %s: %s\n", file, strerror(errno));
+		ret = -1;
+	}
+	if (ctx.fp != stdout) {
+		if (fclose(ctx.fp) && ret == 0) {
+			fprintf(stderr, "Cannot write %s: %s\n", file,
+				strerror(errno));
+			ret = -1;
+		}
+		if (ret == 0 && rename(tmp_path, file) < 0) {
+			fprintf(stderr, "Cannot rename %s to %s: %s\n",
+				tmp_path, file, strerror(errno));
+			ret = -1;
+		}
+		/* don't leave a partial snapshot behind */
+		if (ret < 0)
+			unlink(tmp_path);
+	}
+	if (ret < 0 || ctx.fp == stdout)
+		return ret;
+
+	secs = p4ctrl_elapsed(&start);
+	p4ctrl_print_rate(file, ctx.count, secs);
+
+	return 0;
+}
+
 int do_p4_runtime(int argc, char **argv)
 {
 	int ret = 0;
@@ -205,6 +1041,10 @@ int do_p4_runtime(int argc, char **argv)
 			ret = tc_table_cmd(RTM_P4TC_GET, 0, &argc, &argv);
 		} else if (matches(*argv, "delete") == 0) {
 			ret = tc_table_cmd(RTM_P4TC_DEL, 0, &argc, &argv);
+		} else if (matches(*argv, "load") == 0) {
+			return p4ctrl_load(argc, argv);
+		} else if (matches(*argv, "save") == 0) {
+			return p4ctrl_save(argc, argv);
 		} else {
 			help_p4ctrl();
 			return -1;
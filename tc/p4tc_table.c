@@ -35,14 +35,6 @@
 #include "p4_types.h"
 #include "p4tc_filter.h"
 
-static void parse_common(__u8 *keyblob, __u8 *maskblob,
-			 struct p4_type_value *val, __u32 *offset, size_t sz)
-{
-	memcpy((keyblob + *offset), val->value, sz);
-	memcpy((maskblob + *offset), val->mask, sz);
-	*offset += sz;
-}
-
 static void print_entry_tm(const char *prefix, FILE *f,
 			   const struct p4tc_table_entry_tm *tm)
 {
@@ -424,55 +416,168 @@ int print_table(struct nlmsghdr *n, void *arg)
 	return 0;
 }
 
-static int __parse_table_keys(struct parse_state *state, __u32 *offset,
-			      const char *argv, __u32 bitsz,
-			      struct p4_type_s *type)
+/* Everything needed to put one key field into the key/mask blobs */
+/* Widest container of the p4 types, see p4_types.c */
+#define P4TC_MAX_TYPE_BYTESZ	16
+
+struct p4tc_key_field_layout {
+	const char *name;
+	const char *type_name;
+	struct p4_type_s *type;	/* resolved on first use */
+	__u32 bitsz;
+	__u32 bytesz;
+};
+
+/* Key layout of the table entries were last parsed for. Building it takes
+ * an introspection lookup and a type resolution per key field, so it is
+ * done once and reused for every following entry of the same table, e.g.
+ * all the entries of a batch file.
+ */
+static struct p4tc_key_layout {
+	struct p4tc_json_pipeline *p;
+	char pname[P4TC_PIPELINE_NAMSIZ];
+	char tblname[P4TC_TABLE_NAMSIZ];
+	int nfields;
+	int next;	/* field expected next on the command line */
+	struct p4tc_key_field_layout *fields;
+} key_layout;
+
+static void p4tc_key_layout_reset(void)
 {
-	int bytesz = (bitsz % 8) ? bitsz / 8 + 1 : bitsz / 8;
-	__u8 *mask = calloc(1, bytesz);
-	__u8 *value = calloc(1, bytesz);
-	struct p4_type_value val;
+	if (key_layout.p)
+		p4tc_json_free_pipeline(key_layout.p);
+	free(key_layout.fields);
+	memset(&key_layout, 0, sizeof(key_layout));
+}
+
+static int p4tc_key_layout_build(const char *pname, const char *tblname,
+				 const char *full_tblname)
+{
+	struct p4tc_json_key_fields_list *key;
+	struct p4tc_key_field_layout *field;
+	struct p4tc_json_pipeline *p;
+	struct p4tc_json_table *t;
+	int i = 0;
 
-	if (!value) {
-		fprintf(stderr, "Unable to alloc value");
+	p = p4tc_json_import(pname);
+	if (!p) {
+		fprintf(stderr, "parse keys - Unable to find pipeline %s\n",
+			pname);
 		return -1;
 	}
 
-	if (!mask) {
-		fprintf(stderr, "Unable to alloc mask");
-		free(value);
+	t = p4tc_json_find_table(p, full_tblname);
+	if (!t) {
+		fprintf(stderr, "Unable to find table %s\n", tblname);
+		p4tc_json_free_pipeline(p);
+		return -1;
+	}
+
+	key_layout.fields = calloc(t->key_fields_count ? : 1,
+				   sizeof(*key_layout.fields));
+	if (!key_layout.fields) {
+		fprintf(stderr, "Unable to alloc key layout\n");
+		p4tc_json_free_pipeline(p);
 		return -1;
 	}
 
+	key = p4tc_json_table_keyfield_iter_start(t);
+	while (key && i < t->key_fields_count) {
+		field = &key_layout.fields[i++];
+		field->name = key->name;
+		field->type_name = key->type;
+		key = p4tc_json_table_keyfield_next(key);
+	}
+
+	key_layout.p = p;
+	key_layout.nfields = i;
+	strlcpy(key_layout.pname, pname, sizeof(key_layout.pname));
+	strlcpy(key_layout.tblname, full_tblname, sizeof(key_layout.tblname));
+
+	return 0;
+}
+
+static struct p4tc_key_field_layout *
+p4tc_key_layout_find(const char *pname, char **p4tcpath, const char *keyname)
+{
+	const char *tblname = p4tcpath[PATH_TBLNAME_IDX];
+	const char *cbname = p4tcpath[PATH_CBNAME_IDX];
+	char full_tblname[P4TC_TABLE_NAMSIZ] = {0};
+	struct p4tc_key_field_layout *field;
+	int i;
+
+	if (concat_cb_name(full_tblname, cbname, tblname,
+			   P4TC_TABLE_NAMSIZ) < 0) {
+		fprintf(stderr, "Table name to long %s/%s\n", cbname, tblname);
+		return NULL;
+	}
+
+	if (!key_layout.p || strcmp(key_layout.pname, pname) ||
+	    strcmp(key_layout.tblname, full_tblname)) {
+		p4tc_key_layout_reset();
+		if (p4tc_key_layout_build(pname, tblname, full_tblname) < 0)
+			return NULL;
+	}
+
+	/* keys are usually given in the same order for every entry */
+	for (i = 0; i < key_layout.nfields; i++) {
+		int n = (key_layout.next + i) % key_layout.nfields;
+
+		field = &key_layout.fields[n];
+		if (!strcmp(field->name, keyname)) {
+			key_layout.next = (n + 1) % key_layout.nfields;
+			return field;
+		}
+	}
+
+	fprintf(stderr, "Unable to find key field %s in introspection file\n",
+		keyname);
+	return NULL;
+}
+
+static int __parse_table_keys(struct parse_state *state, __u32 *offset,
+			      const char *argv,
+			      const struct p4tc_key_field_layout *field)
+{
+	/* Type parsers store their whole container type, which may be wider
+	 * than the field and is not aligned within the blobs, so parse into
+	 * aligned scratch space and copy only the field's bytes.
+	 */
+	__u64 value[P4TC_MAX_TYPE_BYTESZ / sizeof(__u64)] = {};
+	__u64 mask[P4TC_MAX_TYPE_BYTESZ / sizeof(__u64)] = {};
+	struct p4_type_s *type = field->type;
+	__u32 bytesz = field->bytesz;
+	struct p4_type_value val;
+
 	if (!type->parse_p4t) {
 		fprintf(stderr, "Type has no parse function\n");
-		free(value);
-		free(mask);
+		return -1;
+	}
+
+	if (bytesz > sizeof(value) || type->bitsz > sizeof(value) * 8) {
+		fprintf(stderr, "Key field %s too large\n", field->name);
+		return -1;
+	}
+
+	if (*offset + bytesz > sizeof(state->keyblob)) {
+		fprintf(stderr, "Key blob too large\n");
 		return -1;
 	}
 
 	val.value = value;
 	val.mask = mask;
-	val.bitsz = bitsz ? bitsz : type->bitsz;
+	val.bitsz = field->bitsz ? field->bitsz : type->bitsz;
 	if (type->parse_p4t(&val, argv, 0) < 0) {
 		fprintf(stderr, "Failed to parse %s\n", argv);
-		free(value);
-		free(mask);
 		return -1;
 	}
 
-	if (!(type->flags & P4TC_T_TYPE_HAS_MASK)) {
-		int i;
-
-		for (i = 0; i < bytesz; i++)
-			mask[i] = 0xFF;
-	}
-
-	parse_common(state->keyblob, state->maskblob, &val, offset,
-		     bytesz);
+	if (!(type->flags & P4TC_T_TYPE_HAS_MASK))
+		memset(mask, 0xFF, bytesz);
 
-	free(value);
-	free(mask);
+	memcpy(state->keyblob + *offset, value, bytesz);
+	memcpy(state->maskblob + *offset, mask, bytesz);
+	*offset += bytesz;
 
 	return 0;
 }
@@ -714,40 +819,30 @@ static int parse_table_keys(int *argc_p, char ***argv_p,
 			    struct parse_state *state, __u32 *offset,
 			    char **p4tcpath, const char *pname, __u32 tbl_id)
 {
-	struct p4tc_json_key_fields_list *key;
-	struct p4tc_json_pipeline *p;
-	struct p4tc_json_table *t;
+	struct p4tc_key_field_layout *field;
 	char **argv = *argv_p;
-	struct p4_type_s *typ;
 	int argc = *argc_p;
 	int ret = 0;
-	__u32 bitsz;
 
-	key = introspect_key_field_byname(&p, &t, pname,
-					  (const char **)p4tcpath, *argv);
-	if (!key)
+	field = p4tc_key_layout_find(pname, p4tcpath, *argv);
+	if (!field)
 		return -1;
 
 	state->has_parsed_keys = true;
-	typ = get_p4type_byarg(key->type, &bitsz);
-	if (!typ) {
-		fprintf(stderr, "Unable to find type %s\n", key->type);
-		ret = -1;
-		goto free_json_pipeline;
-	}
-	if (key) {
-		NEXT_ARG();
-		if (__parse_table_keys(state, offset, *argv,
-				       bitsz, typ) < 0) {
-			ret = -1;
+	if (!field->type) {
+		field->type = get_p4type_byarg(field->type_name,
+					       &field->bitsz);
+		if (!field->type) {
+			fprintf(stderr, "Unable to find type %s\n",
+				field->type_name);
+			return -1;
 		}
-	} else {
-		fprintf(stderr, "Unknown arg %s\n", *argv);
-		ret = -1;
+		field->bytesz = (field->bitsz + 7) / 8;
 	}
 
-free_json_pipeline:
-	p4tc_json_free_pipeline(p);
+	NEXT_ARG();
+	if (__parse_table_keys(state, offset, *argv, field) < 0)
+		ret = -1;
 
 	*argc_p = argc;
 	*argv_p = argv;
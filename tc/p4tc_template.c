@@ -37,6 +37,7 @@ static void p4template_usage(void)
 	fprintf(stderr,
 		"usage: tc p4template create | update pipeline/pname [PIPEID] OPTS\n"
 		"       tc p4template del | get pipeline/[pname] [PIPEID]\n"
+		"       tc p4template compile-introspection pname [ output FILE ]\n"
 		"Where:  OPTS := NUMTABLES STATE\n"
 		"	PIPEID := pipeid <32 bit pipeline id>\n"
 		"	NUMTABLES := numtables <16 bit numtables>\n"
@@ -2029,6 +2030,38 @@ static int p4tmpl_cmd(int cmd, unsigned int flags, int *argc_p,
 	return ret;
 }
 
+/* Turns $INTROSPECTION/<pname>.json into the compiled <pname>.bin that
+ * p4tc_json_import() maps instead of parsing the JSON.
+ */
+static int p4tmpl_compile_introspection(int *argc_p, char ***argv_p)
+{
+	const char *out_path = NULL;
+	char **argv = *argv_p;
+	int argc = *argc_p;
+	const char *pname;
+
+	NEXT_ARG();
+	pname = *argv;
+	NEXT_ARG_FWD();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "output") == 0) {
+			NEXT_ARG();
+			out_path = *argv;
+		} else {
+			fprintf(stderr, "Unknown compile-introspection arg %s\n",
+				*argv);
+			return -1;
+		}
+		NEXT_ARG_FWD();
+	}
+
+	*argc_p = argc;
+	*argv_p = argv;
+
+	return p4tc_json_compile(pname, out_path);
+}
+
 int do_p4tmpl(int argc, char **argv)
 {
 	int ret = 0;
@@ -2044,6 +2077,8 @@ int do_p4tmpl(int argc, char **argv)
 			ret = p4tmpl_cmd(RTM_DELP4TEMPLATE, 0, &argc, &argv);
 		} else if (matches(*argv, "get") == 0) {
 			ret = p4tmpl_cmd(RTM_GETP4TEMPLATE, 0, &argc, &argv);
+		} else if (strcmp(*argv, "compile-introspection") == 0) {
+			ret = p4tmpl_compile_introspection(&argc, &argv);
 		} else if (matches(*argv, "help") == 0) {
 			p4template_usage();
 			ret = -1;
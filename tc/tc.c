@@ -22,6 +22,7 @@
 #include "tc_common.h"
 #include "namespace.h"
 #include "rt_names.h"
+#include "ll_map.h"
 #include "bpf_util.h"
 #include "p4tc_common.h"
 
@@ -40,8 +41,10 @@ int oneline;
 int brief;
 
 int echo_request;
+bool do_all;
 
 static char *conf_file;
+static unsigned int async_window;
 
 struct rtnl_handle rth;
 
@@ -194,14 +197,14 @@ static void usage(void)
 {
 	fprintf(stderr,
 		"Usage:	tc [ OPTIONS ] OBJECT { COMMAND | help }\n"
-		"	tc [-force] -batch filename\n"
+		"	tc [-force] [-async N] -batch filename\n"
 		"where  OBJECT := { qdisc | class | filter | chain |\n"
 		"		    action | monitor | exec }\n"
 		"       OPTIONS := { -V[ersion] | -s[tatistics] | -d[etails] | -r[aw] |\n"
 		"		    -o[neline] | -j[son] | -p[retty] | -c[olor]\n"
 		"		    -b[atch] [filename] | -n[etns] name | -N[umeric] |\n"
 		"		     -nm | -nam[es] | { -cf | -conf } path\n"
-		"		     -br[ief] | -echo }\n");
+		"		     -br[ief] | -echo | -al[l] }\n");
 }
 
 static int do_cmd(int argc, char **argv)
@@ -234,9 +237,82 @@ static int do_cmd(int argc, char **argv)
 	return -1;
 }
 
+/* Verbs that only read state, and so can be run in all network namespaces.
+ * Exact verbs only: the object parsers read abbreviations such as "s",
+ * "d" or "l" as set, delete or link.
+ */
+static bool is_show_verb(const char *verb)
+{
+	return strcmp(verb, "show") == 0 || strcmp(verb, "list") == 0 ||
+	       strcmp(verb, "lst") == 0;
+}
+
+struct tc_netns_cmd {
+	int argc;
+	char **argv;
+};
+
+/* Called in a child process, from within the network namespace */
+static int tc_netns_cmd(char *nsname, void *arg)
+{
+	struct tc_netns_cmd *cmd = arg;
+
+	rtnl_close(&rth);
+	ll_flush_map();
+
+	if (rtnl_open(&rth, 0) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink in netns %s\n", nsname);
+		return -1;
+	}
+
+	return do_cmd(cmd->argc, cmd->argv);
+}
+
+/* Run a show command in all named network namespaces */
+static int do_cmd_all_netns(int argc, char **argv)
+{
+	struct tc_netns_cmd cmd = {
+		.argc = argc,
+		.argv = argv,
+	};
+	int ret;
+
+	if (argc < 2 || !is_show_verb(argv[1])) {
+		fprintf(stderr,
+			"-all is only supported with show, list or lst.\n");
+		return -1;
+	}
+
+	new_json_obj(json);
+	ret = netns_foreach_run(tc_netns_cmd, &cmd);
+	if (delete_json_obj())
+		ret = -1;
+	return ret ? -1 : 0;
+}
+
+/* A queued or pipelined request failed. It was already reported
+ * against its own line, and the current one was not sent.
+ */
+static bool tc_batch_stopped(void)
+{
+	return !force && (p4ctrl_batch_failed() || tc_async_failed());
+}
+
 static int tc_batch_cmd(int argc, char *argv[], void *data)
 {
-	return do_cmd(argc, argv);
+	int ret;
+
+	/* Queued p4ctrl entries must hit the kernel before anything else */
+	if (matches(*argv, "p4ctrl") != 0)
+		p4ctrl_batch_flush();
+	if (tc_batch_stopped())
+		return BATCH_STOP;
+
+	ret = do_cmd(argc, argv);
+	if (tc_batch_stopped())
+		return BATCH_STOP;
+
+	return json_obj_failed() ? -1 : ret;
 }
 
 static int batch(const char *name)
@@ -251,7 +327,18 @@ static int batch(const char *name)
 		return -1;
 	}
 
+	if (tc_async_init(name, async_window) < 0) {
+		rtnl_close(&rth);
+		return -1;
+	}
+
+	p4ctrl_batch_start(name);
 	ret = do_batch(name, force, tc_batch_cmd, NULL);
+	if (p4ctrl_batch_end() < 0)
+		ret = EXIT_FAILURE;
+	if (tc_async_drain() < 0)
+		ret = EXIT_FAILURE;
+	tc_async_fini();
 
 	rtnl_close(&rth);
 	return ret;
@@ -298,6 +385,15 @@ int main(int argc, char **argv)
 			if (argc <= 1)
 				usage();
 			batch_file = argv[1];
+		} else if (matches(argv[1], "-async") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&async_window, argv[1], 0) ||
+			    !async_window) {
+				fprintf(stderr,
+					"Illegal \"-async\" window \"%s\"\n",
+					argv[1]);
+				return -1;
+			}
 		} else if (matches(argv[1], "-netns") == 0) {
 			NEXT_ARG();
 			if (netns_switch(argv[1]))
@@ -325,6 +421,8 @@ int main(int argc, char **argv)
 			++brief;
 		} else if (strcmp(argv[1], "-echo") == 0) {
 			++echo_request;
+		} else if (matches(argv[1], "-all") == 0) {
+			do_all = true;
 		} else {
 			fprintf(stderr,
 				"Option \"%s\" is unknown, try \"tc -help\".\n",
@@ -362,7 +460,12 @@ int main(int argc, char **argv)
 		goto Exit;
 	}
 
-	ret = do_cmd(argc-1, argv+1);
+	if (do_all)
+		ret = do_cmd_all_netns(argc-1, argv+1);
+	else
+		ret = do_cmd(argc-1, argv+1);
+	if (json_obj_failed())
+		ret = 1;
 Exit:
 	rtnl_close(&rth);
 #ifdef P4TC
@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * tc_async.c		Pipelined requests for "tc -batch".
+ *
+ * rtnetlink handles a request synchronously in the sender's sendmsg(),
+ * so the kernel state is already up to date when send returns; only the
+ * ACK is left in the socket queue. In async mode requests go out on a
+ * dedicated socket and their ACKs are collected later, many per
+ * recvmmsg(), instead of one blocking round trip per batch line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "utils.h"
+#include "tc_util.h"
+#include "tc_common.h"
+
+#define TC_ASYNC_RECV_BATCH	32
+#define TC_ASYNC_ACK_SIZE	4096
+
+struct tc_async_req {
+	__u32 seq;
+	__u32 len;
+	int nents;
+	struct tc_async_ent ents[TC_ASYNC_MAX_ENTS];
+};
+
+static struct {
+	struct rtnl_handle rth;
+	const char *name;
+	struct tc_async_req *reqs;
+	unsigned int window;
+	unsigned int head;
+	unsigned int inflight;
+	bool failed;
+} tc_async;
+
+static const char *tc_async_errmsg;
+static __u32 tc_async_erroff;
+
+int tc_async_init(const char *name, unsigned int window)
+{
+	int one = 1;
+
+	if (!window)
+		return 0;
+
+	if (rtnl_open(&tc_async.rth, 0) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink\n");
+		return -1;
+	}
+
+	/* ACKs only need the header of the request, not the whole payload */
+	setsockopt(tc_async.rth.fd, SOL_NETLINK, NETLINK_CAP_ACK,
+		   &one, sizeof(one));
+
+	tc_async.reqs = calloc(window, sizeof(*tc_async.reqs));
+	if (!tc_async.reqs) {
+		rtnl_close(&tc_async.rth);
+		return -1;
+	}
+
+	tc_async.name = name ? name : "-";
+	tc_async.window = window;
+	tc_async.head = 0;
+	tc_async.inflight = 0;
+	tc_async.failed = false;
+
+	return 0;
+}
+
+bool tc_async_active(void)
+{
+	return tc_async.window && !echo_request;
+}
+
+bool tc_async_failed(void)
+{
+	return tc_async.failed;
+}
+
+static int tc_async_extack(const char *errmsg, uint32_t off,
+			   const struct nlmsghdr *inner_nlh)
+{
+	tc_async_errmsg = errmsg;
+	tc_async_erroff = off;
+
+	return 0;
+}
+
+static int tc_async_req_ent(const struct tc_async_req *req, __u32 off)
+{
+	int i;
+
+	if (!off || off < req->ents[0].off || off >= req->len)
+		return -1;
+
+	for (i = req->nents - 1; i >= 0; i--)
+		if (off >= req->ents[i].off)
+			return i;
+
+	return -1;
+}
+
+static void tc_async_report(const struct tc_async_req *req,
+			    struct nlmsghdr *h)
+{
+	const struct nlmsgerr *err = NLMSG_DATA(h);
+	const char *errmsg;
+	int i, ent = 0;
+
+	tc_async_errmsg = NULL;
+	tc_async_erroff = 0;
+	nl_dump_ext_ack(h, tc_async_extack);
+
+	errmsg = tc_async_errmsg;
+	if (errmsg && *errmsg)
+		fprintf(stderr, "Error: %s%s\n", errmsg,
+			errmsg[strlen(errmsg) - 1] == '.' ? "" : ".");
+	else
+		fprintf(stderr, "RTNETLINK answers: %s\n",
+			strerror(-err->error));
+
+	if (req->nents > 1) {
+		ent = tc_async_req_ent(req, tc_async_erroff);
+		if (ent < 0) {
+			fprintf(stderr, "Command failed %s:%d-%d\n",
+				tc_async.name, req->ents[0].lineno,
+				req->ents[req->nents - 1].lineno);
+			return;
+		}
+	}
+
+	/* the kernel stops at the rejected entry of a multi-entry request */
+	for (i = ent; i < req->nents; i++)
+		fprintf(stderr, "Command failed %s:%d\n", tc_async.name,
+			req->ents[i].lineno);
+}
+
+static int tc_async_ack(struct nlmsghdr *h, int len)
+{
+	struct tc_async_req *req;
+	unsigned int idx;
+	__u32 delta;
+
+	for (; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len)) {
+		if (h->nlmsg_type != NLMSG_ERROR || !tc_async.inflight)
+			continue;
+
+		/* ACKs come back in request order */
+		delta = h->nlmsg_seq - tc_async.reqs[tc_async.head].seq;
+		if (delta >= tc_async.inflight)
+			continue;
+		idx = (tc_async.head + delta) % tc_async.window;
+		req = &tc_async.reqs[idx];
+
+		if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+			fprintf(stderr, "ERROR truncated\n");
+			tc_async.failed = true;
+		} else if (((struct nlmsgerr *)NLMSG_DATA(h))->error) {
+			tc_async_report(req, h);
+			tc_async.failed = true;
+		}
+
+		delta++;
+		tc_async.head = (tc_async.head + delta) % tc_async.window;
+		tc_async.inflight -= delta;
+	}
+
+	return 0;
+}
+
+/* Collect ACKs until at most @keep requests are outstanding */
+static int tc_async_reap(unsigned int keep)
+{
+	static char bufs[TC_ASYNC_RECV_BATCH][TC_ASYNC_ACK_SIZE];
+	struct mmsghdr msgs[TC_ASYNC_RECV_BATCH];
+	struct iovec iovs[TC_ASYNC_RECV_BATCH];
+	int i, n;
+
+	while (tc_async.inflight > keep) {
+		unsigned int vlen = tc_async.inflight - keep;
+
+		if (vlen > TC_ASYNC_RECV_BATCH)
+			vlen = TC_ASYNC_RECV_BATCH;
+
+		memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < vlen; i++) {
+			iovs[i].iov_base = bufs[i];
+			iovs[i].iov_len = sizeof(bufs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		n = recvmmsg(tc_async.rth.fd, msgs, vlen, MSG_WAITFORONE, NULL);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("netlink receive error");
+			tc_async.failed = true;
+			tc_async.inflight = 0;
+			return -1;
+		}
+
+		for (i = 0; i < n; i++)
+			tc_async_ack((struct nlmsghdr *)bufs[i], msgs[i].msg_len);
+	}
+
+	return 0;
+}
+
+int tc_async_talk_ents(struct nlmsghdr *n, const struct tc_async_ent *ents,
+		       int nents)
+{
+	struct tc_async_req *req;
+
+	if (nents > TC_ASYNC_MAX_ENTS)
+		return -1;
+
+	if (tc_async.inflight == tc_async.window &&
+	    tc_async_reap(tc_async.window - 1) < 0)
+		return -1;
+
+	/* without -force an earlier failure ends the batch */
+	if (tc_async.failed && !force)
+		return -1;
+
+	req = &tc_async.reqs[(tc_async.head + tc_async.inflight) %
+			     tc_async.window];
+
+	n->nlmsg_flags |= NLM_F_ACK;
+	n->nlmsg_seq = req->seq = ++tc_async.rth.seq;
+	req->len = n->nlmsg_len;
+	if (ents) {
+		memcpy(req->ents, ents, nents * sizeof(*ents));
+		req->nents = nents;
+	} else {
+		req->ents[0].lineno = cmdlineno;
+		req->ents[0].off = 0;
+		req->nents = 1;
+	}
+
+	if (rtnl_send(&tc_async.rth, n, n->nlmsg_len) < 0) {
+		perror("Cannot talk to rtnetlink");
+		return -1;
+	}
+	tc_async.inflight++;
+
+	return 0;
+}
+
+int tc_async_drain(void)
+{
+	if (!tc_async.window)
+		return 0;
+
+	if (tc_async_reap(0) < 0)
+		return -1;
+
+	return tc_async.failed ? -1 : 0;
+}
+
+void tc_async_fini(void)
+{
+	if (!tc_async.window)
+		return;
+
+	rtnl_close(&tc_async.rth);
+	free(tc_async.reqs);
+	tc_async.reqs = NULL;
+	tc_async.window = 0;
+}
+
+int tc_talk(struct nlmsghdr *n)
+{
+	if (tc_async_active())
+		return tc_async_talk_ents(n, NULL, 0);
+
+	return rtnl_talk(&rth, n, NULL);
+}
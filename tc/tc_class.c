@@ -143,7 +143,7 @@ static int tc_class_modify(int cmd, unsigned int flags, int argc, char **argv)
 			return -nodev(d);
 	}
 
-	if (rtnl_talk(&rth, &req.n, NULL) < 0)
+	if (tc_talk(&req.n) < 0)
 		return 2;
 
 	return 0;
@@ -235,14 +235,20 @@ static int tc_filter_modify(int cmd, unsigned int flags, int argc, char **argv)
 
 	if (echo_request)
 		ret = rtnl_echo_talk(&rth, &req.n, json, print_filter);
-	else
+	else if (q && q->commit_fopt)
+		/* the commit needs the ACK, do not queue it for -async */
 		ret = rtnl_talk(&rth, &req.n, NULL);
+	else
+		ret = tc_talk(&req.n);
 
 	if (ret < 0) {
 		fprintf(stderr, "We have an error talking to the kernel\n");
 		return 2;
 	}
 
+	if (q && q->commit_fopt && q->commit_fopt(q, &req.n))
+		return 1;
+
 	return 0;
 }
 
@@ -201,7 +201,7 @@ static int tc_qdisc_modify(int cmd, unsigned int flags, int argc, char **argv)
 		req.t.tcm_ifindex = idx;
 	}
 
-	if (rtnl_talk(&rth, &req.n, NULL) < 0)
+	if (tc_talk(&req.n) < 0)
 		return 2;
 
 	return 0;
@@ -62,6 +62,8 @@ struct filter_util {
 			  int argc, char **argv, struct nlmsghdr *n);
 	int (*print_fopt)(struct filter_util *qu,
 			  FILE *f, struct rtattr *opt, __u32 fhandle);
+	/* optional, run once the kernel has accepted the request */
+	int (*commit_fopt)(struct filter_util *qu, struct nlmsghdr *n);
 };
 
 struct action_util {
@@ -153,4 +155,21 @@ void print_masked_be16(const char *name, struct rtattr *attr,
 		       struct rtattr *mask_attr, bool newline);
 
 void print_ext_msg(struct rtattr **tb);
+
+/* Pipelined batch requests, see tc_async.c */
+#define TC_ASYNC_MAX_ENTS P4TC_MSGBATCH_SIZE
+
+struct tc_async_ent {
+	int lineno;
+	__u32 off;	/* of the entry from the start of the request */
+};
+
+int tc_async_init(const char *name, unsigned int window);
+bool tc_async_active(void);
+bool tc_async_failed(void);
+int tc_async_talk_ents(struct nlmsghdr *n, const struct tc_async_ent *ents,
+		       int nents);
+int tc_async_drain(void);
+void tc_async_fini(void);
+int tc_talk(struct nlmsghdr *n);
 #endif
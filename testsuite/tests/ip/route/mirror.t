@@ -0,0 +1,83 @@
+#!/bin/sh
+
+. lib/generic.sh
+
+ts_log "[Testing ip route mirror file]"
+
+command -v socat >/dev/null || ts_skip
+
+RTMON="$(dirname $IP)/rtmon"
+CAPTURE=$(mktemp /tmp/rtmon_capture.XXXXXX)
+SOCK="iproute2-mirror-test-$$"
+
+mirror_query()
+{
+	DESC=$1; shift
+	echo "$@" | socat - ABSTRACT-CONNECT:$SOCK > $STD_OUT 2> $STD_ERR
+	if [ -s $STD_ERR ]; then
+		ts_err "$0: $DESC failed:"
+		ts_err_cat $STD_ERR
+	else
+		echo "$0: $DESC succeeded with output:"
+		cat $STD_OUT
+	fi
+}
+
+ts_ip "$0" "Set lo up" link set lo up
+
+$RTMON route file $CAPTURE &
+RTMON_PID=$!
+# rtmon writes the link dump once it listens
+for i in $(seq 50); do
+	[ -s $CAPTURE ] && break
+	sleep 0.1
+done
+
+ts_ip "$0" "Add 10.1.0.0/16" route add 10.1.0.0/16 dev lo
+ts_ip "$0" "Add 10.1.2.0/24" route add 10.1.2.0/24 dev lo metric 5
+ts_ip "$0" "Add 10.1.3.0/24" route add 10.1.3.0/24 dev lo
+ts_ip "$0" "Add 10.1.2.0/24 to table 100" route add 10.1.2.0/24 dev lo table 100
+ts_ip "$0" "Add 2001:db8::/32" -6 route add 2001:db8::/32 dev lo
+ts_ip "$0" "Delete 10.1.3.0/24" route del 10.1.3.0/24 dev lo
+
+sleep 0.2
+kill $RTMON_PID
+wait $RTMON_PID 2>/dev/null
+
+$IP route mirror socket $SOCK file $CAPTURE &
+MIRROR_PID=$!
+# wait for the mirror to listen
+for i in $(seq 50); do
+	echo stats | socat - ABSTRACT-CONNECT:$SOCK >/dev/null 2>&1 && break
+	sleep 0.1
+done
+
+mirror_query "Longest prefix match" get 10.1.2.3
+test_on "^10.1.2.0/24 dev lo scope link metric 5"
+test_lines_count 1
+
+mirror_query "Shorter prefix match" get 10.1.9.9
+test_on "^10.1.0.0/16 dev lo scope link"
+
+mirror_query "Deleted route falls back" get 10.1.3.1
+test_on "^10.1.0.0/16 dev lo scope link"
+
+mirror_query "Lookup in table 100" get 10.1.2.3 table 100
+test_on "^10.1.2.0/24 dev lo table 100 scope link"
+
+mirror_query "Lookup in table 100, no match" get 10.1.9.9 table 100
+test_on "^error: Network is unreachable"
+
+mirror_query "IPv6 lookup" get 2001:db8::1
+test_on "^2001:db8::/32 dev lo metric 1024"
+
+mirror_query "Invalid address" get foo
+test_on "^error: invalid address"
+
+mirror_query "Stats" stats
+# invalid requests are not lookups
+test_on "^routes [0-9]+ lookups 6 "
+
+kill $MIRROR_PID
+wait $MIRROR_PID 2>/dev/null
+rm -f $CAPTURE
@@ -0,0 +1,32 @@
+#!/bin/sh
+
+. lib/generic.sh
+
+# % ./misc/ss -Htna
+# LISTEN  0    128    0.0.0.0:22       0.0.0.0:*
+# ESTAB   0    0     10.0.0.1:22      10.0.0.1:36266
+# ESTAB   0    0     10.0.0.1:36266   10.0.0.1:22
+# ESTAB   0    0     10.0.0.1:22      10.0.0.2:50312
+export TCPDIAG_FILE="$(dirname $0)/ss1.dump"
+
+ts_log "[Testing --group-by]"
+
+ts_ss "$0" "Group by state" -Htna --group-by=state
+test_lines_count 4
+test_on "^state:ESTAB count:3$"
+test_on "^state:LISTEN count:1$"
+test_on "send-q:\(sum:128,min:128,max:128,p50:128,p90:128,p99:128\)"
+
+ts_ss "$0" "Group by state,lport" -Htna --group-by=state,lport
+test_lines_count 6
+test_on "^state:ESTAB lport:22 count:2$"
+test_on "^state:ESTAB lport:36266 count:1$"
+test_on "^state:LISTEN lport:22 count:1$"
+
+ts_ss "$0" "Group by remote" -Htna --group-by=remote
+test_on "^remote:10.0.0.0/24 count:3$"
+test_on "^remote:0.0.0.0/24 count:1$"
+
+ts_ss "$0" "Group filtered by dport" -Htna --group-by=netid,state dport = 22
+test_lines_count 2
+test_on "^netid:tcp state:ESTAB count:1$"
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+. lib/generic.sh
+
+# Two rounds of TCP sockets with tcp_info, replayed SECS apart:
+# % ./misc/ss -Htna
+# LISTEN 0      128     0.0.0.0:22     0.0.0.0:*
+# ESTAB  0      0      10.0.0.1:22    10.0.0.2:50312	cookie 1
+# ESTAB  0      0      10.0.0.1:36266 10.0.0.1:22	cookie 2
+# ESTAB  0      0      10.0.0.1:22    10.0.0.3:40000	cookie 4, first round only
+# ESTAB  0      0      10.0.0.1:22    10.0.0.1:36266	cookie 3, second round only
+export TCPDIAG_FILE="$(dirname $0)/ss2.dump"
+
+ts_log "[Testing --interval and --top]"
+
+ts_ss "$0" "Rates over 1s" -Htna --interval=1
+# the sockets seen in one round only have no rate yet
+test_lines_count 3
+test_on "^ESTAB +0 +0 +10.0.0.1:22 +10.0.0.2:50312 +tx:8000000bps rx:1000000bps segs_out:700/s segs_in:100/s retrans:0/s"
+test_on "^ESTAB +0 +0 +10.0.0.1:36266 +10.0.0.1:22 +tx:100000bps rx:0bps segs_out:200/s segs_in:50/s retrans:10/s"
+test_on "^LISTEN .* tx:0bps rx:0bps"
+
+ts_ss "$0" "Rates over 2s" -Htna --interval=2
+test_on "10.0.0.2:50312 +tx:4000000bps rx:500000bps segs_out:350/s"
+
+ts_ss "$0" "Top 1 by throughput" -Htna --interval=1 --top=1
+test_lines_count 1
+test_on "10.0.0.1:22 +10.0.0.2:50312 +tx:8000000bps"
+
+ts_ss "$0" "Top 1 by retransmits" -Htna --interval=1 --top=retrans:1
+test_lines_count 1
+test_on "10.0.0.1:36266 +10.0.0.1:22 +tx:100000bps .* retrans:10/s"
+
+ts_ss "$0" "Rates filtered by dport" -Htna --interval=1 dport = 22
+test_lines_count 1
+test_on "10.0.0.1:36266 +10.0.0.1:22 "
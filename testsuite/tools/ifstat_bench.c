@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * ifstat_bench.c	Cost of one ifstat daemon scan vs number of links
+ *
+ * Feeds synthetic RTM_NEWLINK dumps to the daemon's update path, in the
+ * order the kernel dumps links (ifindex hash buckets), and reports the
+ * time spent per scan. With -c, that many links are replaced by new ones
+ * before every scan, like containers coming and going.
+ *
+ * Usage: ifstat_bench [-s SCANS] [-c CHURN] [LINKS...]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#define main ifstat_main
+#include "../../misc/ifstat.c"
+#undef main
+
+#define BENCH_DEV_HASHBITS	8
+#define BENCH_MSG_SIZE		512
+
+static char *bench_msgs;
+
+static int bench_fill(struct nlmsghdr *h, int ifindex, __u64 scan)
+{
+	struct rtnl_link_stats64 st = {
+		.rx_packets = scan * ifindex,
+		.tx_packets = scan * ifindex,
+		.rx_bytes = scan * ifindex * 1500,
+		.tx_bytes = scan * ifindex * 1500,
+	};
+	struct ifinfomsg *ifi;
+	char name[IFNAMSIZ];
+
+	memset(h, 0, BENCH_MSG_SIZE);
+	h->nlmsg_type = RTM_NEWLINK;
+	h->nlmsg_len = NLMSG_LENGTH(sizeof(*ifi));
+
+	ifi = NLMSG_DATA(h);
+	ifi->ifi_index = ifindex;
+	ifi->ifi_flags = IFF_UP | IFF_RUNNING;
+
+	snprintf(name, sizeof(name), "veth%d", ifindex);
+	if (addattrstrz(h, BENCH_MSG_SIZE, IFLA_IFNAME, name) < 0 ||
+	    addattr_l(h, BENCH_MSG_SIZE, IFLA_STATS64, &st, sizeof(st)) < 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Lay links first..first+links-1 out like the kernel dump: by hash
+ * bucket, then by ifindex.
+ */
+static int bench_build(int first, int links, __u64 scan)
+{
+	int mask = (1 << BENCH_DEV_HASHBITS) - 1;
+	int last = first + links - 1;
+	int bucket, ifindex, i = 0;
+
+	for (bucket = 0; bucket <= mask; bucket++) {
+		ifindex = first + ((bucket - first) & mask);
+		for (; ifindex <= last; ifindex += mask + 1) {
+			struct nlmsghdr *h;
+
+			h = (struct nlmsghdr *)(bench_msgs + i++ * BENCH_MSG_SIZE);
+			if (bench_fill(h, ifindex, scan) < 0)
+				return -1;
+		}
+	}
+	return i;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_run(int links, int scans, int churn)
+{
+	int interval = 1000;
+	double total = 0;
+	int scan, i, n;
+
+	bench_msgs = malloc((size_t)links * BENCH_MSG_SIZE);
+	if (!bench_msgs)
+		return -1;
+
+	for (scan = 0; scan <= scans; scan++) {
+		double start;
+
+		n = bench_build(1 + scan * churn, links, scan);
+		if (n < 0)
+			return -1;
+
+		start = bench_now();
+		update_begin();
+		for (i = 0; i < n; i++)
+			if (update_nlmsg((struct nlmsghdr *)(bench_msgs +
+							     i * BENCH_MSG_SIZE),
+					 &interval) < 0)
+				return -1;
+		update_end();
+
+		/* the first scan only fills the database */
+		if (scan)
+			total += bench_now() - start;
+	}
+
+	printf("%8d links %10.1f us/scan %8.1f ns/link\n", links,
+	       total / scans * 1e6, total / scans / links * 1e9);
+
+	free(bench_msgs);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const int def_links[] = { 1000, 5000, 20000, 50000 };
+	int scans = 20;
+	int churn = 0;
+	int i;
+
+	while (argc > 2 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-s"))
+			scans = atoi(argv[2]);
+		else if (!strcmp(argv[1], "-c"))
+			churn = atoi(argv[2]);
+		else
+			break;
+		argc -= 2;
+		argv += 2;
+	}
+	if (scans <= 0 || churn < 0) {
+		fprintf(stderr, "ifstat_bench: invalid arguments\n");
+		return 1;
+	}
+
+	scan_interval = 1000;
+	time_constant = 60000;
+	W = 1 - 1/exp(log(10)*(double)scan_interval/time_constant);
+
+	for (i = 0; i < (argc > 1 ? argc - 1 : ARRAY_SIZE(def_links)); i++) {
+		int links = argc > 1 ? atoi(argv[i + 1]) : def_links[i];
+
+		if (links <= 0 || bench_run(links, scans, churn) < 0) {
+			fprintf(stderr, "ifstat_bench: failed for %d links\n",
+				links);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * p4tc_keys_bench.c	Cost of parsing P4TC table entry keys
+ *
+ * Runs the "tc p4ctrl create" key parser over ENTRIES synthetic entries of
+ * a table with four key fields (two ipv4, a bit16 and a bit17) and reports
+ * entries per second. The introspection file is generated in a temporary
+ * directory, so no pipeline needs to be installed.
+ *
+ * Usage: p4tc_keys_bench [ENTRIES]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../tc/p4tc_table.c"
+
+/* The entry parser links against the action, extern and expression code;
+ * none of it is reached when parsing keys.
+ */
+int tc_print_action(FILE *f, const struct rtattr *tb, unsigned short tot_acts)
+{
+	return 0;
+}
+
+int p4tc_print_one_extern(FILE *f, struct rtattr *arg, bool bind)
+{
+	return 0;
+}
+
+int p4tc_print_permissions(const char *prefix, __u16 *passed_permissions,
+			   const char *suffix, FILE *f)
+{
+	return 0;
+}
+
+int parse_dyna_tbl_act(int *argc_p, char ***argv_p, char **actname_p,
+		       const char *tblname, const bool introspect_global,
+		       struct nlmsghdr *n, bool params_only)
+{
+	return -1;
+}
+
+int parse_table_default_action(int *argc_p, char ***argv_p,
+			       struct nlmsghdr *n, __u32 attr_id)
+{
+	return -1;
+}
+
+struct parsedexpr *parse_expr_args(int *argc, const char * const **argv,
+				   void *arg)
+{
+	return NULL;
+}
+
+struct typedexpr *type_expr(struct parsedexpr *e)
+{
+	return NULL;
+}
+
+void add_typed_expr(struct nlmsghdr *n, struct typedexpr *t)
+{
+}
+
+void free_typedexpr(struct typedexpr *t)
+{
+}
+
+void free_parsedexpr(struct parsedexpr *e)
+{
+}
+
+#define BENCH_PNAME	"bench"
+
+static const char bench_json[] =
+	"{\n"
+	"  \"schema_version\" : \"1.0.0\",\n"
+	"  \"pipeline_name\" : \"" BENCH_PNAME "\",\n"
+	"  \"id\" : 1,\n"
+	"  \"tables\" : [ {\n"
+	"    \"name\" : \"cb/t\", \"id\" : 1, \"tentries\" : 2048,\n"
+	"    \"nummask\" : 8, \"keysize\" : 97,\n"
+	"    \"keyfields\" : [\n"
+	"      { \"id\" : 1, \"name\" : \"srcAddr\", \"type\" : \"ipv4\",\n"
+	"        \"match_type\" : \"exact\", \"bitwidth\" : 32 },\n"
+	"      { \"id\" : 2, \"name\" : \"dstAddr\", \"type\" : \"ipv4\",\n"
+	"        \"match_type\" : \"exact\", \"bitwidth\" : 32 },\n"
+	"      { \"id\" : 3, \"name\" : \"port\", \"type\" : \"bit16\",\n"
+	"        \"match_type\" : \"exact\", \"bitwidth\" : 16 },\n"
+	"      { \"id\" : 4, \"name\" : \"flow\", \"type\" : \"bit17\",\n"
+	"        \"match_type\" : \"exact\", \"bitwidth\" : 17 }\n"
+	"    ],\n"
+	"    \"actions\" : []\n"
+	"  } ]\n"
+	"}\n";
+
+static char bench_dir[] = "/tmp/p4tc_keys_benchXXXXXX";
+static char bench_file[sizeof(bench_dir) + sizeof(BENCH_PNAME ".json")];
+
+static int bench_setup(void)
+{
+	FILE *fp;
+
+	if (!mkdtemp(bench_dir)) {
+		perror("mkdtemp");
+		return -1;
+	}
+	snprintf(bench_file, sizeof(bench_file), "%s/%s.json", bench_dir,
+		 BENCH_PNAME);
+
+	fp = fopen(bench_file, "w");
+	if (!fp) {
+		perror(bench_file);
+		return -1;
+	}
+	fputs(bench_json, fp);
+	fclose(fp);
+
+	setenv(ENV_VAR, bench_dir, 1);
+	return 0;
+}
+
+static void bench_cleanup(void)
+{
+	unlink(bench_file);
+	rmdir(bench_dir);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	char *p4tcpath[MAX_PATH_COMPONENTS] = {
+		[PATH_TABLE_PNAME_IDX] = BENCH_PNAME,
+		[PATH_CBNAME_IDX] = "cb",
+		[PATH_TBLNAME_IDX] = "t",
+	};
+	unsigned long entries = 100000, i;
+	char src[16], dst[16], port[8], flow[8];
+	double start, elapsed;
+	int ret = 0;
+
+	if (argc > 1)
+		entries = strtoul(argv[1], NULL, 0);
+
+	register_p4_types();
+	if (bench_setup() < 0) {
+		bench_cleanup();
+		return 1;
+	}
+
+	start = now();
+	for (i = 0; i < entries; i++) {
+		char *args[] = {
+			"srcAddr", src, "dstAddr", dst,
+			"port", port, "flow", flow,
+		};
+		struct parse_state state = {};
+		char **av = args;
+		int ac = ARRAY_SIZE(args);
+		__u32 offset = 0;
+
+		snprintf(src, sizeof(src), "10.%lu.%lu.1",
+			 (i >> 8) & 0xff, i & 0xff);
+		snprintf(dst, sizeof(dst), "192.168.%lu.%lu",
+			 (i >> 8) & 0xff, i & 0xff);
+		snprintf(port, sizeof(port), "%lu", i & 0xffff);
+		snprintf(flow, sizeof(flow), "%lu", i & 0x1ffff);
+
+		while (ac > 0) {
+			if (parse_table_keys(&ac, &av, &state, &offset,
+					     p4tcpath, BENCH_PNAME, 1) < 0) {
+				fprintf(stderr, "entry %lu: key parse failed\n",
+					i);
+				ret = 1;
+				goto out;
+			}
+			ac--;
+			av++;
+		}
+	}
+	elapsed = now() - start;
+
+	printf("%lu entries in %.3fs: %.0f entries/s\n",
+	       entries, elapsed, entries / elapsed);
+out:
+	bench_cleanup();
+	unregister_p4_types();
+	return ret;
+}